@@ -0,0 +1,82 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <zlib.h>
+
+#include <string>
+
+// streaming gzip compression of an HTTP body
+class GzipEncoder {
+private:
+    z_stream _stream;
+    bool _initialized;
+
+public:
+    GzipEncoder();
+
+    ~GzipEncoder();
+
+    // appends the compressed bytes available so far, use Z_SYNC_FLUSH to get everything or Z_FINISH at the end
+    bool encode(const char *data, size_t size, std::string &output, int flush = Z_NO_FLUSH);
+};
+
+// streaming decompression of a gzip or deflate HTTP body
+class GzipDecoder {
+private:
+    z_stream _stream;
+    bool _initialized;
+    bool _finished = false;
+
+public:
+    GzipDecoder();
+
+    ~GzipDecoder();
+
+    // appends the decompressed bytes, returns false if the data is corrupted
+    bool decode(const char *data, size_t size, std::string &output);
+
+    bool is_finished() const;
+};
+
+// removes the chunked transfer coding of an HTTP body given in arbitrary pieces
+class ChunkedDecoder {
+private:
+    enum State {
+        SIZE,
+        DATA,
+        DATA_END,
+        TRAILER,
+        DONE
+    };
+
+    State _state = SIZE;
+    size_t _remaining_bytes = 0;
+    std::string _pending;
+
+public:
+    ChunkedDecoder() = default;
+
+    ~ChunkedDecoder() = default;
+
+    // appends the payload of the chunks, returns false if the framing is invalid
+    bool decode(const char *data, size_t size, std::string &output);
+
+    bool is_finished() const;
+};
+
+std::string make_chunk(const std::string &data);
+
+bool is_compressible(const std::string &content_type);
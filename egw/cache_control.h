@@ -0,0 +1,40 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <map>
+#include <string>
+
+// directives of one or several cache-control header fields, names are case insensitive
+class CacheControl {
+private:
+    std::map<std::string, std::string> _directives;
+
+public:
+    CacheControl() = default;
+
+    explicit CacheControl(const std::string &header);
+
+    ~CacheControl() = default;
+
+    void parse(const std::string &header);
+
+    bool has(const std::string &directive) const;
+
+    std::string get(const std::string &directive) const;
+
+    // value of a delta-seconds directive, -1 if it is missing or invalid
+    long getSeconds(const std::string &directive) const;
+};
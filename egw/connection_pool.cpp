@@ -0,0 +1,105 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "connection_pool.h"
+
+#include <iostream>
+
+ConnectionPool::ConnectionPool(size_t max_idle_per_origin, const std::chrono::milliseconds &idle_timeout)
+        : _max_idle_per_origin(max_idle_per_origin)
+        , _idle_timeout(idle_timeout) {
+
+}
+
+bool ConnectionPool::acquire(const std::string &origin, OriginStream &stream) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _idle_connections.find(origin);
+    if (it == _idle_connections.end()) {
+        return false;
+    }
+
+    auto time_point = std::chrono::steady_clock::now();
+    bool found = false;
+    // most recently used first, it is the least likely to be closed by the origin
+    while (!found && !it->second.empty()) {
+        IdleConnection connection = std::move(it->second.back());
+        it->second.pop_back();
+        if (connection.since + _idle_timeout > time_point && isHealthy(connection.stream->socket())) {
+            stream = std::move(*connection.stream);
+            found = true;
+        } else {
+            boost::system::error_code err;
+            connection.stream->socket().close(err);
+        }
+    }
+    if (it->second.empty()) {
+        _idle_connections.erase(it);
+    }
+    return found;
+}
+
+void ConnectionPool::release(const std::string &origin, OriginStream &&stream) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto &connections = _idle_connections[origin];
+    if (connections.size() < _max_idle_per_origin) {
+        connections.push_back(IdleConnection{std::make_shared<OriginStream>(std::move(stream)),
+                                             std::chrono::steady_clock::now()});
+    } else {
+        boost::system::error_code err;
+        stream.socket().close(err);
+    }
+}
+
+void ConnectionPool::purge() {
+    std::lock_guard<std::mutex> lock(_mutex);
+#ifndef NDEBUG
+    size_t remove_count = 0;
+#endif
+    auto time_point = std::chrono::steady_clock::now();
+    auto it = _idle_connections.begin();
+    while (it != _idle_connections.end()) {
+        auto &connections = it->second;
+        // connections are ordered from the oldest to the most recent release
+        while (!connections.empty() && connections.front().since + _idle_timeout <= time_point) {
+            boost::system::error_code err;
+            connections.front().stream->socket().close(err);
+            connections.pop_front();
+#ifndef NDEBUG
+            ++remove_count;
+#endif
+        }
+        if (connections.empty()) {
+            it = _idle_connections.erase(it);
+        } else {
+            ++it;
+        }
+    }
+#ifndef NDEBUG
+    std::cout << remove_count << " idle connection(s) closed (" << _idle_connections.size() << " origin(s) remaining)" << std::endl;
+#endif
+}
+
+bool ConnectionPool::isHealthy(boost::asio::ip::tcp::socket &socket) {
+    if (!socket.is_open()) {
+        return false;
+    }
+    // an idle connection must have nothing to read, otherwise the origin closed it or sent garbage
+    boost::system::error_code err;
+    char byte;
+    socket.non_blocking(true, err);
+    socket.receive(boost::asio::buffer(&byte, 1), boost::asio::ip::tcp::socket::message_peek, err);
+    bool healthy = err == boost::asio::error::would_block;
+    socket.non_blocking(false, err);
+    return healthy;
+}
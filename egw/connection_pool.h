@@ -0,0 +1,56 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <boost/asio.hpp>
+
+#include "origin_stream.h"
+
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// idle persistent connections to origin servers, indexed by origin
+class ConnectionPool {
+private:
+    struct IdleConnection {
+        std::shared_ptr<OriginStream> stream;
+        std::chrono::steady_clock::time_point since;
+    };
+
+    size_t _max_idle_per_origin;
+    std::chrono::milliseconds _idle_timeout;
+
+    std::mutex _mutex;
+    std::unordered_map<std::string, std::deque<IdleConnection>> _idle_connections;
+
+public:
+    ConnectionPool(size_t max_idle_per_origin, const std::chrono::milliseconds &idle_timeout);
+
+    ~ConnectionPool() = default;
+
+    // moves a healthy idle connection to the origin into stream, returns false if there is none
+    bool acquire(const std::string &origin, OriginStream &stream);
+
+    void release(const std::string &origin, OriginStream &&stream);
+
+    void purge();
+
+private:
+    static bool isHealthy(boost::asio::ip::tcp::socket &socket);
+};
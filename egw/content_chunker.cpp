@@ -0,0 +1,53 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "content_chunker.h"
+
+#include <array>
+
+// boundaries are checked on the high bits of the gear hash, which depend on the last 64 bytes,
+// more bits before the normal size and less after it to narrow the distribution of the sizes
+static const uint64_t MASK_SMALL = 0xfffc000000000000ULL;
+static const uint64_t MASK_LARGE = 0xffc0000000000000ULL;
+
+static std::array<uint64_t, 256> make_gear_table() {
+    // every egw must cut at the same places, the table is generated from a fixed seed (splitmix64)
+    std::array<uint64_t, 256> table;
+    uint64_t state = 0x6e646e2d68747470ULL;
+    for (auto &value : table) {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        value = z ^ (z >> 31);
+    }
+    return table;
+}
+
+static const std::array<uint64_t, 256> GEAR = make_gear_table();
+
+const size_t ContentChunker::MIN_SIZE;
+const size_t ContentChunker::NORMAL_SIZE;
+const size_t ContentChunker::MAX_SIZE;
+
+size_t ContentChunker::findBoundary(const char *data, size_t size) {
+    uint64_t hash = 0;
+    size_t end = size < MAX_SIZE ? size : MAX_SIZE;
+    for (size_t i = MIN_SIZE; i < end; ++i) {
+        hash = (hash << 1) + GEAR[static_cast<uint8_t>(data[i])];
+        if (!(hash & (i < NORMAL_SIZE ? MASK_SMALL : MASK_LARGE))) {
+            return i + 1;
+        }
+    }
+    return size >= MAX_SIZE ? MAX_SIZE : 0;
+}
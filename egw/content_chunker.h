@@ -0,0 +1,31 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// content-defined chunking (FastCDC), a boundary only depends on the bytes just before it,
+// so an edit only changes the chunks around it and the other ones keep their digest
+class ContentChunker {
+public:
+    static const size_t MIN_SIZE = 2048;
+    static const size_t NORMAL_SIZE = 4096;
+    // a chunk always fits in a single Data packet
+    static const size_t MAX_SIZE = 8192;
+
+    // length of the first chunk of data, 0 if its end is not in data yet
+    static size_t findBoundary(const char *data, size_t size);
+};
@@ -0,0 +1,120 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "dns_cache.h"
+
+#include <algorithm>
+#include <iostream>
+
+DnsCache::DnsCache(std::unique_ptr<DnsResolver> resolver, const std::chrono::seconds &min_ttl,
+                   const std::chrono::seconds &max_ttl, const std::chrono::seconds &negative_ttl)
+        : _resolver(std::move(resolver))
+        , _min_ttl(min_ttl)
+        , _max_ttl(max_ttl)
+        , _negative_ttl(negative_ttl) {
+
+}
+
+void DnsCache::setResolver(std::unique_ptr<DnsResolver> resolver) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _drained.wait(lock, [this] { return !_replacing; });
+    _replacing = true;
+    // answers of the former resolver must not be cached once it is replaced
+    _drained.wait(lock, [this] { return _pendings.empty(); });
+    _resolver = std::move(resolver);
+    _entries.clear();
+    _replacing = false;
+    _drained.notify_all();
+}
+
+void DnsCache::resolve(const std::string &domain, const std::string &port, const DnsResolver::Callback &callback) {
+    std::string key = domain + ":" + port;
+    Entry entry;
+    bool hit = false;
+    std::shared_ptr<DnsResolver> resolver;
+    { // block for RAII
+        std::unique_lock<std::mutex> lock(_mutex);
+        auto it = _entries.find(key);
+        if (it != _entries.end() && it->second.expiration > std::chrono::steady_clock::now()) {
+            entry = it->second;
+            hit = true;
+        } else {
+            if (_pendings.find(key) == _pendings.end()) {
+                // a new lookup is only started with the resolver which will stay in place
+                _drained.wait(lock, [this] { return !_replacing; });
+            }
+            resolver = _resolver;
+            auto &callbacks = _pendings[key];
+            callbacks.push_back(callback);
+            if (callbacks.size() > 1) {
+                // a lookup of this domain is already in progress
+                return;
+            }
+        }
+    }
+
+    if (hit) {
+        auto ttl = std::chrono::duration_cast<std::chrono::seconds>(entry.expiration - std::chrono::steady_clock::now());
+        callback(entry.err, entry.endpoints, ttl);
+    } else {
+        resolver->resolve(domain, port, [this, key](const boost::system::error_code &err,
+                                                    const std::vector<boost::asio::ip::tcp::endpoint> &endpoints,
+                                                    const std::chrono::seconds &ttl) {
+            onResolved(key, err, endpoints, ttl);
+        });
+    }
+}
+
+void DnsCache::onResolved(const std::string &key, const boost::system::error_code &err,
+                          const std::vector<boost::asio::ip::tcp::endpoint> &endpoints, const std::chrono::seconds &ttl) {
+    std::vector<DnsResolver::Callback> callbacks;
+    std::chrono::seconds bounded_ttl = err || endpoints.empty() ? _negative_ttl : std::min(std::max(ttl, _min_ttl), _max_ttl);
+    { // block for RAII
+        std::lock_guard<std::mutex> lock(_mutex);
+        _entries[key] = Entry{err, endpoints, std::chrono::steady_clock::now() + bounded_ttl};
+        auto it = _pendings.find(key);
+        if (it != _pendings.end()) {
+            callbacks = std::move(it->second);
+            _pendings.erase(it);
+        }
+        if (_pendings.empty()) {
+            _drained.notify_all();
+        }
+    }
+    for (const auto &callback : callbacks) {
+        callback(err, endpoints, bounded_ttl);
+    }
+}
+
+void DnsCache::purge() {
+    std::lock_guard<std::mutex> lock(_mutex);
+#ifndef NDEBUG
+    size_t remove_count = 0;
+#endif
+    auto time_point = std::chrono::steady_clock::now();
+    auto it = _entries.begin();
+    while (it != _entries.end()) {
+        if (it->second.expiration <= time_point) {
+            it = _entries.erase(it);
+#ifndef NDEBUG
+            ++remove_count;
+#endif
+        } else {
+            ++it;
+        }
+    }
+#ifndef NDEBUG
+    std::cout << remove_count << " DNS entries expired (" << _entries.size() << " remaining)" << std::endl;
+#endif
+}
@@ -0,0 +1,63 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "dns_resolver.h"
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// caches the answers of a DnsResolver, failures included, and merges concurrent lookups of the same domain
+class DnsCache {
+private:
+    struct Entry {
+        boost::system::error_code err;
+        std::vector<boost::asio::ip::tcp::endpoint> endpoints;
+        std::chrono::steady_clock::time_point expiration;
+    };
+
+    // shared with the lookups in progress, so a replaced resolver lives until they complete
+    std::shared_ptr<DnsResolver> _resolver;
+    std::chrono::seconds _min_ttl;
+    std::chrono::seconds _max_ttl;
+    std::chrono::seconds _negative_ttl;
+
+    std::mutex _mutex;
+    std::unordered_map<std::string, Entry> _entries;
+    std::unordered_map<std::string, std::vector<DnsResolver::Callback>> _pendings;
+    // new lookups wait while the resolver is replaced, the replacement waits for the lookups in progress
+    bool _replacing = false;
+    std::condition_variable _drained;
+
+public:
+    DnsCache(std::unique_ptr<DnsResolver> resolver, const std::chrono::seconds &min_ttl,
+             const std::chrono::seconds &max_ttl, const std::chrono::seconds &negative_ttl);
+
+    ~DnsCache() = default;
+
+    // waits for the lookups in progress, so it must not be called from the context running the resolver callbacks
+    void setResolver(std::unique_ptr<DnsResolver> resolver);
+
+    // the callback is called directly on a cache hit, otherwise from the resolver context
+    void resolve(const std::string &domain, const std::string &port, const DnsResolver::Callback &callback);
+
+    void purge();
+
+private:
+    void onResolved(const std::string &key, const boost::system::error_code &err,
+                    const std::vector<boost::asio::ip::tcp::endpoint> &endpoints, const std::chrono::seconds &ttl);
+};
@@ -0,0 +1,35 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <boost/asio.hpp>
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+// resolves a domain into TCP endpoints, with the time for which the answer may be kept
+class DnsResolver {
+public:
+    typedef std::function<void(const boost::system::error_code&, const std::vector<boost::asio::ip::tcp::endpoint>&,
+                               const std::chrono::seconds&)> Callback;
+
+    DnsResolver() = default;
+
+    virtual ~DnsResolver() = default;
+
+    virtual void resolve(const std::string &domain, const std::string &port, const Callback &callback) = 0;
+};
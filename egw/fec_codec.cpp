@@ -0,0 +1,145 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "fec_codec.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+struct GaloisTables {
+    std::array<uint8_t, 512> exp;
+    std::array<uint8_t, 256> log;
+
+    GaloisTables() : exp(), log() {
+        // generator 2 of the field built on the polynomial x^8 + x^4 + x^3 + x^2 + 1
+        unsigned value = 1;
+        for (size_t i = 0; i < 255; ++i) {
+            exp[i] = exp[i + 255] = static_cast<uint8_t>(value);
+            log[value] = static_cast<uint8_t>(i);
+            value <<= 1;
+            if (value & 0x100) {
+                value ^= 0x11d;
+            }
+        }
+    }
+};
+
+static const GaloisTables GF;
+
+static uint8_t gf_mul(uint8_t a, uint8_t b) {
+    return (a == 0 || b == 0) ? 0 : GF.exp[GF.log[a] + GF.log[b]];
+}
+
+static uint8_t gf_inv(uint8_t a) {
+    return GF.exp[255 - GF.log[a]];
+}
+
+// coefficient of a segment in a repair segment, 1 / (x + y) with distinct x for repairs and y for segments
+static uint8_t cauchy(size_t repair, size_t segment) {
+    return gf_inv(static_cast<uint8_t>((255 - repair) ^ segment));
+}
+
+// adds factor * source to target, the addition of GF(256) is a xor
+static void add_scaled(std::string &target, const std::string &source, uint8_t factor) {
+    if (factor == 0) {
+        return;
+    }
+    size_t size = std::min(target.size(), source.size());
+    for (size_t i = 0; i < size; ++i) {
+        target[i] = static_cast<char>(static_cast<uint8_t>(target[i]) ^ gf_mul(factor, static_cast<uint8_t>(source[i])));
+    }
+}
+
+std::vector<std::string> FecCodec::encode(const std::vector<std::string> &segments, size_t repair_count) {
+    size_t size = 0;
+    for (const auto &segment : segments) {
+        size = std::max(size, segment.size());
+    }
+    std::vector<std::string> repairs(repair_count, std::string(size, '\0'));
+    for (size_t j = 0; j < repair_count; ++j) {
+        for (size_t i = 0; i < segments.size(); ++i) {
+            add_scaled(repairs[j], segments[i], cauchy(j, i));
+        }
+    }
+    return repairs;
+}
+
+bool FecCodec::decode(std::vector<std::string> &segments, const std::vector<bool> &received,
+                      const std::map<size_t, std::string> &repairs, const std::vector<size_t> &sizes) {
+    std::vector<size_t> missing;
+    for (size_t i = 0; i < segments.size(); ++i) {
+        if (!received[i]) {
+            missing.push_back(i);
+        }
+    }
+    if (missing.empty()) {
+        return true;
+    }
+    if (repairs.size() < missing.size()) {
+        return false;
+    }
+
+    // every repair used loses the contribution of the received segments, leaving a system on the missing ones
+    size_t count = missing.size();
+    std::vector<std::vector<uint8_t>> matrix(count, std::vector<uint8_t>(2 * count, 0));
+    std::vector<std::string> syndromes;
+    auto repairs_it = repairs.begin();
+    for (size_t a = 0; a < count; ++a, ++repairs_it) {
+        std::string syndrome = repairs_it->second;
+        for (size_t i = 0; i < segments.size(); ++i) {
+            if (received[i]) {
+                add_scaled(syndrome, segments[i], cauchy(repairs_it->first, i));
+            }
+        }
+        syndromes.push_back(syndrome);
+        for (size_t b = 0; b < count; ++b) {
+            matrix[a][b] = cauchy(repairs_it->first, missing[b]);
+        }
+        matrix[a][count + a] = 1;
+    }
+
+    // Gauss-Jordan elimination, any square submatrix of a Cauchy matrix is invertible
+    for (size_t column = 0; column < count; ++column) {
+        size_t pivot = column;
+        while (pivot < count && matrix[pivot][column] == 0) {
+            ++pivot;
+        }
+        if (pivot == count) {
+            return false;
+        }
+        std::swap(matrix[pivot], matrix[column]);
+        uint8_t factor = gf_inv(matrix[column][column]);
+        for (auto &value : matrix[column]) {
+            value = gf_mul(value, factor);
+        }
+        for (size_t row = 0; row < count; ++row) {
+            if (row != column && matrix[row][column] != 0) {
+                uint8_t scale = matrix[row][column];
+                for (size_t k = 0; k < 2 * count; ++k) {
+                    matrix[row][k] ^= gf_mul(scale, matrix[column][k]);
+                }
+            }
+        }
+    }
+
+    for (size_t b = 0; b < count; ++b) {
+        std::string segment(syndromes[0].size(), '\0');
+        for (size_t a = 0; a < count; ++a) {
+            add_scaled(segment, syndromes[a], matrix[b][count + a]);
+        }
+        segment.resize(sizes[missing[b]]);
+        segments[missing[b]] = segment;
+    }
+    return true;
+}
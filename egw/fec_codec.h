@@ -0,0 +1,32 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+// systematic Reed-Solomon erasure code over GF(256) with a Cauchy matrix, a block of segments can be rebuilt
+// from any of its segments and repair segments as long as there are as many of them as segments in the block
+class FecCodec {
+public:
+    // repair segments of a block, shorter segments are padded with zeros to the longest one
+    static std::vector<std::string> encode(const std::vector<std::string> &segments, size_t repair_count);
+
+    // rebuilds the segments not received from the repair segments, sizes gives the length of every segment,
+    // false if there are not enough repair segments
+    static bool decode(std::vector<std::string> &segments, const std::vector<bool> &received,
+                       const std::map<size_t, std::string> &repairs, const std::vector<size_t> &sizes);
+};
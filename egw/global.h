@@ -16,6 +16,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <boost/asio.hpp>
 
+#include <chrono>
+
 namespace global {
     const boost::posix_time::milliseconds DEFAULT_WAIT_REDO(5);
     const boost::posix_time::seconds DEFAULT_WAIT_PURGE(60);
@@ -23,4 +25,42 @@ namespace global {
     const boost::posix_time::seconds DEFAULT_TIMEOUT_READ_HTTP_HEADER(5);
     const boost::posix_time::seconds DEFAULT_TIMEOUT_READ_HTTP_BODY(2);
     const uint32_t DEFAULT_BUFFER_SIZE = 4096;
+    const boost::posix_time::milliseconds DEFAULT_WAIT_FLUSH(20);
+    const uint32_t TLV_SEGMENT_OFFSET = 128;
+    const uint32_t TLV_CHUNK_LIST = 129;
+    const std::string CHUNK_NAMESPACE = "_chunk";
+    const uint32_t TLV_BODY_DIGEST = 130;
+    const std::string BODY_NAMESPACE = "_body";
+    const size_t DEFAULT_BODY_DIGEST_MAX_SIZE = 1024 * 1024;
+    const std::chrono::milliseconds DEFAULT_BODY_DIGEST_WAIT(500);
+    const uint32_t TLV_FEC = 131;
+    const uint32_t TLV_FEC_REPAIR = 132;
+    const std::string REPAIR_MARKER = "_repair";
+    const size_t DEFAULT_FEC_BLOCK_SIZE = 8;
+    const size_t DEFAULT_FEC_REPAIR_COUNT = 2;
+    const boost::posix_time::seconds DEFAULT_POOL_IDLE_TIMEOUT(15);
+    const size_t DEFAULT_POOL_MAX_IDLE_PER_ORIGIN = 6;
+    const size_t DEFAULT_TLS_SESSION_CACHE_SIZE = 1024;
+    const size_t DEFAULT_MAX_CONNECTIONS_PER_ORIGIN = 6;
+    const size_t DEFAULT_MAX_CONNECTIONS = 256;
+    const size_t DEFAULT_MAX_QUEUED_REQUESTS = 1024;
+    const std::chrono::seconds DEFAULT_DNS_TTL(60);
+    const std::chrono::seconds DEFAULT_DNS_MIN_TTL(5);
+    const std::chrono::seconds DEFAULT_DNS_MAX_TTL(300);
+    const std::chrono::seconds DEFAULT_DNS_NEGATIVE_TTL(5);
+    const std::chrono::seconds DEFAULT_FAILURE_TTL_RESOLVE(30);
+    const std::chrono::seconds DEFAULT_FAILURE_TTL_CONNECT(10);
+    const size_t DEFAULT_RANGED_MIN_SIZE = 8 * 1024 * 1024;
+    const size_t DEFAULT_RANGED_PARTS = 4;
+    const size_t DEFAULT_COMPRESSION_MIN_SIZE = 1024;
+    const size_t DEFAULT_REVALIDATION_CACHE_SIZE = 64 * 1024 * 1024;
+    const size_t DEFAULT_REVALIDATION_MAX_BODY_SIZE = 4 * 1024 * 1024;
+    const boost::posix_time::hours DEFAULT_HEURISTIC_FRESHNESS_MAX(24);
+    const int DEFAULT_HEURISTIC_FRESHNESS_DIVISOR = 10;
+    const std::chrono::seconds DEFAULT_IN_FLIGHT_TIMEOUT(30);
+    const size_t DEFAULT_BUSY_IN_FLIGHT = 512;
+    const size_t DEFAULT_BUSY_ORIGIN_LOAD = DEFAULT_MAX_CONNECTIONS + DEFAULT_MAX_QUEUED_REQUESTS / 2;
+    const std::string CANCEL_MARKER = "cancel";
+    const std::string REFRESH_MARKER = "_refresh";
+    const std::string BATCH_MARKER = "_batch";
 };
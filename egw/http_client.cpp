@@ -13,25 +13,40 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "http_client.h"
+#include "system_dns_resolver.h"
+#include "cache_control.h"
 
 #include <fstream>
+#include <set>
+#include <algorithm>
 
 #ifndef NDEBUG
 std::atomic<size_t> HttpClient::HttpSession::count {0};
 #endif
 
-HttpClient::HttpSession::HttpSession(HttpClient &http_client, const std::shared_ptr<HttpRequest> &http_request)
+HttpClient::HttpSession::HttpSession(HttpClient &http_client, const std::shared_ptr<HttpRequest> &http_request,
+                                     const std::shared_ptr<HttpResponse> &part_response)
         : _http_client(http_client)
         , _timer(http_client._ios)
         , _strand(http_client._ios)
-        , _socket(http_client._ios)
-        , _http_request(http_request) {
+        , _stream(http_client._ios)
+        , _http_request(http_request)
+        , _http_response(part_response)
+        , _secure(is_secure(http_request))
+        , _origin(make_origin(http_request))
+        , _is_part(static_cast<bool>(part_response)) {
 #ifndef NDEBUG
     std::cout << "new session (" << ++count << " active session(s))" << std::endl;
 #endif
 }
 
 HttpClient::HttpSession::~HttpSession() {
+    if (_holds_slot) {
+        auto task = _http_client._scheduler.release(_origin);
+        if (task) {
+            _http_client._ios.post(task);
+        }
+    }
 #ifndef NDEBUG
     std::cout << "session destroyed (" << --count << " remaining session(s))" << std::endl;
 #endif
@@ -43,7 +58,59 @@ void HttpClient::HttpSession::start() {
     //_http_request->set_field("accept", "*/*");
     //std::cout << _http_request->get_field("host") << _http_request->get_path() << std::endl;
     //_http_request->set_field("connection", "close");
-    _http_response = std::make_shared<HttpResponse>();
+    // only called once a slot for the origin is granted by the scheduler
+    _holds_slot = true;
+    if (!_is_part) {
+        _http_response = std::make_shared<HttpResponse>();
+    }
+    if (_is_part && _http_response->getRawStream()->is_aborted()) {
+        // the download was given up while the part was queued
+        return;
+    } else if (!_is_part && _http_client.fail_fast(_http_request)) {
+        // the origin failed while the request was queued
+        return;
+    } else if (std::chrono::steady_clock::now() < _http_request->getDeadline()) {
+        std::string host = _http_request->get_field("host");
+        // the egw decides of the persistence of its own connections
+        if (_http_request->get_version() == "HTTP/1.1") {
+            _http_request->set_field("connection", "keep-alive");
+        }
+        add_validators();
+        if (!host.empty() && _http_client._pool.acquire(_origin, _stream)) {
+            _reused = true;
+            write_request_header();
+        } else {
+            if (_secure) {
+                _stream.enableTls(_http_client._tls_context);
+            }
+            resolve_domain();
+        }
+    } else {
+        // the ingress gateway has already answered its client
+        std::cerr << _http_request->get_field("host") << _http_request->get_path() << " -> deadline exceeded" << std::endl;
+        _http_response->getRawStream()->is_aborted(true);
+        deliver(_http_response);
+    }
+}
+
+bool HttpClient::HttpSession::is_retryable(bool sent) {
+    // RFC 7230 section 6.3.1, the origin may have run a request it was sent, only an idempotent one can run twice
+    static const std::set<std::string> IDEMPOTENT_METHODS {"GET", "HEAD", "PUT", "DELETE", "OPTIONS", "TRACE"};
+    return _reused && (!sent || IDEMPOTENT_METHODS.count(_http_request->get_method()) > 0);
+}
+
+void HttpClient::HttpSession::retry_with_new_connection() {
+    // an idle connection may have been closed by the origin while it was sent the request
+#ifndef NDEBUG
+    std::cout << _http_request->get_field("host") << _http_request->get_path() << " -> reused connection closed, retrying" << std::endl;
+#endif
+    _reused = false;
+    // the TLS state of the pooled connection can't be used by a new one
+    _stream = OriginStream(_http_client._ios);
+    if (_secure) {
+        _stream.enableTls(_http_client._tls_context);
+    }
+    _read_buffer.consume(_read_buffer.size());
     resolve_domain();
 }
 
@@ -52,67 +119,110 @@ void HttpClient::HttpSession::resolve_domain() {
     if (!host.empty()) {
         auto delimiter = host.find(':');
         std::string domain = host.substr(0, delimiter);
-        std::string port = delimiter != std::string::npos ? host.substr(delimiter + 1) : "80";
-        boost::asio::ip::tcp::resolver::query query(domain, port, boost::asio::ip::tcp::resolver::query::numeric_service);
-        _http_client._resolver.async_resolve(query, boost::bind(&HttpSession::resolve_domain_handler, shared_from_this(), _1, _2));
+        std::string port = delimiter != std::string::npos ? host.substr(delimiter + 1) : (_secure ? "443" : "80");
+        _http_client._dns_cache.resolve(domain, port, boost::bind(&HttpSession::resolve_domain_handler, shared_from_this(), _1, _2));
     } else {
         std::cerr << "HTTP request with empty host field" << std::endl;
         auto http_response = std::make_shared<HttpResponse>();
         http_response->getRawStream()->is_aborted(true);
-        _http_client._http_source->fromHttpSink(_http_request, http_response);
+        deliver(http_response);
     }
 }
 
-void HttpClient::HttpSession::resolve_domain_handler(const boost::system::error_code &err, boost::asio::ip::tcp::resolver::iterator iterator) {
-    if(!err) {
-        connect(iterator);
+void HttpClient::HttpSession::resolve_domain_handler(const boost::system::error_code &err, const std::vector<boost::asio::ip::tcp::endpoint> &endpoints) {
+    if(!err && !endpoints.empty()) {
+        _endpoints = endpoints;
+        connect(0);
     } else {
         std::cerr << _http_request->get_field("host") << _http_request->get_path() << " -> error while resolving domain" << std::endl;
-        auto http_response = std::make_shared<HttpResponse>();
-        http_response->getRawStream()->is_aborted(true);
-        _http_client._http_source->fromHttpSink(_http_request, http_response);
+        fail("can't resolve " + _http_request->get_field("host"), _http_client._resolve_failure_ttl);
     }
 }
 
-void HttpClient::HttpSession::connect(boost::asio::ip::tcp::resolver::iterator iterator) {
-    _timer.expires_from_now(global::DEFAULT_TIMEOUT_CONNECT);
+void HttpClient::HttpSession::connect(size_t index) {
+    _timer.expires_from_now(bounded_timeout(global::DEFAULT_TIMEOUT_CONNECT));
     _timer.async_wait(_strand.wrap(boost::bind(&HttpSession::timer_handler,shared_from_this(), _1)));
-    boost::asio::async_connect(_socket, iterator, _strand.wrap(boost::bind(&HttpSession::connect_handler,shared_from_this(), _1, _2)));
+    _stream.socket().async_connect(_endpoints[index], _strand.wrap(boost::bind(&HttpSession::connect_handler,shared_from_this(), _1, index)));
 }
 
-void HttpClient::HttpSession::connect_handler(const boost::system::error_code &err, boost::asio::ip::tcp::resolver::iterator iterator) {
+void HttpClient::HttpSession::connect_handler(const boost::system::error_code &err, size_t index) {
     _timer.cancel();
     if(!err) {
+        _http_client._negative_cache.erase(_origin);
+        if (_secure) {
+            handshake();
+        } else {
+            write_request_header();
+        }
+    } else if (index + 1 < _endpoints.size()) {
+        _stream.socket().close();
+        connect(index + 1);
+    } else if (std::chrono::steady_clock::now() < _http_request->getDeadline()) {
+        std::cerr << _http_request->get_field("host") << _http_request->get_path() << " -> error while connecting to " << _http_request->get_field("host") << std::endl;
+        fail("can't connect to " + _http_request->get_field("host") + " (" + err.message() + ")", _http_client._connect_failure_ttl);
+    } else {
+        // the connection was given up because of the client, the origin is not to blame
+        auto http_response = std::make_shared<HttpResponse>();
+        http_response->getRawStream()->is_aborted(true);
+        deliver(http_response);
+    }
+}
+
+void HttpClient::HttpSession::handshake() {
+    std::string domain = _http_request->get_field("host");
+    domain = domain.substr(0, domain.find(':'));
+    SSL *ssl = _stream.tls().native_handle();
+    // SNI is required by most HTTPS origins sharing an address
+    SSL_set_tlsext_host_name(ssl, domain.c_str());
+    _stream.tls().set_verify_callback(boost::asio::ssl::rfc2818_verification(domain));
+    _http_client._tls_sessions.prepare(_origin, ssl);
+
+    _timer.expires_from_now(bounded_timeout(global::DEFAULT_TIMEOUT_CONNECT));
+    _timer.async_wait(_strand.wrap(boost::bind(&HttpSession::timer_handler, shared_from_this(), _1)));
+    _stream.tls().async_handshake(boost::asio::ssl::stream_base::client,
+                                  _strand.wrap(boost::bind(&HttpSession::handshake_handler, shared_from_this(), _1)));
+}
+
+void HttpClient::HttpSession::handshake_handler(const boost::system::error_code &err) {
+    _timer.cancel();
+    if (!err) {
+#ifndef NDEBUG
+        std::cout << _origin << " -> TLS session " << (SSL_session_reused(_stream.tls().native_handle()) ? "resumed" : "negotiated") << std::endl;
+#endif
+        _http_client._tls_sessions.store(_origin, _stream.tls().native_handle());
         write_request_header();
-    } else if (iterator != boost::asio::ip::tcp::resolver::iterator()) {
-        _socket.close();
-        connect(++iterator);
+    } else if (std::chrono::steady_clock::now() < _http_request->getDeadline()) {
+        std::cerr << _http_request->get_field("host") << _http_request->get_path() << " -> TLS handshake failed (" << err.message() << ")" << std::endl;
+        // a rejected session must not be offered again
+        _http_client._tls_sessions.erase(_origin);
+        fail("TLS handshake with " + _http_request->get_field("host") + " failed (" + err.message() + ")", _http_client._connect_failure_ttl);
     } else {
-        std::cerr << _http_request->get_field("host") << _http_request->get_path() << " -> error while connecting to " << _http_request->get_field("host") << std::endl;
         auto http_response = std::make_shared<HttpResponse>();
         http_response->getRawStream()->is_aborted(true);
-        _http_client._http_source->fromHttpSink(_http_request, http_response);
+        deliver(http_response);
     }
 }
 
 void HttpClient::HttpSession::write_request_header() {
     if (!_http_request->getRawStream()->is_aborted()) {
-        boost::asio::async_write(_socket, boost::asio::buffer(_http_request->make_header()),
+        boost::asio::async_write(_stream, boost::asio::buffer(_http_request->make_header()),
                                  boost::bind(&HttpSession::write_request_header_handler, shared_from_this(), _1, _2));
     } else {
         std::cerr << _http_request->get_field("host") << _http_request->get_path() << "is aborted" << std::endl;
         _http_response->getRawStream()->is_aborted(true);
-        _http_client._http_source->fromHttpSink(_http_request, _http_response);
+        deliver(_http_response);
     }
 }
 
 void HttpClient::HttpSession::write_request_header_handler(const boost::system::error_code &err, size_t bytes_transferred) {
     if(!err){
         write_request_body(0);
+    } else if (is_retryable(bytes_transferred > 0)) {
+        retry_with_new_connection();
     } else {
         std::cerr << _http_request->get_field("host") << _http_request->get_path() << " -> error while sending header" << std::endl;
         _http_response->getRawStream()->is_aborted(true);
-        _http_client._http_source->fromHttpSink(_http_request, _http_response);
+        deliver(_http_response);
     }
 }
 
@@ -120,7 +230,7 @@ void HttpClient::HttpSession::write_request_body(size_t total_bytes_transferred)
     if (!_http_request->getRawStream()->is_aborted()) {
         long read_bytes = _http_request->getRawStream()->readRawData(total_bytes_transferred, _write_buffer, global::DEFAULT_BUFFER_SIZE);
         if (read_bytes > 0) {
-            boost::asio::async_write(_socket, boost::asio::buffer(_write_buffer, read_bytes),
+            boost::asio::async_write(_stream, boost::asio::buffer(_write_buffer, read_bytes),
                                      boost::bind(&HttpSession::write_request_body_handler, shared_from_this(), _1, _2, total_bytes_transferred));
         } else if (read_bytes < 0) {
             //not enough data in request stream
@@ -132,7 +242,7 @@ void HttpClient::HttpSession::write_request_body(size_t total_bytes_transferred)
     } else {
         std::cerr << _http_request->get_field("host") << _http_request->get_path() << " is aborted" << std::endl;
         _http_response->getRawStream()->is_aborted(true);
-        _http_client._http_source->fromHttpSink(_http_request, _http_response);
+        deliver(_http_response);
     }
 }
 
@@ -142,14 +252,14 @@ void HttpClient::HttpSession::write_request_body_handler(const boost::system::er
     } else {
         std::cerr << _http_request->get_field("host") << _http_request->get_path() << " -> error while sending body" << std::endl;
         _http_response->getRawStream()->is_aborted(true);
-        _http_client._http_source->fromHttpSink(_http_request, _http_response);
+        deliver(_http_response);
     }
 }
 
 void HttpClient::HttpSession::read_response_header() {
-    _timer.expires_from_now(global::DEFAULT_TIMEOUT_READ_HTTP_HEADER);
+    _timer.expires_from_now(bounded_timeout(global::DEFAULT_TIMEOUT_READ_HTTP_HEADER));
     _timer.async_wait(_strand.wrap(boost::bind(&HttpSession::timer_handler, shared_from_this(), _1)));
-    boost::asio::async_read_until(_socket, _read_buffer, "\r\n\r\n",
+    boost::asio::async_read_until(_stream, _read_buffer, "\r\n\r\n",
                                   _strand.wrap(boost::bind(&HttpSession::read_response_header_handler, shared_from_this(), _1, _2)));
 }
 
@@ -173,12 +283,12 @@ HttpClient::HttpSession::read_response_header_handler(const boost::system::error
                 _http_response->set_reason(header_line.substr(last_delimiter_index, (header_line.length() - last_delimiter_index) - 1));
             } else {
                 _http_response->getRawStream()->is_aborted(true);
-                _http_client._http_source->fromHttpSink(_http_request, _http_response);
+                deliver(_http_response);
                 return;
             }
         } else {
             _http_response->getRawStream()->is_aborted(true);
-            _http_client._http_source->fromHttpSink(_http_request, _http_response);
+            deliver(_http_response);
             return;
         }
 
@@ -194,78 +304,114 @@ HttpClient::HttpSession::read_response_header_handler(const boost::system::error
 
         if(_http_response->has_minimal_requirements()) {
             _http_response->is_parsed(true);
-            _http_client._http_source->fromHttpSink(_http_request, _http_response);
+            if (_is_part) {
+                read_part_body(additional_bytes);
+                return;
+            }
+            if (_revalidating && _http_response->get_status_code() == "304") {
+                // the body of the 304 is empty, the cached one is sent instead
+                replay_revalidated_response();
+                complete_response(true);
+                return;
+            }
+            record_response();
+            deliver(_http_response);
             if(_http_request->get_method() != "HEAD") {
                 if (!_http_response->get_field("content-length").empty()) {
+                    size_t content_length = std::stoul(_http_response->get_field("content-length"));
+                    // this session only reads the first region of a split body
+                    size_t region_size = split_response(content_length, additional_bytes);
                     if(additional_bytes > 0) {
-                        _http_response->getRawStream()->append_raw_data(is);
+                        append_body(std::string(std::istreambuf_iterator<char>(is), {}));
                     }
-                    read_response_body(std::stoul(_http_response->get_field("content-length")) - additional_bytes);
+                    read_response_body((region_size > 0 ? region_size : content_length) - additional_bytes);
                 } else if (_http_response->get_field("transfer-encoding") == "chunked") {
                     read_response_body_chunk(-1);
                 } else if (_http_response->get_version() == "HTTP/1.0" || _http_response->get_field("connection") == "close") {
                     if(additional_bytes > 0) {
-                        _http_response->getRawStream()->append_raw_data(is);
+                        append_body(std::string(std::istreambuf_iterator<char>(is), {}));
                     }
                     read_response_body_old();
                     // response without body
                 } else {
-                    _http_response->getRawStream()->is_completed(true);
+                    std::string status_code = _http_response->get_status_code();
+                    complete_response(status_code == "204" || status_code == "304");
                 }
                 // response to HEAD request
             } else {
-                _http_response->getRawStream()->is_completed(true);
+                complete_response(true);
             }
             // response header does not fit requirements
         } else {
             std::cerr << _http_request->get_field("host") << _http_request->get_path() << " -> ill-formed response header " << std::endl;
             _http_response->getRawStream()->is_aborted(true);
-            _http_client._http_source->fromHttpSink(_http_request, _http_response);
+            deliver(_http_response);
         }
+    } else if ((err == boost::asio::error::eof || err == boost::asio::error::connection_reset ||
+                err == boost::asio::ssl::error::stream_truncated) && is_retryable(true)) {
+        retry_with_new_connection();
     } else {
         std::cerr << _http_request->get_field("host") << _http_request->get_path() << " -> error while receiving header" << std::endl;
         _http_response->getRawStream()->is_aborted(true);
-        _http_client._http_source->fromHttpSink(_http_request, _http_response);
+        deliver(_http_response);
     }
 }
 
 void HttpClient::HttpSession::read_response_body(long remaining_bytes) {
+    if (_http_response->getRawStream()->is_aborted()) {
+        // response cancelled by the NDN side, no need to download the remaining bytes
+        _stream.socket().close();
+        return;
+    }
     if (remaining_bytes > 0) {
         _timer.expires_from_now(global::DEFAULT_TIMEOUT_READ_HTTP_BODY);
         _timer.async_wait(_strand.wrap(boost::bind(&HttpSession::timer_handler, shared_from_this(), _1)));
-        boost::asio::async_read(_socket, _read_buffer, boost::asio::transfer_at_least(1),
+        boost::asio::async_read(_stream, _read_buffer, boost::asio::transfer_at_least(1),
                                 _strand.wrap(boost::bind(&HttpSession::read_response_body_handler, shared_from_this(), _1, _2, remaining_bytes)));
+    } else if (_ranged_download) {
+        // the rest of the body is downloaded by the parts, this connection can't be reused
+        _timer.cancel();
+        _stream.socket().close();
+        _ranged_download->first_done = true;
     } else {
-        _http_response->getRawStream()->is_completed(true);
+        complete_response(true);
     }
 }
 
 void HttpClient::HttpSession::read_response_body_handler(const boost::system::error_code &err, size_t bytes_transferred, long remaining_bytes) {
     _timer.cancel();
     if (!err) {
-        _http_response->getRawStream()->append_raw_data(&_read_buffer);
-        read_response_body(remaining_bytes - bytes_transferred);
+        // bytes past the expected length belong to the rest of a split body
+        size_t size = std::min<size_t>(remaining_bytes, _read_buffer.size());
+        auto begin = boost::asio::buffers_begin(_read_buffer.data());
+        append_body(std::string(begin, begin + size));
+        _read_buffer.consume(size);
+        read_response_body(remaining_bytes - size);
     } else {
         _http_response->getRawStream()->is_aborted(true);
     }
 }
 
 void HttpClient::HttpSession::read_response_body_chunk(long chunk_size) {
+    if (_http_response->getRawStream()->is_aborted()) {
+        _stream.socket().close();
+        return;
+    }
     if(chunk_size > 0) {
         // handler needs more data
         _timer.expires_from_now(global::DEFAULT_TIMEOUT_READ_HTTP_BODY);
         _timer.async_wait(_strand.wrap(boost::bind(&HttpSession::timer_handler, shared_from_this(), _1)));
-        boost::asio::async_read(_socket, _read_buffer, boost::asio::transfer_at_least(1),
+        boost::asio::async_read(_stream, _read_buffer, boost::asio::transfer_at_least(1),
                                 _strand.wrap(boost::bind(&HttpSession::read_response_body_chunk_handler, shared_from_this(), _1, _2, chunk_size)));
     } else if(chunk_size < 0) {
         // find next chunk size
         _timer.expires_from_now(global::DEFAULT_TIMEOUT_READ_HTTP_BODY);
         _timer.async_wait(_strand.wrap(boost::bind(&HttpSession::timer_handler, shared_from_this(), _1)));
-        boost::asio::async_read_until(_socket, _read_buffer, "\r\n",
+        boost::asio::async_read_until(_stream, _read_buffer, "\r\n",
                                       _strand.wrap(boost::bind(&HttpSession::read_response_body_chunk_handler, shared_from_this(), _1, _2, chunk_size)));
     } else {
         // only possible when chunk size = 0, meaning the end of the body
-        _http_response->getRawStream()->is_completed(true);
+        read_response_trailer();
     }
 }
 
@@ -279,13 +425,16 @@ void HttpClient::HttpSession::read_response_body_chunk_handler(const boost::syst
             std::getline(stream, line);
             chunk_size = std::stol(line, 0, 16);
             line += "\n";
-            _http_response->getRawStream()->append_raw_data(line);
+            append_body(line);
         }
 
-        if(_read_buffer.size() >= chunk_size + 2) {
+        if (chunk_size == 0) {
+            // the last chunk has no data, only trailers and an empty line follow
+            read_response_body_chunk(0);
+        } else if(_read_buffer.size() >= chunk_size + 2) {
             char buffer[chunk_size + 2];
             stream.read(buffer, chunk_size + 2);
-            _http_response->getRawStream()->append_raw_data(buffer, chunk_size + 2);
+            append_body(std::string(buffer, chunk_size + 2));
             read_response_body_chunk(-chunk_size);
         } else {
             read_response_body_chunk(chunk_size);
@@ -295,40 +444,320 @@ void HttpClient::HttpSession::read_response_body_chunk_handler(const boost::syst
     }
 }
 
+void HttpClient::HttpSession::read_response_trailer() {
+    if (_http_response->getRawStream()->is_aborted()) {
+        _stream.socket().close();
+        return;
+    }
+    _timer.expires_from_now(global::DEFAULT_TIMEOUT_READ_HTTP_BODY);
+    _timer.async_wait(_strand.wrap(boost::bind(&HttpSession::timer_handler, shared_from_this(), _1)));
+    boost::asio::async_read_until(_stream, _read_buffer, "\r\n",
+                                  _strand.wrap(boost::bind(&HttpSession::read_response_trailer_handler, shared_from_this(), _1, _2)));
+}
+
+void HttpClient::HttpSession::read_response_trailer_handler(const boost::system::error_code &err, size_t bytes_transferred) {
+    _timer.cancel();
+    if (!err) {
+        std::istream stream(&_read_buffer);
+        std::string line;
+        std::getline(stream, line);
+        append_body(line + "\n");
+        if (line.empty() || line == "\r") {
+            // the whole response is read, the connection may serve another request
+            complete_response(true);
+        } else {
+            read_response_trailer();
+        }
+    } else {
+        _http_response->getRawStream()->is_aborted(true);
+    }
+}
+
 void HttpClient::HttpSession::read_response_body_old() {
+    if (_http_response->getRawStream()->is_aborted()) {
+        _stream.socket().close();
+        return;
+    }
     _timer.expires_from_now(global::DEFAULT_TIMEOUT_READ_HTTP_BODY);
     _timer.async_wait(_strand.wrap(boost::bind(&HttpSession::timer_handler, shared_from_this(), boost::asio::placeholders::error)));
-    boost::asio::async_read(_socket, _read_buffer, boost::asio::transfer_at_least(1),
+    boost::asio::async_read(_stream, _read_buffer, boost::asio::transfer_at_least(1),
                             _strand.wrap(boost::bind(&HttpSession::read_response_body_old_handler, shared_from_this(), _1, _2)));
 }
 
 void HttpClient::HttpSession::read_response_body_old_handler(const boost::system::error_code &err, size_t bytes_transferred) {
     _timer.cancel();
     if (!err) {
-        _http_response->getRawStream()->append_raw_data(&_read_buffer);
+        append_body(std::string(std::istreambuf_iterator<char>(&_read_buffer), {}));
         read_response_body_old();
     } else if(err == boost::asio::error::eof){
-        _http_response->getRawStream()->is_completed(true);
+        complete_response(false);
+    } else {
+        _http_response->getRawStream()->is_aborted(true);
+    }
+}
+
+std::string HttpClient::HttpSession::make_revalidation_key() {
+    // the only variation accepted for a recorded response is its content coding
+    return _origin + _http_request->get_path() + _http_request->get_query() + "|" +
+           _http_request->get_field("accept-encoding");
+}
+
+void HttpClient::HttpSession::add_validators() {
+    // a client revalidating its own copy must get the 304 of the origin
+    if (_http_request->get_method() != "GET" || !_http_request->get_field("if-none-match").empty() ||
+            !_http_request->get_field("if-modified-since").empty() || !_http_request->get_field("range").empty() ||
+            has_credentials()) {
+        return;
+    }
+    if (_http_client._revalidation_cache.find(make_revalidation_key(), _revalidated_entry)) {
+        auto etag_it = _revalidated_entry.fields.find("etag");
+        auto last_modified_it = _revalidated_entry.fields.find("last-modified");
+        if (etag_it != _revalidated_entry.fields.end()) {
+            _http_request->set_field("if-none-match", etag_it->second);
+        }
+        if (last_modified_it != _revalidated_entry.fields.end()) {
+            _http_request->set_field("if-modified-since", last_modified_it->second);
+        }
+        _revalidating = true;
+    }
+}
+
+void HttpClient::HttpSession::replay_revalidated_response() {
+    // fields of the 304 update the recorded ones, except the ones about the body and the connection,
+    // and cookies, which belong to a single user
+    for (const auto &field : _http_response->get_fields()) {
+        if (field.first != "content-length" && field.first != "transfer-encoding" && field.first != "content-encoding" &&
+                field.first != "connection" && field.first != "keep-alive" && field.first != "set-cookie") {
+            _revalidated_entry.fields[field.first] = field.second;
+        }
+    }
+    if (is_shareable(_revalidated_entry.fields)) {
+        _http_client._revalidation_cache.insert(make_revalidation_key(), _revalidated_entry);
+    } else {
+        // the origin made the response private, this user may still get it
+        _http_client._revalidation_cache.erase(make_revalidation_key());
+    }
+
+    auto http_response = std::make_shared<HttpResponse>();
+    http_response->set_version(_revalidated_entry.version);
+    http_response->set_status_code(_revalidated_entry.status_code);
+    http_response->set_reason(_revalidated_entry.reason);
+    for (const auto &field : _revalidated_entry.fields) {
+        http_response->set_field(field.first, field.second);
+    }
+    http_response->getRawStream()->append_raw_data(_revalidated_entry.body);
+    http_response->is_parsed(true);
+    http_response->getRawStream()->is_completed(true);
+    deliver(http_response);
+#ifndef NDEBUG
+    std::cout << _http_request->get_field("host") << _http_request->get_path() << " -> not modified, "
+              << _revalidated_entry.body.size() << " bytes served from the revalidation cache" << std::endl;
+#endif
+}
+
+void HttpClient::HttpSession::record_response() {
+    std::string vary = _http_response->get_field("vary");
+    std::transform(vary.begin(), vary.end(), vary.begin(), ::tolower);
+    std::string content_length = _http_response->get_field("content-length");
+    if (_http_request->get_method() == "GET" && _http_response->get_status_code() == "200" &&
+            (!_http_response->get_field("etag").empty() || !_http_response->get_field("last-modified").empty()) &&
+            !has_credentials() && is_shareable(_http_response->get_fields()) && (vary.empty() || vary == "accept-encoding") &&
+            std::strtoul(content_length.c_str(), nullptr, 10) <= global::DEFAULT_REVALIDATION_MAX_BODY_SIZE) {
+        _recorded_entry = std::make_shared<RevalidationCache::Entry>();
+        _recorded_entry->version = _http_response->get_version();
+        _recorded_entry->status_code = _http_response->get_status_code();
+        _recorded_entry->reason = _http_response->get_reason();
+        _recorded_entry->fields = _http_response->get_fields();
+    } else if (_revalidating) {
+        // the resource changed in a way that can't be revalidated anymore
+        _http_client._revalidation_cache.erase(make_revalidation_key());
+    }
+}
+
+bool HttpClient::HttpSession::has_credentials() {
+    return !_http_request->get_field("authorization").empty() || !_http_request->get_field("cookie").empty();
+}
+
+bool HttpClient::HttpSession::is_shareable(const std::map<std::string, std::string> &fields) {
+    if (fields.find("set-cookie") != fields.end()) {
+        return false;
+    }
+    auto it = fields.find("cache-control");
+    if (it == fields.end()) {
+        return true;
+    }
+    CacheControl cache_control(it->second);
+    return !cache_control.has("no-store") && !cache_control.has("private");
+}
+
+void HttpClient::HttpSession::append_body(const std::string &data) {
+    _http_response->getRawStream()->append_raw_data(data);
+    if (_recorded_entry) {
+        if (_recorded_entry->body.size() + data.size() <= global::DEFAULT_REVALIDATION_MAX_BODY_SIZE) {
+            _recorded_entry->body.append(data);
+        } else {
+            _recorded_entry.reset();
+        }
+    }
+}
+
+void HttpClient::HttpSession::fail(const std::string &reason, const std::chrono::seconds &ttl) {
+    _http_client._negative_cache.insert(_origin, reason, ttl);
+    // a real response so it is published through NDN and reaches every ingress gateway waiting for it
+    deliver(make_bad_gateway(reason, ttl));
+}
+
+void HttpClient::HttpSession::deliver(const std::shared_ptr<HttpResponse> &http_response) {
+    if (_is_part) {
+        // only failures are delivered by a part, they abort the whole download
+        _http_response->getRawStream()->is_aborted(true);
     } else {
+        _http_client._http_source->fromHttpSink(_http_request, http_response);
+    }
+}
+
+size_t HttpClient::HttpSession::split_response(size_t content_length, size_t additional_bytes) {
+    std::string accept_ranges = _http_response->get_field("accept-ranges");
+    std::transform(accept_ranges.begin(), accept_ranges.end(), accept_ranges.begin(), ::tolower);
+    // If-Range needs a strong validator, otherwise the parts may come from another version
+    std::string validator = _http_response->get_field("etag");
+    if (validator.empty() || validator.compare(0, 2, "W/") == 0) {
+        validator = _http_response->get_field("last-modified");
+    }
+    size_t region_size = (content_length + global::DEFAULT_RANGED_PARTS - 1) / global::DEFAULT_RANGED_PARTS;
+    if (_http_request->get_method() != "GET" || _http_response->get_status_code() != "200" || accept_ranges != "bytes" ||
+            content_length < global::DEFAULT_RANGED_MIN_SIZE || validator.empty() || additional_bytes >= region_size) {
+        return 0;
+    }
+
+    auto download = std::make_shared<RangedDownload>();
+    download->output = _http_response->getRawStream();
+    for (size_t first = region_size; first < content_length; first += region_size) {
+        size_t last = std::min(first + region_size, content_length) - 1;
+        auto part_request = std::make_shared<HttpRequest>();
+        part_request->set_method(_http_request->get_method());
+        part_request->set_version(_http_request->get_version());
+        part_request->set_path(_http_request->get_path());
+        part_request->set_query(_http_request->get_query());
+        for (const auto &field : _http_request->get_fields()) {
+            part_request->set_field(field.first, field.second);
+        }
+        part_request->unset_field("if-none-match");
+        part_request->unset_field("if-modified-since");
+        part_request->set_field("range", "bytes=" + std::to_string(first) + "-" + std::to_string(last));
+        part_request->set_field("if-range", validator);
+        part_request->is_parsed(true);
+
+        auto part_response = std::make_shared<HttpResponse>();
+        download->parts.emplace_back(part_response->getRawStream());
+        auto session = std::make_shared<HttpSession>(_http_client, part_request, part_response);
+        switch (_http_client._scheduler.submit(_origin, boost::bind(&HttpSession::start, session))) {
+            case OriginScheduler::ADMITTED:
+                session->start();
+                break;
+            case OriginScheduler::QUEUED:
+                break;
+            case OriginScheduler::REJECTED:
+            default:
+                part_response->getRawStream()->is_aborted(true);
+                break;
+        }
+    }
+#ifndef NDEBUG
+    std::cout << _http_request->get_field("host") << _http_request->get_path() << " -> " << content_length
+              << " bytes split in " << download->parts.size() + 1 << " ranges" << std::endl;
+#endif
+
+    // the recorded body would only hold the first region
+    _recorded_entry.reset();
+    _ranged_download = download;
+    _http_client.assemble_ranges(download, std::make_shared<boost::asio::deadline_timer>(_http_client._ios));
+    return region_size;
+}
+
+void HttpClient::HttpSession::read_part_body(size_t additional_bytes) {
+    // the origin sends the whole resource instead of the range when it changed since the first response
+    std::string range = _http_request->get_field("range");
+    auto delimiter_index = range.find('-');
+    size_t expected_length = std::stoul(range.substr(range.find('=') + 1, delimiter_index)) ;
+    expected_length = std::stoul(range.substr(delimiter_index + 1)) - expected_length + 1;
+    std::string content_length = _http_response->get_field("content-length");
+    if (_http_response->get_status_code() == "206" && !content_length.empty() && std::stoul(content_length) == expected_length) {
+        std::istream is(&_read_buffer);
+        size_t size = std::min(additional_bytes, expected_length);
+        std::string data(size, '\0');
+        is.read(&data[0], size);
+        append_body(data);
+        read_response_body(expected_length - size);
+    } else {
+        std::cerr << _http_request->get_field("host") << _http_request->get_path() << " -> range " << range << " refused" << std::endl;
         _http_response->getRawStream()->is_aborted(true);
+        _stream.socket().close();
+    }
+}
+
+void HttpClient::HttpSession::complete_response(bool reusable_connection) {
+    _http_response->getRawStream()->is_completed(true);
+    if (_secure) {
+        // tickets sent after the handshake have been read along with the response
+        _http_client._tls_sessions.store(_origin, _stream.tls().native_handle());
+    }
+    if (_recorded_entry) {
+        _http_client._revalidation_cache.insert(make_revalidation_key(), *_recorded_entry);
+        _recorded_entry.reset();
+    }
+
+    std::string connection = _http_response->get_field("connection");
+    std::transform(connection.begin(), connection.end(), connection.begin(), ::tolower);
+    bool persistent = _http_response->get_version() == "HTTP/1.1" ? connection.find("close") == std::string::npos
+                                                                   : connection.find("keep-alive") != std::string::npos;
+    // unread bytes mean the response framing was not understood, the connection can't be trusted anymore
+    if (reusable_connection && persistent && _read_buffer.size() == 0 && _stream.socket().is_open()) {
+        _timer.cancel();
+        _http_client._pool.release(_origin, std::move(_stream));
     }
 }
 
 void HttpClient::HttpSession::timer_handler(const boost::system::error_code &err) {
     if (!err) {
-        _socket.cancel();
-        _socket.close();
+        _stream.socket().cancel();
+        _stream.socket().close();
+    }
+}
+
+boost::posix_time::time_duration HttpClient::HttpSession::bounded_timeout(const boost::posix_time::time_duration &timeout) {
+    // the response header is useless once the client of the ingress gateway gave up
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(_http_request->getDeadline() - std::chrono::steady_clock::now()).count();
+    if (remaining < timeout.total_milliseconds()) {
+        return boost::posix_time::milliseconds(std::max<long>(remaining, 0));
     }
+    return timeout;
 }
 
 //--------------------------------------------------------------------------------------------------------------------------------------------------------------
 
-HttpClient::HttpClient(size_t concurrency) : Module(concurrency), _resolver(_ios) {
+HttpClient::HttpClient(size_t concurrency, const std::chrono::seconds &resolve_failure_ttl, const std::chrono::seconds &connect_failure_ttl)
+        : Module(concurrency)
+        , _dns_cache(std::unique_ptr<DnsResolver>(new SystemDnsResolver(_ios, global::DEFAULT_DNS_TTL)),
+                     global::DEFAULT_DNS_MIN_TTL, global::DEFAULT_DNS_MAX_TTL, global::DEFAULT_DNS_NEGATIVE_TTL)
+        , _scheduler(global::DEFAULT_MAX_CONNECTIONS_PER_ORIGIN, global::DEFAULT_MAX_CONNECTIONS, global::DEFAULT_MAX_QUEUED_REQUESTS)
+        , _pool(global::DEFAULT_POOL_MAX_IDLE_PER_ORIGIN, std::chrono::milliseconds(global::DEFAULT_POOL_IDLE_TIMEOUT.total_milliseconds()))
+        , _revalidation_cache(global::DEFAULT_REVALIDATION_CACHE_SIZE)
+        , _tls_context(boost::asio::ssl::context::sslv23_client)
+        , _tls_sessions(global::DEFAULT_TLS_SESSION_CACHE_SIZE)
+        , _resolve_failure_ttl(resolve_failure_ttl)
+        , _connect_failure_ttl(connect_failure_ttl)
+        , _purge_timer(_ios) {
+    _tls_context.set_options(boost::asio::ssl::context::default_workarounds | boost::asio::ssl::context::no_sslv2 |
+                             boost::asio::ssl::context::no_sslv3 | boost::asio::ssl::context::no_compression);
+    _tls_context.set_default_verify_paths();
+    _tls_context.set_verify_mode(boost::asio::ssl::verify_peer);
 
 }
 
 void HttpClient::run() {
-
+    _purge_timer.expires_from_now(global::DEFAULT_POOL_IDLE_TIMEOUT);
+    _purge_timer.async_wait(boost::bind(&HttpClient::purge_caches, this));
 }
 
 void HttpClient::fromHttpSource(const std::shared_ptr<HttpRequest> &http_request) {
@@ -336,5 +765,130 @@ void HttpClient::fromHttpSource(const std::shared_ptr<HttpRequest> &http_request
 }
 
 void HttpClient::fromHttpSourceHandler(const std::shared_ptr<HttpRequest> &http_request) {
-    std::make_shared<HttpSession>(*this, http_request)->start();
-}
\ No newline at end of file
+    if (fail_fast(http_request)) {
+        return;
+    }
+    auto session = std::make_shared<HttpSession>(*this, http_request);
+    switch (_scheduler.submit(make_origin(http_request), boost::bind(&HttpSession::start, session))) {
+        case OriginScheduler::ADMITTED:
+            session->start();
+            break;
+        case OriginScheduler::QUEUED:
+            break;
+        case OriginScheduler::REJECTED:
+        default:
+            std::cerr << http_request->get_field("host") << http_request->get_path() << " -> too many waiting requests" << std::endl;
+            auto http_response = std::make_shared<HttpResponse>();
+            http_response->getRawStream()->is_aborted(true);
+            _http_source->fromHttpSink(http_request, http_response);
+            break;
+    }
+}
+
+bool HttpClient::is_secure(const std::shared_ptr<HttpRequest> &http_request) {
+    // the scheme is lost with the absolute URI, a TLS terminating gateway tells it like a reverse proxy would
+    std::string proto = http_request->get_field("x-forwarded-proto");
+    std::transform(proto.begin(), proto.end(), proto.begin(), ::tolower);
+    std::string host = http_request->get_field("host");
+    auto delimiter = host.find(':');
+    return proto == "https" || (delimiter != std::string::npos && host.substr(delimiter + 1) == "443");
+}
+
+std::string HttpClient::make_origin(const std::shared_ptr<HttpRequest> &http_request) {
+    std::string host = http_request->get_field("host");
+    // TLS and plaintext connections to the same host must never be mixed up in the pool
+    if (is_secure(http_request)) {
+        return "https://" + (host.find(':') != std::string::npos ? host : host + ":443");
+    }
+    return host.find(':') != std::string::npos ? host : host + ":80";
+}
+
+std::shared_ptr<HttpResponse> HttpClient::make_bad_gateway(const std::string &reason, const std::chrono::seconds &ttl) {
+    auto http_response = std::make_shared<HttpResponse>();
+    http_response->set_version("HTTP/1.1");
+    http_response->set_status_code("502");
+    http_response->set_reason("Bad Gateway");
+    http_response->set_field("content-type", "text/plain");
+    http_response->set_field("content-length", std::to_string(reason.size()));
+    // NDN caches may answer for the origin as long as it is known as failing
+    http_response->set_field("cache-control", "max-age=" + std::to_string(ttl.count()));
+    http_response->set_field("retry-after", std::to_string(ttl.count()));
+    http_response->getRawStream()->append_raw_data(reason);
+    http_response->is_parsed(true);
+    http_response->getRawStream()->is_completed(true);
+    return http_response;
+}
+
+bool HttpClient::fail_fast(const std::shared_ptr<HttpRequest> &http_request) {
+    std::string reason;
+    auto remaining = _negative_cache.find(make_origin(http_request), reason);
+    if (remaining.count() > 0) {
+        _http_source->fromHttpSink(http_request, make_bad_gateway(reason, remaining));
+        return true;
+    }
+    return false;
+}
+
+void HttpClient::assemble_ranges(const std::shared_ptr<RangedDownload> &download, const std::shared_ptr<boost::asio::deadline_timer> &timer) {
+    bool aborted = download->output->is_aborted();
+    if (!aborted && download->first_done) {
+        // regions are appended in order, each one as soon as the previous ones are complete
+        char buffer[global::DEFAULT_BUFFER_SIZE];
+        long read_bytes = 0;
+        while (download->current < download->parts.size()) {
+            auto &part = download->parts[download->current];
+            while ((read_bytes = part->readSomeRawData(0, buffer, global::DEFAULT_BUFFER_SIZE)) > 0) {
+                part->removeFirstBytes(read_bytes);
+                download->output->append_raw_data(buffer, read_bytes);
+            }
+            if (read_bytes < 0) {
+                break;
+            } else if (part->is_aborted()) {
+                std::cerr << "ranged download aborted" << std::endl;
+                download->output->is_aborted(true);
+                aborted = true;
+                break;
+            }
+            ++download->current;
+        }
+        if (!aborted && download->current == download->parts.size()) {
+            download->output->is_completed(true);
+            return;
+        }
+    }
+
+    if (aborted) {
+        // stops the downloads of the other parts
+        for (const auto &part : download->parts) {
+            part->is_aborted(true);
+        }
+    } else {
+        timer->expires_from_now(global::DEFAULT_WAIT_REDO);
+        timer->async_wait(boost::bind(&HttpClient::assemble_ranges, this, download, timer));
+    }
+}
+
+size_t HttpClient::getOriginLoad() {
+    return _scheduler.getLoad();
+}
+
+void HttpClient::setDnsResolver(std::unique_ptr<DnsResolver> resolver) {
+    _dns_cache.setResolver(std::move(resolver));
+}
+
+void HttpClient::setTlsVerifyFile(const std::string &verify_file) {
+    _tls_context.load_verify_file(verify_file);
+}
+
+void HttpClient::purge_caches() {
+    _pool.purge();
+    _tls_sessions.purge();
+    _dns_cache.purge();
+    _negative_cache.purge();
+#ifndef NDEBUG
+    std::cout << _scheduler.getDequeuedCount() << " queued request(s), " << _scheduler.getAverageQueueTime() << " ms on average, "
+              << _scheduler.getMaxQueueTime() << " ms at most, " << _scheduler.getRejectedCount() << " rejected" << std::endl;
+#endif
+    _purge_timer.expires_from_now(global::DEFAULT_POOL_IDLE_TIMEOUT);
+    _purge_timer.async_wait(boost::bind(&HttpClient::purge_caches, this));
+}
@@ -14,17 +14,35 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #pragma once
 
+#include <boost/asio/ssl.hpp>
+
 #include <memory>
 #include <atomic>
+#include <vector>
 
 #include "global.h"
 #include "module.h"
 #include "http_sink.h"
 #include "http_request.h"
 #include "http_response.h"
+#include "origin_stream.h"
+#include "connection_pool.h"
+#include "dns_cache.h"
+#include "origin_scheduler.h"
+#include "revalidation_cache.h"
+#include "negative_cache.h"
+#include "tls_session_cache.h"
 
 class HttpClient : public Module, public HttpSink {
 private:
+    // large body downloaded as several ranges, the first one by the session of the request
+    struct RangedDownload {
+        std::shared_ptr<SeekableRawStream> output;
+        std::vector<std::shared_ptr<SeekableRawStream>> parts;
+        size_t current = 0;
+        std::atomic<bool> first_done {false};
+    };
+
     class HttpSession : public std::enable_shared_from_this<HttpSession> {
     private:
 #ifndef NDEBUG
@@ -35,7 +53,7 @@ private:
 
         boost::asio::deadline_timer _timer;
         boost::asio::strand _strand;
-        boost::asio::ip::tcp::socket _socket;
+        OriginStream _stream;
         std::shared_ptr<HttpRequest> _http_request;
         char _write_buffer[global::DEFAULT_BUFFER_SIZE];
         std::shared_ptr<HttpResponse> _http_response;
@@ -43,20 +61,46 @@ private:
 
         boost::chrono::steady_clock::time_point _time_point;
 
+        bool _secure;
+        std::string _origin;
+        bool _holds_slot = false;
+        std::vector<boost::asio::ip::tcp::endpoint> _endpoints;
+        bool _reused = false;
+
+        // cached response the conditional request was made for
+        bool _revalidating = false;
+        RevalidationCache::Entry _revalidated_entry;
+        // response being recorded for a later revalidation
+        std::shared_ptr<RevalidationCache::Entry> _recorded_entry;
+
+        // a part only downloads a range for another session, it is never given to the interpreter
+        bool _is_part;
+        std::shared_ptr<RangedDownload> _ranged_download;
+
     public:
-        HttpSession(HttpClient &http_client, const std::shared_ptr<HttpRequest> &http_request);
+        HttpSession(HttpClient &http_client, const std::shared_ptr<HttpRequest> &http_request,
+                    const std::shared_ptr<HttpResponse> &part_response = std::shared_ptr<HttpResponse>());
 
         ~HttpSession();
 
         void start();
 
+        // true if the request failed on a pooled connection and may be sent again on a new one, sent tells if any of it was written
+        bool is_retryable(bool sent);
+
+        void retry_with_new_connection();
+
         void resolve_domain();
 
-        void resolve_domain_handler(const boost::system::error_code &err, boost::asio::ip::tcp::resolver::iterator iterator);
+        void resolve_domain_handler(const boost::system::error_code &err, const std::vector<boost::asio::ip::tcp::endpoint> &endpoints);
+
+        void connect(size_t index);
 
-        void connect(boost::asio::ip::tcp::resolver::iterator iterator);
+        void connect_handler(const boost::system::error_code &err, size_t index);
 
-        void connect_handler(const boost::system::error_code &err, boost::asio::ip::tcp::resolver::iterator iterator);
+        void handshake();
+
+        void handshake_handler(const boost::system::error_code &err);
 
         void write_request_header();
 
@@ -78,17 +122,62 @@ private:
 
         void read_response_body_chunk_handler(const boost::system::error_code &err, size_t bytes_transferred, long chunk_size);
 
+        // reads the trailer section after the last chunk, up to the empty line ending the response
+        void read_response_trailer();
+
+        void read_response_trailer_handler(const boost::system::error_code &err, size_t bytes_transferred);
+
         void read_response_body_old();
 
         void read_response_body_old_handler(const boost::system::error_code &err, size_t bytes_transferred);
 
+        std::string make_revalidation_key();
+
+        void add_validators();
+
+        void replay_revalidated_response();
+
+        void record_response();
+
+        // the revalidation cache is shared by every user, requests with credentials never use it
+        bool has_credentials();
+
+        // neither private nor setting cookies, so the response may be replayed to another user
+        static bool is_shareable(const std::map<std::string, std::string> &fields);
+
+        void append_body(const std::string &data);
+
+        void fail(const std::string &reason, const std::chrono::seconds &ttl);
+
+        void deliver(const std::shared_ptr<HttpResponse> &http_response);
+
+        size_t split_response(size_t content_length, size_t additional_bytes);
+
+        void read_part_body(size_t additional_bytes);
+
+        void complete_response(bool reusable_connection);
+
         void timer_handler(const boost::system::error_code &err);
+
+        boost::posix_time::time_duration bounded_timeout(const boost::posix_time::time_duration &timeout);
     };
 
-    boost::asio::ip::tcp::resolver _resolver;
+    DnsCache _dns_cache;
+
+    OriginScheduler _scheduler;
+    ConnectionPool _pool;
+    RevalidationCache _revalidation_cache;
+    NegativeCache _negative_cache;
+    boost::asio::ssl::context _tls_context;
+    TlsSessionCache _tls_sessions;
+    std::chrono::seconds _resolve_failure_ttl;
+    std::chrono::seconds _connect_failure_ttl;
+    boost::asio::deadline_timer _purge_timer;
 
 public:
-    explicit HttpClient(size_t concurrency = 1);
+    explicit HttpClient(size_t concurrency = 1,
+                        const std::chrono::seconds &resolve_failure_ttl = global::DEFAULT_FAILURE_TTL_RESOLVE,
+                        const std::chrono::seconds &connect_failure_ttl = global::DEFAULT_FAILURE_TTL_CONNECT);
 
     ~HttpClient() override = default;
 
@@ -97,4 +186,26 @@ public:
     void fromHttpSource(const std::shared_ptr<HttpRequest> &http_request) override;
 
     void fromHttpSourceHandler(const std::shared_ptr<HttpRequest> &http_request);
+
+    // origin sessions running or waiting for a slot
+    size_t getOriginLoad();
+
+    // must be called before start(), mainly to use a stub resolver
+    void setDnsResolver(std::unique_ptr<DnsResolver> resolver);
+
+    // must be called before start(), trusts the certificates of the file besides the ones of the system
+    void setTlsVerifyFile(const std::string &verify_file);
+
+private:
+    static bool is_secure(const std::shared_ptr<HttpRequest> &http_request);
+
+    static std::string make_origin(const std::shared_ptr<HttpRequest> &http_request);
+
+    static std::shared_ptr<HttpResponse> make_bad_gateway(const std::string &reason, const std::chrono::seconds &ttl);
+
+    bool fail_fast(const std::shared_ptr<HttpRequest> &http_request);
+
+    void assemble_ranges(const std::shared_ptr<RangedDownload> &download, const std::shared_ptr<boost::asio::deadline_timer> &timer);
+
+    void purge_caches();
 };
\ No newline at end of file
@@ -29,26 +29,64 @@ static void signal_handler(int signum) {
 
 int main(int argc, char *argv[]) {
     ndn::Name prefix("/http");
-
+    bool compression = true;
+    std::chrono::seconds resolve_failure_ttl = global::DEFAULT_FAILURE_TTL_RESOLVE;
+    std::chrono::seconds connect_failure_ttl = global::DEFAULT_FAILURE_TTL_CONNECT;
+    std::string tls_verify_file;
+    bool chunking = false;
+    bool body_naming = false;
+    bool fec = false;
+    ndn::Name instance_prefix;
+
+    // no letter means something else for the igw, a script starting both can't give one the options of the other
     for(int i = 1; i < argc; ++i){
         switch (argv[i][1]){
             case 'n':
                 prefix = argv[++i];
                 break;
+            case 'u':
+                compression = false;
+                break;
+            case 'l':
+                resolve_failure_ttl = std::chrono::seconds(std::stoi(argv[++i]));
+                break;
+            case 'f':
+                connect_failure_ttl = std::chrono::seconds(std::stoi(argv[++i]));
+                break;
+            case 'a':
+                tls_verify_file = argv[++i];
+                break;
+            case 'd':
+                chunking = true;
+                break;
+            case 'g':
+                body_naming = true;
+                break;
+            case 'x':
+                fec = true;
+                break;
+            case 'i':
+                instance_prefix = argv[++i];
+                break;
             case 'h':
             default:
-                std::cout << argv[0] << " [-n NDN_NAME]" << std::endl;
+                std::cout << argv[0] << " [-n NDN_NAME] [-u] [-l RESOLVE_FAILURE_TTL] [-f CONNECT_FAILURE_TTL] [-a CA_FILE] [-d] [-g] [-x] [-i INSTANCE_NAME]" << std::endl;
                 return -1;
         }
     }
 
     std::cout << "HTTP/NDN egress gateway v1.1-2" << std::endl;
 
-    NdnResolver ndn_resolver(4);
+    NdnResolver ndn_resolver(4, chunking, body_naming, fec);
     NdnConsumerSubModule ndn_receiver(ndn_resolver);
-    NdnProducerSubModule ndn_sender(ndn_resolver, prefix);
-    NdnHttpInterpreter interpreter(2);
-    HttpClient http_client(4);
+    NdnProducerSubModule ndn_sender(ndn_resolver, prefix, instance_prefix);
+    NdnHttpInterpreter interpreter(2, compression);
+    HttpClient http_client(4, resolve_failure_ttl, connect_failure_ttl);
+    if (!tls_verify_file.empty()) {
+        http_client.setTlsVerifyFile(tls_verify_file);
+    }
+
+    ndn_resolver.setOriginLoad(boost::bind(&HttpClient::getOriginLoad, &http_client));
 
     ndn_resolver.attachNdnSink(&interpreter);
     interpreter.attachNdnSource(&ndn_resolver);
@@ -61,7 +99,11 @@ int main(int argc, char *argv[]) {
     interpreter.start();
     http_client.start();
 
-    std::cout << "registered as " << prefix << std::endl;
+    std::cout << "registered as " << prefix;
+    if (!instance_prefix.empty()) {
+        std::cout << " and " << instance_prefix;
+    }
+    std::cout << std::endl;
     signal(SIGINT, signal_handler);
 
     do {
@@ -14,6 +14,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "ndn_content.h"
 
+#include "global.h"
+
 NdnContent::NdnContent(const std::shared_ptr<SeekableRawStream> &raw_stream) : Message(raw_stream), _last_access(std::chrono::steady_clock::now()){
 
 }
@@ -34,6 +36,14 @@ void NdnContent::setFreshness(const ndn::time::milliseconds& freshness) {
     _freshness = freshness;
 }
 
+const ndn::time::milliseconds& NdnContent::getStaleWindow() const {
+    return _stale_window;
+}
+
+void NdnContent::setStaleWindow(const ndn::time::milliseconds &stale_window) {
+    _stale_window = stale_window;
+}
+
 const ndn::time::system_clock::time_point& NdnContent::getTimestamp() const {
     return _timestamp;
 }
@@ -42,6 +52,14 @@ void NdnContent::setTimestamp(const ndn::time::system_clock::time_point& timesta
     _timestamp = timestamp;
 }
 
+const std::chrono::steady_clock::time_point& NdnContent::getCreation() const {
+    return _creation;
+}
+
+bool NdnContent::isStale() const {
+    return _creation + std::chrono::milliseconds(_freshness.count()) <= std::chrono::steady_clock::now();
+}
+
 const std::chrono::steady_clock::time_point& NdnContent::getLastAccess() const {
     return _last_access;
 }
@@ -50,6 +68,44 @@ void NdnContent::refresh() {
     _last_access = std::chrono::steady_clock::now();
 }
 
+uint64_t NdnContent::getOffset(uint64_t segment) const {
+    auto it = _offsets.upper_bound(segment);
+    if (it == _offsets.begin()) {
+        return segment * global::DEFAULT_BUFFER_SIZE;
+    }
+    --it;
+    return it->second + (segment - it->first) * global::DEFAULT_BUFFER_SIZE;
+}
+
+void NdnContent::setOffset(uint64_t segment, uint64_t offset) {
+    _offsets[segment] = offset;
+}
+
+bool NdnContent::isFlushDue(uint64_t offset, const std::chrono::milliseconds &delay) {
+    auto time_point = std::chrono::steady_clock::now();
+    if (_flush_offset != offset) {
+        _flush_offset = offset;
+        _flush_since = time_point;
+    }
+    return _flush_since + delay <= time_point;
+}
+
+bool NdnContent::isChunkList() const {
+    return _chunk_list;
+}
+
+void NdnContent::setChunkList(bool chunk_list) {
+    _chunk_list = chunk_list;
+}
+
+const std::string& NdnContent::getBodyDigest() const {
+    return _body_digest;
+}
+
+void NdnContent::setBodyDigest(const std::string &body_digest) {
+    _body_digest = body_digest;
+}
+
 bool NdnContent::addData(uint64_t segment, std::shared_ptr<ndn::Data> data) {
     refresh();
     return _datas.emplace(segment, data).second;
@@ -66,4 +122,13 @@ std::map<uint64_t, std::shared_ptr<ndn::Data>>::iterator NdnContent::end() {
 
 size_t NdnContent::SegmentCount() {
     return _datas.size();
+}
+
+void NdnContent::addRepair(uint64_t index, const std::shared_ptr<ndn::Data> &data) {
+    _repairs.emplace(index, data);
+}
+
+std::shared_ptr<ndn::Data> NdnContent::findRepair(uint64_t index) {
+    auto it = _repairs.find(index);
+    return it != _repairs.end() ? it->second : nullptr;
 }
\ No newline at end of file
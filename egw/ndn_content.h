@@ -17,6 +17,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <ndn-cxx/data.hpp>
 
 #include <memory>
+#include <limits>
 
 #include "message.h"
 #include "seekable_raw_stream.h"
@@ -25,10 +26,24 @@ class NdnContent : public Message {
 private:
     ndn::Name _name;
     ndn::time::milliseconds _freshness{0};
+    // time after the freshness during which the content may still be served while it is refreshed
+    ndn::time::milliseconds _stale_window{0};
     ndn::time::system_clock::time_point _timestamp;
 
+    std::chrono::steady_clock::time_point _creation {std::chrono::steady_clock::now()};
     std::chrono::steady_clock::time_point _last_access;
     std::map<uint64_t, std::shared_ptr<ndn::Data>> _datas;
+    // repair segments of the blocks of DEFAULT_FEC_BLOCK_SIZE segments, by block * DEFAULT_FEC_REPAIR_COUNT + repair
+    std::map<uint64_t, std::shared_ptr<ndn::Data>> _repairs;
+    // raw offset of the first byte of each segment, a segment is shorter than DEFAULT_BUFFER_SIZE when it is flushed early
+    std::map<uint64_t, uint64_t> _offsets;
+    // bytes waiting for a segment to be filled, since when they wait
+    uint64_t _flush_offset {std::numeric_limits<uint64_t>::max()};
+    std::chrono::steady_clock::time_point _flush_since;
+    // the content is the list of the chunks of a response, published under their digest
+    bool _chunk_list {false};
+    // digest of the body published apart, the content then only holds the header
+    std::string _body_digest;
 
 public:
     NdnContent() = default;
@@ -45,14 +60,39 @@ public:
 
     void setFreshness(const ndn::time::milliseconds &freshness);
 
+    const ndn::time::milliseconds& getStaleWindow() const;
+
+    void setStaleWindow(const ndn::time::milliseconds &stale_window);
+
     const ndn::time::system_clock::time_point& getTimestamp() const;
 
     void setTimestamp(const ndn::time::system_clock::time_point &freshness);
 
+    const std::chrono::steady_clock::time_point& getCreation() const;
+
+    // true once the freshness period elapsed since the creation
+    bool isStale() const;
+
     const std::chrono::steady_clock::time_point& getLastAccess() const;
 
     void refresh();
 
+    // segments after the last known offset are assumed to be full
+    uint64_t getOffset(uint64_t segment) const;
+
+    void setOffset(uint64_t segment, uint64_t offset);
+
+    // true once the bytes from offset have waited for delay without filling a segment
+    bool isFlushDue(uint64_t offset, const std::chrono::milliseconds &delay);
+
+    bool isChunkList() const;
+
+    void setChunkList(bool chunk_list);
+
+    const std::string& getBodyDigest() const;
+
+    void setBodyDigest(const std::string &body_digest);
+
     bool addData(uint64_t segment, std::shared_ptr<ndn::Data> data);
 
     std::map<uint64_t, std::shared_ptr<ndn::Data>>::iterator findData(uint64_t segment);
@@ -60,4 +100,8 @@ public:
     std::map<uint64_t, std::shared_ptr<ndn::Data>>::iterator end();
 
     size_t SegmentCount();
+
+    void addRepair(uint64_t index, const std::shared_ptr<ndn::Data> &data);
+
+    std::shared_ptr<ndn::Data> findRepair(uint64_t index);
 };
\ No newline at end of file
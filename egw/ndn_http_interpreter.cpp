@@ -16,6 +16,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <regex>
 #include <algorithm>
+#include <set>
 
 const char SAFE[256] = {
 /*      0 1 2 3  4 5 6 7  8 9 A B  C D E F */
@@ -40,6 +41,24 @@ const char SAFE[256] = {
 /* F */ 0,0,0,0, 0,0,0,0, 0,0,0,0, 0,0,0,0
 };
 
+bool parse_http_date(const std::string &value, ndn::time::system_clock::time_point &time_point) {
+    if (value.empty()) {
+        return false;
+    }
+    try {
+        time_point = ndn::time::fromString(value, "%a, %d %b %Y %H:%M:%S %Z");
+        return true;
+    } catch (const std::exception &e) {
+        return false;
+    }
+}
+
+// status codes cacheable by default, RFC 7231 section 6.1
+bool is_heuristically_cacheable(const std::string &status_code) {
+    static const std::set<std::string> status_codes {"200", "203", "204", "206", "300", "301", "404", "405", "410", "414", "501"};
+    return status_codes.find(status_code) != status_codes.end();
+}
+
 std::string uri_encode(const std::string & sSrc){
     const char DEC2HEX[16 + 1] = "0123456789ABCDEF";
     const unsigned char * pSrc = (const unsigned char *)sSrc.c_str();
@@ -61,7 +80,7 @@ std::string uri_encode(const std::string & sSrc){
     return sResult;
 }
 
-NdnHttpInterpreter::NdnHttpInterpreter(size_t concurrency) : Module(concurrency) {
+NdnHttpInterpreter::NdnHttpInterpreter(size_t concurrency, bool compression) : Module(concurrency), _compression(compression) {
 
 }
 
@@ -79,6 +98,7 @@ void NdnHttpInterpreter::fromHttpSink(const std::shared_ptr<HttpRequest> &http_r
 
 void NdnHttpInterpreter::fromNdnSourceHandler(const std::shared_ptr<NdnContent> &ndn_content) {
     auto http_request = std::make_shared<HttpRequest>(ndn_content->getRawStream());
+    http_request->setDeadline(ndn_content->getDeadline());
     { // block for RAII
         std::lock_guard<std::mutex> lock(_map_mutex);
         _pending_requests.emplace(http_request, ndn_content->getName().get(-1).toUri());
@@ -175,8 +195,9 @@ void NdnHttpInterpreter::get_http_request_header(const std::shared_ptr<HttpReque
 
 void NdnHttpInterpreter::fromHttpSinkHandler(const std::shared_ptr<HttpRequest> &http_request, const std::shared_ptr<HttpResponse> &http_response) {
     if (!http_response->getRawStream()->is_aborted()) {
-        // prepare NDN server message
-        auto ndn_message = std::make_shared<NdnContent>(http_response->getRawStream());
+        // prepare NDN server message, the HTTP client keeps on filling the original stream of the response
+        bool compress = _compression && should_compress(http_request, http_response);
+        auto ndn_message = std::make_shared<NdnContent>(compress ? compress_http_response(http_response) : http_response->getRawStream());
 
         ndn::Name name("http");
         //tokenize domain
@@ -217,7 +238,9 @@ void NdnHttpInterpreter::fromHttpSinkHandler(const std::shared_ptr<HttpRequest>
         }
 
         ndn_message->setName(name);
-        http_response->add_header_to_raw_stream();
+        if (!compress) {
+            http_response->add_header_to_raw_stream();
+        }
 
         setNdnMessageCachability(ndn_message, http_response);
         //std::cout << ndn_message->get_name() << std::endl;
@@ -230,37 +253,164 @@ void NdnHttpInterpreter::fromHttpSinkHandler(const std::shared_ptr<HttpRequest>
     }
 }
 
+bool NdnHttpInterpreter::should_compress(const std::shared_ptr<HttpRequest> &http_request, const std::shared_ptr<HttpResponse> &http_response) {
+    std::string status_code = http_response->get_status_code();
+    std::string content_length = http_response->get_field("content-length");
+    // chunked bodies are kept as they are, the HTTP client does not remove the framing
+    return http_request->get_method() != "HEAD" && status_code != "204" && status_code != "304" && status_code[0] != '1' &&
+           http_response->get_field("content-encoding").empty() && http_response->get_field("transfer-encoding").empty() &&
+           http_response->get_field("cache-control").find("no-transform") == std::string::npos &&
+           is_compressible(http_response->get_field("content-type")) &&
+           (content_length.empty() || std::strtoul(content_length.c_str(), nullptr, 10) >= global::DEFAULT_COMPRESSION_MIN_SIZE);
+}
+
+std::shared_ptr<SeekableRawStream> NdnHttpInterpreter::compress_http_response(const std::shared_ptr<HttpResponse> &http_response) {
+    // the response is still read by the HTTP client, so the compressed one is a copy
+    HttpResponse compressed_response;
+    compressed_response.set_version("HTTP/1.1");
+    compressed_response.set_status_code(http_response->get_status_code());
+    compressed_response.set_reason(http_response->get_reason());
+    for (const auto &field : http_response->get_fields()) {
+        compressed_response.set_field(field.first, field.second);
+    }
+    compressed_response.unset_field("content-length");
+    compressed_response.set_field("content-encoding", "gzip");
+    compressed_response.set_field("transfer-encoding", "chunked");
+    std::string vary = http_response->get_field("vary");
+    compressed_response.set_field("vary", vary.empty() ? "accept-encoding" : vary + ", accept-encoding");
+    std::string etag = http_response->get_field("etag");
+    if (!etag.empty() && etag.compare(0, 2, "W/") != 0) {
+        // a strong validator belongs to the bytes of the origin, the compressed ones are only equivalent
+        compressed_response.set_field("etag", "W/" + etag);
+    }
+
+    auto output = std::make_shared<SeekableRawStream>();
+    output->append_raw_data(compressed_response.make_header());
+    compress_body(http_response->getRawStream(), output, std::make_shared<Compression>(http_response->get_field("content-length").empty()),
+                  std::make_shared<boost::asio::deadline_timer>(_ios));
+    return output;
+}
+
+void NdnHttpInterpreter::compress_body(const std::shared_ptr<SeekableRawStream> &input, const std::shared_ptr<SeekableRawStream> &output,
+                                       const std::shared_ptr<Compression> &compression, const std::shared_ptr<boost::asio::deadline_timer> &timer) {
+    if (output->is_aborted()) {
+        // nobody wants the content anymore, stop the download too
+        input->is_aborted(true);
+        return;
+    }
+
+    char buffer[global::DEFAULT_BUFFER_SIZE];
+    long read_bytes;
+    bool valid = true;
+    while (valid && (read_bytes = input->readSomeRawData(0, buffer, global::DEFAULT_BUFFER_SIZE)) > 0) {
+        // the uncompressed body is not needed anymore once compressed
+        input->removeFirstBytes(read_bytes);
+        valid = compression->encoder.encode(buffer, read_bytes, compression->pending);
+        compression->unflushed = true;
+        compression->last_input = std::chrono::steady_clock::now();
+    }
+
+    bool flush = false;
+    if (valid && read_bytes < 0 && compression->streaming && compression->unflushed &&
+            compression->last_input + std::chrono::milliseconds(global::DEFAULT_WAIT_FLUSH.total_milliseconds()) <= std::chrono::steady_clock::now()) {
+        // a stream waiting for its origin gets what was compressed so far, like a flushed segment
+        valid = compression->encoder.encode(nullptr, 0, compression->pending, Z_SYNC_FLUSH);
+        compression->unflushed = false;
+        flush = true;
+    } else if (valid && read_bytes == 0 && !input->is_aborted()) {
+        valid = compression->encoder.encode(nullptr, 0, compression->pending, Z_FINISH);
+        flush = true;
+    }
+    if (valid) {
+        size_t framed = 0;
+        while (compression->pending.size() - framed >= global::DEFAULT_BUFFER_SIZE ||
+               (flush && framed < compression->pending.size())) {
+            size_t size = std::min(compression->pending.size() - framed, (size_t) global::DEFAULT_BUFFER_SIZE);
+            output->append_raw_data(make_chunk(compression->pending.substr(framed, size)));
+            framed += size;
+        }
+        compression->pending.erase(0, framed);
+    }
+
+    if (!valid) {
+        std::cerr << "failed to compress HTTP body" << std::endl;
+        input->is_aborted(true);
+        output->is_aborted(true);
+    } else if (read_bytes < 0) {
+        timer->expires_from_now(global::DEFAULT_WAIT_REDO);
+        timer->async_wait(boost::bind(&NdnHttpInterpreter::compress_body, this, input, output, compression, timer));
+    } else if (input->is_aborted()) {
+        output->is_aborted(true);
+    } else {
+        output->append_raw_data("0\r\n\r\n");
+        output->is_completed(true);
+    }
+}
+
 void NdnHttpInterpreter::setNdnMessageCachability(const std::shared_ptr<NdnContent> &ndn_message, const std::shared_ptr<HttpResponse> &http_response) {
-    std::string cache_control = http_response->get_field("cache-control");
-    unsigned long delimiter;
+    CacheControl cache_control(http_response->get_field("cache-control"));
+    auto now = ndn::time::system_clock::now();
+    ndn::time::system_clock::time_point date;
+    if (!parse_http_date(http_response->get_field("date"), date) || date > now) {
+        date = now;
+    }
+    ndn::time::system_clock::time_point last_modified;
+    bool has_last_modified = parse_http_date(http_response->get_field("last-modified"), last_modified);
+
     // default freshness value
-    ndn::time::milliseconds freshness = ndn::time::milliseconds(0);
-    // follow the wish of the HTTP server
-    if (http_response->get_field("pragma") == "no-cache" || cache_control.find("no-store") != std::string::npos ||
-            cache_control.find("no-cache") != std::string::npos || cache_control.find("private") != std::string::npos) {
-        freshness = ndn::time::milliseconds(0);
-    } else if ((delimiter = cache_control.find("s-maxage")) != std::string::npos || (delimiter = cache_control.find("max-age")) != std::string::npos) {
-        try {
-            std::string sub = cache_control.substr(delimiter);
-            freshness = ndn::time::milliseconds(1000 * std::stol(sub.substr(sub.find('=') + 1)));
-        } catch (const std::exception &e) {}
+    ndn::time::milliseconds lifetime = ndn::time::milliseconds(0);
+    ndn::time::milliseconds stale_window = ndn::time::milliseconds(0);
+    long seconds;
+    // follow the wish of the HTTP server, the NDN network is a shared cache
+    if (cache_control.has("no-store") || cache_control.has("no-cache") || cache_control.has("private") ||
+            (http_response->get_field("cache-control").empty() && http_response->get_field("pragma").find("no-cache") != std::string::npos) ||
+            http_response->get_field("vary") == "*") {
+        lifetime = ndn::time::milliseconds(0);
+    } else if ((seconds = cache_control.getSeconds("s-maxage")) >= 0 || (seconds = cache_control.getSeconds("max-age")) >= 0) {
+        lifetime = ndn::time::milliseconds(1000 * seconds);
     } else if (!http_response->get_field("expires").empty()) {
-        try {
-            freshness = ndn::time::duration_cast<ndn::time::milliseconds>(
-                    ndn::time::fromString(http_response->get_field("expires"), "%a, %d %b %Y %H:%M:%S %Z") - ndn::time::system_clock::now());
-        } catch (const std::exception &e) {}
+        // an invalid date means already expired
+        ndn::time::system_clock::time_point expires;
+        if (parse_http_date(http_response->get_field("expires"), expires)) {
+            lifetime = ndn::time::duration_cast<ndn::time::milliseconds>(expires - date);
+        }
+    } else if (has_last_modified && last_modified < date && is_heuristically_cacheable(http_response->get_status_code())) {
+        // a resource unchanged for a long time is unlikely to change soon
+        lifetime = std::min(ndn::time::duration_cast<ndn::time::milliseconds>((date - last_modified) / global::DEFAULT_HEURISTIC_FRESHNESS_DIVISOR),
+                            ndn::time::milliseconds(global::DEFAULT_HEURISTIC_FRESHNESS_MAX.total_milliseconds()));
+    }
+
+    // time already spent in upstream caches
+    ndn::time::milliseconds age = ndn::time::duration_cast<ndn::time::milliseconds>(now - date);
+    std::string age_field = http_response->get_field("age");
+    if (!age_field.empty() && std::all_of(age_field.begin(), age_field.end(), ::isdigit)) {
+        age = std::max(age, ndn::time::milliseconds(1000 * std::strtol(age_field.c_str(), nullptr, 10)));
+    }
+    ndn::time::milliseconds freshness = lifetime - age;
+
+    // stale copies are forbidden as soon as the server asks for a revalidation
+    if (lifetime.count() > 0 && !cache_control.has("must-revalidate") && !cache_control.has("proxy-revalidate") && !cache_control.has("s-maxage")) {
+        if ((seconds = cache_control.getSeconds("stale-while-revalidate")) > 0) {
+            stale_window = ndn::time::milliseconds(1000 * seconds);
+        }
+        if ((seconds = cache_control.getSeconds("stale-if-error")) > 0) {
+            stale_window = std::max(stale_window, ndn::time::milliseconds(1000 * seconds));
+        }
+        // the content never changes under this name, a stale copy is as good as a fresh one
+        if (cache_control.has("immutable")) {
+            stale_window = std::max(stale_window, lifetime);
+        }
     }
 
     // it is possible to have a negative value
     if (freshness.count() < 0) {
+        // the part of the stale window already elapsed is lost too
+        stale_window = std::max(stale_window + freshness, ndn::time::milliseconds(0));
         freshness = ndn::time::milliseconds(0);
     }
     ndn_message->setFreshness(freshness);
+    ndn_message->setStaleWindow(stale_window);
 
     // use the version of the server if it specifies one
-    try {
-        ndn_message->setTimestamp(ndn::time::fromString(http_response->get_field("last-modified"), "%a, %d %b %Y %H:%M:%S %Z"));
-    } catch (const std::exception &e) {
-        ndn_message->setTimestamp(ndn::time::system_clock::now());
-    }
+    ndn_message->setTimestamp(has_last_modified ? last_modified : now);
 }
@@ -16,6 +16,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <ndn-cxx/name.hpp>
 
+#include <chrono>
 #include <memory>
 #include <mutex>
 #include <unordered_map>
@@ -27,14 +28,35 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "ndn_content.h"
 #include "http_request.h"
 #include "http_response.h"
+#include "cache_control.h"
+#include "body_codec.h"
 
 class NdnHttpInterpreter : public Module, public NdnSink, public HttpSource {
 private:
+    // compression of a body into chunks of DEFAULT_BUFFER_SIZE bytes, the same body always gives the same bytes,
+    // so the digests of chunks and bodies published by the NdnResolver are shared by every fetch of it
+    struct Compression {
+        GzipEncoder encoder;
+        // compressed bytes not framed in a chunk yet
+        std::string pending;
+        // bodies without content-length may stream, their input is flushed once it waited for DEFAULT_WAIT_FLUSH
+        bool streaming;
+        bool unflushed {false};
+        std::chrono::steady_clock::time_point last_input {std::chrono::steady_clock::now()};
+
+        explicit Compression(bool streaming)
+                : streaming(streaming) {
+
+        }
+    };
+
     std::mutex _map_mutex;
     std::unordered_map<std::shared_ptr<HttpRequest>, std::string> _pending_requests;
 
+    bool _compression;
+
 public:
-    explicit NdnHttpInterpreter(size_t concurrency = 1);
+    explicit NdnHttpInterpreter(size_t concurrency = 1, bool compression = true);
 
     ~NdnHttpInterpreter() override = default;
 
@@ -51,5 +73,12 @@ private:
 
     void fromHttpSinkHandler(const std::shared_ptr<HttpRequest> &http_request, const std::shared_ptr<HttpResponse> &http_response);
 
+    bool should_compress(const std::shared_ptr<HttpRequest> &http_request, const std::shared_ptr<HttpResponse> &http_response);
+
+    std::shared_ptr<SeekableRawStream> compress_http_response(const std::shared_ptr<HttpResponse> &http_response);
+
+    void compress_body(const std::shared_ptr<SeekableRawStream> &input, const std::shared_ptr<SeekableRawStream> &output,
+                       const std::shared_ptr<Compression> &compression, const std::shared_ptr<boost::asio::deadline_timer> &timer);
+
     void setNdnMessageCachability(const std::shared_ptr<NdnContent> &ndn_message, const std::shared_ptr<HttpResponse> &http_response);
 };
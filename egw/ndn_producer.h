@@ -15,10 +15,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #pragma once
 
 #include <ndn-cxx/data.hpp>
+#include <ndn-cxx/lp/nack.hpp>
 
 #include <memory>
 
 class NdnProducer {
 public:
     virtual void publish(const std::shared_ptr<ndn::Data> &content) = 0;
+
+    virtual void nack(const ndn::Interest &interest, ndn::lp::NackReason reason) = 0;
 };
\ No newline at end of file
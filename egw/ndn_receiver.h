@@ -31,10 +31,10 @@ public:
 
     void run() override;
 
-    void retrieve(const ndn::Name &name) override;
+    void retrieve(const ndn::Name &name, const std::chrono::steady_clock::time_point &deadline, bool must_be_fresh) override;
 
 private:
-    void retrieveHandler(const ndn::Name &name);
+    void retrieveHandler(const ndn::Name &name, const std::chrono::steady_clock::time_point &deadline, bool must_be_fresh);
 
     void onData(const ndn::Interest &interest, const ndn::Data &data, const std::shared_ptr<NdnContent> &content, size_t seg);
 
@@ -14,9 +14,23 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "ndn_resolver.h"
 
-NdnResolver::NdnResolver(size_t concurrency)
+#include <ndn-cxx/encoding/block-helpers.hpp>
+
+#include <algorithm>
+#include <sstream>
+
+#include "content_chunker.h"
+#include "fec_codec.h"
+#include "sha256.h"
+
+NdnResolver::NdnResolver(size_t concurrency, bool chunking, bool body_naming, bool fec)
         : Module(concurrency)
-        , _purge_timer(_ios) {
+        , _purge_timer(_ios)
+        , _busy_in_flight(global::DEFAULT_BUSY_IN_FLIGHT)
+        , _busy_origin_load(global::DEFAULT_BUSY_ORIGIN_LOAD)
+        , _chunking(chunking)
+        , _body_naming(body_naming)
+        , _fec(fec) {
 
 }
 
@@ -38,34 +52,70 @@ void NdnResolver::fromNdnSink(const std::shared_ptr<NdnContent> &content) {
     _ios.post(boost::bind(&NdnResolver::fromNdnSinkHandler, this, content));
 }
 
+size_t NdnResolver::getDedupeCount() const {
+    return _dedupe_count;
+}
+
+void NdnResolver::setOriginLoad(const std::function<size_t()> &origin_load, size_t busy_origin_load, size_t busy_in_flight) {
+    _origin_load = origin_load;
+    _busy_origin_load = busy_origin_load;
+    _busy_in_flight = busy_in_flight;
+}
+
 void NdnResolver::fromNdnProducerHandler(const ndn::Interest &interest) {
+    if (interest.getName().get(-1).toUri() == global::CANCEL_MARKER) {
+        cancelContent(interest);
+        return;
+    }
+    ndn::Name notification(interest.getName());
+    bool refresh = false;
+    if (notification.get(-1).toUri() == global::REFRESH_MARKER) {
+        // the ingress gateway was served a stale copy and wants a new one
+        refresh = true;
+        notification = notification.getPrefix(-1);
+    }
+    auto deadline = std::chrono::steady_clock::time_point::max();
+    if (notification.get(-1).isNumber()) {
+        // time budget of the ingress gateway, not present for segment Interests of contents
+        deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(notification.get(-1).toNumber());
+        notification = notification.getPrefix(-1);
+    }
     ndn::Name client_prefix;
     try {
-        client_prefix.wireDecode(interest.getName().get(-2).blockFromValue());
-        ndn::Name::Component hash(interest.getName().get(-1));
+        client_prefix.wireDecode(notification.get(-2).blockFromValue());
+        if (notification.size() == 4 && notification.get(1).toUri() == global::BATCH_MARKER) {
+            size_t in_flight;
+            { // block for RAII
+                std::lock_guard<std::mutex> lock(_map_mutex);
+                in_flight = _in_flight.size();
+            }
+            if (is_overloaded(in_flight)) {
+                // the whole batch goes to another egw
+                ++_busy_count;
+                _ndn_producer->nack(interest, ndn::lp::NackReason::CONGESTION);
+                return;
+            }
+            // the requests of the batch are retrieved together, then handled as if they were notified one by one
+            _ndn_consumer->retrieve(ndn::Name(client_prefix).append(global::BATCH_MARKER).append(notification.get(-1)), deadline);
+            replyState(interest, "OK");
+            return;
+        }
+        ndn::Name::Component hash(notification.get(-1));
 
-        ndn::Name content_name(interest.getName().getPrefix(-2));
+        ndn::Name content_name(notification.getPrefix(-2));
         content_name.append(hash);
 
-        std::string state;
-        { // block for RAII
-            std::lock_guard<std::mutex> lock(_map_mutex);
-            auto contents_it = _contents.find(content_name.toUri());
-            if(contents_it == _contents.end()) {
-                _ndn_consumer->retrieve(client_prefix.append(hash));
-                state = "OK";
-            } else {
-                contents_it->second->refresh();
-                state = "SKIP";
-            }
+        std::string state = admit_request(content_name, client_prefix, deadline, refresh, true);
+        if (state == "BUSY") {
+            // the ingress gateway backs off and notifies another egw, instead of waiting for a timeout
+            _ndn_producer->nack(interest, ndn::lp::NackReason::CONGESTION);
+            return;
+        }
+        if (state == "OK") {
+            _ndn_consumer->retrieve(ndn::Name(client_prefix).append(hash), deadline);
         }
 
-        auto data = std::make_shared<ndn::Data>(interest.getName());
-        data->setFreshnessPeriod(ndn::time::milliseconds(0));
-        data->setFinalBlockId(ndn::Name::Component::fromSegment(0));
-        data->setContent((uint8_t*)state.c_str(), state.size());
-        _keychain.sign(*data, ndn::security::SigningInfo(ndn::security::SigningInfo::SIGNER_TYPE_SHA256));
-        _ndn_producer->publish(data);
+        replyState(interest, state);
     } catch (const std::exception &e) {
         auto timer = std::make_shared<boost::asio::deadline_timer>(_ios);
         checkContent(interest, timer, 7);
@@ -73,29 +123,213 @@ void NdnResolver::fromNdnProducerHandler(const ndn::Interest &interest) {
 }
 
 void NdnResolver::fromNdnConsumerHandler(const std::shared_ptr<NdnContent> &content) {
+    if (content->getName().size() >= 2 && content->getName().get(-2).toUri() == global::BATCH_MARKER) {
+        split_batch(content, std::make_shared<boost::asio::deadline_timer>(_ios));
+        return;
+    }
     if (!content->getRawStream()->is_aborted()) {
         _ndn_sink->fromNdnSource(content);
     } else {
         std::cout << "can't get content with name " << content->getName() << std::endl;
+        // only the hash is common to the request and content names
+        std::string suffix = "/" + content->getName().get(-1).toUri();
+        std::lock_guard<std::mutex> lock(_map_mutex);
+        auto it = _in_flight.begin();
+        while (it != _in_flight.end()) {
+            if (it->first.size() >= suffix.size() && it->first.compare(it->first.size() - suffix.size(), suffix.size(), suffix) == 0) {
+                it = _in_flight.erase(it);
+            } else {
+                ++it;
+            }
+        }
     }
 }
 
 void NdnResolver::fromNdnSinkHandler(const std::shared_ptr<NdnContent> &content) {
+    { // block for RAII
+        std::lock_guard<std::mutex> lock(_requesters_mutex);
+        auto it = _requesters.find(content->getName().toUri());
+        if (it != _requesters.end() && it->second.empty()) {
+            // every ingress gateway gave up before the origin answered, stop reading the response
+            _requesters.erase(it);
+            content->getRawStream()->is_aborted(true);
+            return;
+        }
+    }
+    std::shared_ptr<NdnContent> published = content;
+    if (_chunking || _body_naming) {
+        published = std::make_shared<NdnContent>();
+        published->setName(content->getName());
+        published->setFreshness(content->getFreshness());
+        published->setStaleWindow(content->getStaleWindow());
+        published->setTimestamp(content->getTimestamp());
+        published->setChunkList(_chunking);
+    }
     { // block for RAII
         std::lock_guard<std::mutex> lock(_map_mutex);
-        _contents.emplace(content->getName().toUri(), content);
+        _contents.emplace(published->getName().toUri(), published);
+        _in_flight.erase(published->getName().toUri());
     }
     auto timer = std::make_shared<boost::asio::deadline_timer>(_ios);
-    generate_data(content, timer);
+    if (_chunking) {
+        generate_data(published, timer);
+        chunk_data(content, published, std::make_shared<boost::asio::deadline_timer>(_ios));
+    } else if (_body_naming) {
+        // segments are generated once it is known whether the body is published apart
+        name_body(content, published, timer);
+    } else {
+        generate_data(published, timer);
+    }
+}
+
+std::string NdnResolver::admit_request(const ndn::Name &content_name, const ndn::Name &client_prefix,
+                                       const std::chrono::steady_clock::time_point &deadline, bool refresh, bool may_refuse) {
+    std::string state;
+    { // block for RAII
+        std::lock_guard<std::mutex> lock(_map_mutex);
+        auto contents_it = _contents.find(content_name.toUri());
+        if (refresh && contents_it != _contents.end() && contents_it->second->getRawStream()->is_completed() && contents_it->second->isStale()) {
+            // the stale copy is still served under its version to the ingress gateways retrieving it
+            auto content = contents_it->second;
+            _replaced[ndn::Name(content->getName()).appendTimestamp(content->getTimestamp()).toUri()] = content;
+            _contents.erase(contents_it);
+            contents_it = _contents.end();
+        }
+        auto time_point = std::chrono::steady_clock::now();
+        auto in_flight_it = _in_flight.find(content_name.toUri());
+        if (contents_it != _contents.end()) {
+            contents_it->second->refresh();
+            state = "SKIP";
+        } else if (in_flight_it != _in_flight.end() && time_point < in_flight_it->second) {
+            // another ingress gateway, or a retransmission, already started the retrieval
+            ++_dedupe_count;
+            state = "SKIP";
+        } else if (may_refuse && is_overloaded(_in_flight.size())) {
+            // requests already served or being retrieved are still accepted, they cost nothing more
+            ++_busy_count;
+            return "BUSY";
+        } else {
+            _in_flight[content_name.toUri()] = std::min(deadline, time_point + global::DEFAULT_IN_FLIGHT_TIMEOUT);
+            state = "OK";
+        }
+    }
+    { // block for RAII
+        std::lock_guard<std::mutex> lock(_requesters_mutex);
+        _requesters[content_name.toUri()].insert(client_prefix.toUri());
+    }
+    return state;
+}
+
+bool NdnResolver::is_overloaded(size_t in_flight) {
+    return in_flight >= _busy_in_flight || (_origin_load && _origin_load() >= _busy_origin_load);
+}
+
+void NdnResolver::split_batch(const std::shared_ptr<NdnContent> &content, const std::shared_ptr<boost::asio::deadline_timer> &timer) {
+    if (content->getRawStream()->is_aborted()) {
+        std::cout << "can't get batch with name " << content->getName() << std::endl;
+        return;
+    }
+    if (!content->getRawStream()->is_completed()) {
+        timer->expires_from_now(global::DEFAULT_WAIT_REDO);
+        timer->async_wait(boost::bind(&NdnResolver::split_batch, this, content, timer));
+        return;
+    }
+
+    ndn::Name client_prefix(content->getName().getPrefix(-2));
+    std::string records = content->getRawStream()->raw_data_as_string();
+    size_t position = 0;
+    // every request is "<response name> <time budget> <size>\n<request>"
+    while (position < records.size()) {
+        size_t line_end = records.find('\n', position);
+        if (line_end == std::string::npos) {
+            break;
+        }
+        std::istringstream line(records.substr(position, line_end - position));
+        std::string uri;
+        long budget;
+        size_t size;
+        if (!(line >> uri >> budget >> size) || line_end + 1 + size > records.size()) {
+            break;
+        }
+        ndn::Name content_name(uri);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(budget);
+        if (admit_request(content_name, client_prefix, deadline) == "OK") {
+            auto request = std::make_shared<NdnContent>();
+            request->setName(ndn::Name(client_prefix).append(content_name.get(-1)));
+            request->setDeadline(deadline);
+            request->getRawStream()->append_raw_data(records.data() + line_end + 1, size);
+            request->getRawStream()->is_completed(true);
+            fromNdnConsumerHandler(request);
+        }
+        position = line_end + 1 + size;
+    }
+}
+
+void NdnResolver::cancelContent(const ndn::Interest &interest) {
+    ndn::Name client_prefix;
+    try {
+        client_prefix.wireDecode(interest.getName().get(-3).blockFromValue());
+    } catch (const std::exception &e) {
+        return;
+    }
+    ndn::Name content_name(interest.getName().getPrefix(-3));
+    content_name.append(interest.getName().get(-2));
+
+    bool last_requester = false;
+    { // block for RAII
+        std::lock_guard<std::mutex> lock(_requesters_mutex);
+        auto it = _requesters.find(content_name.toUri());
+        if (it != _requesters.end() && it->second.erase(client_prefix.toUri()) > 0) {
+            last_requester = it->second.empty();
+        }
+    }
+
+    if (last_requester) {
+        std::shared_ptr<NdnContent> content;
+        { // block for RAII
+            std::lock_guard<std::mutex> lock(_map_mutex);
+            // a later notification starts a new retrieval instead of waiting for the cancelled one
+            _in_flight.erase(content_name.toUri());
+            auto contents_it = _contents.find(content_name.toUri());
+            if (contents_it != _contents.end() && !contents_it->second->getRawStream()->is_completed()) {
+                content = contents_it->second;
+                _contents.erase(contents_it);
+            }
+        }
+        if (content) {
+            // closes the origin connection and stops the segment generation
+            content->getRawStream()->is_aborted(true);
+            std::lock_guard<std::mutex> lock(_requesters_mutex);
+            _requesters.erase(content_name.toUri());
+        }
+    }
+
+    replyState(interest, "OK");
+}
+
+void NdnResolver::replyState(const ndn::Interest &interest, const std::string &state) {
+    auto data = std::make_shared<ndn::Data>(interest.getName());
+    data->setFreshnessPeriod(ndn::time::milliseconds(0));
+    data->setFinalBlockId(ndn::Name::Component::fromSegment(0));
+    data->setContent((uint8_t*)state.c_str(), state.size());
+    _keychain.sign(*data, ndn::security::SigningInfo(ndn::security::SigningInfo::SIGNER_TYPE_SHA256));
+    _ndn_producer->publish(data);
 }
 
 void NdnResolver::checkContent(const ndn::Interest &interest, const std::shared_ptr<boost::asio::deadline_timer> &timer, size_t remaining_tries) {
     if (remaining_tries > 0) {
         uint64_t segment;
         std::string name;
-        if (interest.getName().get(-1).isSegment()) {
+        std::string version;
+        bool repair = interest.getName().size() >= 3 && interest.getName().get(-2).toUri() == global::REPAIR_MARKER;
+        if (repair) {
+            segment = interest.getName().get(-1).toNumber();
+            name = interest.getName().getPrefix(-3).toUri();
+            version = interest.getName().getPrefix(-2).toUri();
+        } else if (interest.getName().get(-1).isSegment()) {
             segment = interest.getName().get(-1).toSegment();
             name = interest.getName().getPrefix(-2).toUri();
+            version = interest.getName().getPrefix(-1).toUri();
         } else {
             segment = 0;
             name = interest.getName().toUri();
@@ -104,15 +338,28 @@ void NdnResolver::checkContent(const ndn::Interest &interest, const std::shared_
         std::shared_ptr<NdnContent> content;
         { // block for RAII
             std::lock_guard<std::mutex> lock(_map_mutex);
+            // segments of a replaced version are never mixed with those of the new one
+            auto replaced_it = _replaced.find(version);
             auto contents_it = _contents.find(name);
-            if(contents_it != _contents.end()) {
+            if (replaced_it != _replaced.end()) {
+                content = replaced_it->second;
+            } else if(contents_it != _contents.end() && (version.empty() ||
+                    ndn::Name(contents_it->second->getName()).appendTimestamp(contents_it->second->getTimestamp()).toUri() == version)) {
                 content = contents_it->second;
             }
         }
-        if (content) {
+        std::shared_ptr<ndn::Data> data;
+        if (content && repair) {
+            data = content->findRepair(segment);
+        } else if (content) {
             auto datas_it = content->findData(segment);
             if (datas_it != content->end()) {
-                _ndn_producer->publish(datas_it->second);
+                data = datas_it->second;
+            }
+        }
+        if (content) {
+            if (data) {
+                _ndn_producer->publish(data);
             } else {
                 timer->expires_from_now(boost::posix_time::milliseconds((8 - remaining_tries) * 25));
                 timer->async_wait(boost::bind(&NdnResolver::checkContent, this, interest, timer, remaining_tries - 1));
@@ -127,32 +374,258 @@ void NdnResolver::checkContent(const ndn::Interest &interest, const std::shared_
 }
 
 void NdnResolver::generate_data(const std::shared_ptr<NdnContent> &content, const std::shared_ptr<boost::asio::deadline_timer> &timer, uint64_t segment) {
+    // chunk lists, headers and bodies are fetched by other means than the blocks of segments
+    bool repaired = _fec && !content->isChunkList() && content->getBodyDigest().empty() &&
+                    !(content->getName().size() >= 2 && content->getName().get(1).toUri() == global::BODY_NAMESPACE);
     int generation_tokens = 16;
     char buffer[global::DEFAULT_BUFFER_SIZE];
-    long read_bytes;
-    while(generation_tokens > 0 && (read_bytes = content->getRawStream()->readRawData(segment * global::DEFAULT_BUFFER_SIZE, buffer, global::DEFAULT_BUFFER_SIZE)) > 0){
+    long read_bytes = 0;
+    uint64_t offset = content->getOffset(segment);
+    // the last segment may have been flushed before the end of the content, an empty segment then carries the FinalBlockId
+    auto final_published = [&content](uint64_t segment) {
+        auto datas_it = segment > 0 ? content->findData(segment - 1) : content->end();
+        return datas_it != content->end() && !datas_it->second->getFinalBlockId().empty();
+    };
+    while(generation_tokens > 0 && !content->getRawStream()->is_aborted() &&
+          ((read_bytes = content->getRawStream()->readSomeRawData(offset, buffer, global::DEFAULT_BUFFER_SIZE)) > 0 ||
+           (read_bytes == 0 && !final_published(segment)))){
+        // a segment is cut short only once its bytes waited for DEFAULT_WAIT_FLUSH, so trickling responses still get through
+        if (read_bytes < global::DEFAULT_BUFFER_SIZE && content->getRawStream()->remainingBytes(offset + read_bytes) != 0 &&
+                !content->isFlushDue(offset, std::chrono::milliseconds(global::DEFAULT_WAIT_FLUSH.total_milliseconds()))) {
+            read_bytes = -1;
+            break;
+        }
         auto data = std::make_shared<ndn::Data>(ndn::Name(content->getName()).appendTimestamp(content->getTimestamp()).appendSegment(segment));
         data->setContent((uint8_t*)buffer, read_bytes);
-        if(content->getRawStream()->remainingBytes(segment * global::DEFAULT_BUFFER_SIZE + read_bytes) == 0){
+        ndn::MetaInfo meta_info;
+        meta_info.addAppMetaInfo(ndn::makeNonNegativeIntegerBlock(global::TLV_SEGMENT_OFFSET, offset));
+        if (content->isChunkList()) {
+            meta_info.addAppMetaInfo(ndn::makeEmptyBlock(global::TLV_CHUNK_LIST));
+        }
+        if (!content->getBodyDigest().empty()) {
+            meta_info.addAppMetaInfo(ndn::makeStringBlock(global::TLV_BODY_DIGEST, content->getBodyDigest()));
+        }
+        if (repaired) {
+            meta_info.addAppMetaInfo(ndn::makeEmptyBlock(global::TLV_FEC));
+        }
+        data->setMetaInfo(meta_info);
+        bool final = content->getRawStream()->remainingBytes(offset + read_bytes) == 0;
+        if(final){
             data->setFinalBlockId(ndn::Name::Component::fromSegment(segment));
         }
         data->setFreshnessPeriod(content->getFreshness());
         _keychain.sign(*data, ndn::security::SigningInfo(ndn::security::SigningInfo::SIGNER_TYPE_SHA256));
 
         content->addData(segment, data);
+        if (repaired && (final || (segment + 1) % global::DEFAULT_FEC_BLOCK_SIZE == 0)) {
+            generate_repairs(content, segment / global::DEFAULT_FEC_BLOCK_SIZE, final);
+        }
 
-        ++segment;
+        offset += read_bytes;
+        content->setOffset(++segment, offset);
         --generation_tokens;
     }
 
-    if (read_bytes != 0) {
+    if(content->getRawStream()->is_aborted()) {
+        // remove uncompleted content
+        { // block for RAII
+            std::lock_guard<std::mutex> lock(_map_mutex);
+            _contents.erase(content->getName().toUri());
+        }
+        std::lock_guard<std::mutex> lock(_requesters_mutex);
+        _requesters.erase(content->getName().toUri());
+    } else if (read_bytes != 0) {
         timer->expires_from_now(global::DEFAULT_WAIT_REDO);
         timer->async_wait(boost::bind(&NdnResolver::generate_data, this, content, timer, segment));
-    } else if(content->getRawStream()->is_aborted()) {
-        // remove uncompleted content
+    } else {
+        // nothing left to cancel
+        std::lock_guard<std::mutex> lock(_requesters_mutex);
+        _requesters.erase(content->getName().toUri());
+    }
+}
+
+void NdnResolver::generate_repairs(const std::shared_ptr<NdnContent> &content, uint64_t block, bool final) {
+    uint64_t first = block * global::DEFAULT_FEC_BLOCK_SIZE;
+    std::vector<std::string> segments;
+    // the repairs tell the offset and size of every segment of the block, and whether it is the last block
+    std::string description = std::to_string(content->getOffset(first)) + " " + (final ? "1" : "0");
+    for (auto datas_it = content->findData(first); datas_it != content->end() && datas_it->first < first + global::DEFAULT_FEC_BLOCK_SIZE; ++datas_it) {
+        const ndn::Block &segment_content = datas_it->second->getContent();
+        segments.emplace_back((const char *) segment_content.value(), segment_content.value_size());
+        description += " " + std::to_string(segment_content.value_size());
+    }
+
+    std::vector<std::string> repairs = FecCodec::encode(segments, global::DEFAULT_FEC_REPAIR_COUNT);
+    for (size_t i = 0; i < repairs.size(); ++i) {
+        uint64_t index = block * global::DEFAULT_FEC_REPAIR_COUNT + i;
+        auto data = std::make_shared<ndn::Data>(ndn::Name(content->getName()).appendTimestamp(content->getTimestamp())
+                                                        .append(global::REPAIR_MARKER).appendNumber(index));
+        data->setContent((const uint8_t *) repairs[i].data(), repairs[i].size());
+        ndn::MetaInfo meta_info;
+        meta_info.addAppMetaInfo(ndn::makeStringBlock(global::TLV_FEC_REPAIR, description));
+        data->setMetaInfo(meta_info);
+        data->setFreshnessPeriod(content->getFreshness());
+        _keychain.sign(*data, ndn::security::SigningInfo(ndn::security::SigningInfo::SIGNER_TYPE_SHA256));
+        content->addRepair(index, data);
+    }
+}
+
+void NdnResolver::chunk_data(const std::shared_ptr<NdnContent> &content, const std::shared_ptr<NdnContent> &chunk_list,
+                             const std::shared_ptr<boost::asio::deadline_timer> &timer, uint64_t offset) {
+    if (chunk_list->getRawStream()->is_aborted()) {
+        // the retrieval was cancelled, closes the origin connection
+        content->getRawStream()->is_aborted(true);
+    }
+    int chunking_tokens = 16;
+    char buffer[ContentChunker::MAX_SIZE];
+    long read_bytes = 0;
+    while (chunking_tokens > 0 && !content->getRawStream()->is_aborted() &&
+           (read_bytes = content->getRawStream()->readSomeRawData(offset, buffer, ContentChunker::MAX_SIZE)) > 0) {
+        size_t size = ContentChunker::findBoundary(buffer, read_bytes);
+        // the end of the response and a trickle which waited for DEFAULT_WAIT_FLUSH are cut where they stop
+        if (size == 0 && (content->getRawStream()->remainingBytes(offset + read_bytes) == 0 ||
+                          content->isFlushDue(offset, std::chrono::milliseconds(global::DEFAULT_WAIT_FLUSH.total_milliseconds())))) {
+            size = read_bytes;
+        } else if (size == 0) {
+            read_bytes = -1;
+            break;
+        }
+        publish_chunk(content, chunk_list, buffer, size);
+        offset += size;
+        --chunking_tokens;
+    }
+
+    if (content->getRawStream()->is_aborted()) {
+        chunk_list->getRawStream()->is_aborted(true);
+    } else if (read_bytes != 0) {
+        timer->expires_from_now(global::DEFAULT_WAIT_REDO);
+        timer->async_wait(boost::bind(&NdnResolver::chunk_data, this, content, chunk_list, timer, offset));
+    } else {
+        chunk_list->getRawStream()->is_completed(true);
+    }
+}
+
+void NdnResolver::publish_chunk(const std::shared_ptr<NdnContent> &content, const std::shared_ptr<NdnContent> &chunk_list,
+                                const char *buffer, size_t size) {
+    std::string hex_digest = Sha256::hex(buffer, size);
+    ndn::Name name(content->getName().getPrefix(1));
+    name.append(global::CHUNK_NAMESPACE).append(hex_digest);
+
+    std::shared_ptr<NdnContent> chunk;
+    { // block for RAII
+        std::lock_guard<std::mutex> lock(_map_mutex);
+        auto it = _contents.find(name.toUri());
+        if (it != _contents.end()) {
+            chunk = it->second;
+        }
+    }
+    if (chunk) {
+        // a chunk is kept as long as the longest lived response using it
+        chunk->refresh();
+        chunk->setFreshness(std::max(chunk->getFreshness(), content->getFreshness()));
+        chunk->setStaleWindow(std::max(chunk->getStaleWindow(), content->getStaleWindow()));
+    } else {
+        chunk = std::make_shared<NdnContent>();
+        chunk->setName(name);
+        chunk->setFreshness(content->getFreshness());
+        chunk->setStaleWindow(content->getStaleWindow());
+        auto data = std::make_shared<ndn::Data>(name);
+        data->setContent((uint8_t*)buffer, size);
+        data->setFreshnessPeriod(content->getFreshness());
+        _keychain.sign(*data, ndn::security::SigningInfo(ndn::security::SigningInfo::SIGNER_TYPE_SHA256));
+        chunk->addData(0, data);
+        chunk->getRawStream()->is_completed(true);
         std::lock_guard<std::mutex> lock(_map_mutex);
-        _contents.erase(content->getName().toUri());
+        _contents.emplace(name.toUri(), chunk);
     }
+    chunk_list->getRawStream()->append_raw_data(hex_digest + " " + std::to_string(size) + "\n");
+}
+
+void NdnResolver::name_body(const std::shared_ptr<NdnContent> &content, const std::shared_ptr<NdnContent> &header,
+                            const std::shared_ptr<boost::asio::deadline_timer> &timer) {
+    if (header->getRawStream()->is_aborted()) {
+        // the retrieval was cancelled, closes the origin connection
+        content->getRawStream()->is_aborted(true);
+        return;
+    }
+    if (content->getRawStream()->is_aborted()) {
+        header->getRawStream()->is_aborted(true);
+        { // block for RAII
+            std::lock_guard<std::mutex> lock(_map_mutex);
+            _contents.erase(content->getName().toUri());
+        }
+        std::lock_guard<std::mutex> lock(_requesters_mutex);
+        _requesters.erase(content->getName().toUri());
+        return;
+    }
+
+    std::string raw_data;
+    char probe;
+    if (content->getRawStream()->readSomeRawData(global::DEFAULT_BODY_DIGEST_MAX_SIZE, &probe, 1) <= 0) {
+        if (content->getRawStream()->remainingBytes(0) < 0) {
+            if (std::chrono::steady_clock::now() < header->getCreation() + global::DEFAULT_BODY_DIGEST_WAIT) {
+                timer->expires_from_now(global::DEFAULT_WAIT_REDO);
+                timer->async_wait(boost::bind(&NdnResolver::name_body, this, content, header, timer));
+                return;
+            }
+        } else {
+            raw_data = content->getRawStream()->raw_data_as_string();
+        }
+    }
+    size_t header_length = raw_data.find("\r\n\r\n");
+    if (header_length == std::string::npos || header_length + 4 == raw_data.size()) {
+        // nothing worth sharing, or not known in time, the response is published as it is
+        { // block for RAII
+            std::lock_guard<std::mutex> lock(_map_mutex);
+            auto it = _contents.find(content->getName().toUri());
+            if (it == _contents.end() || it->second != header) {
+                // cancelled meanwhile
+                content->getRawStream()->is_aborted(true);
+                return;
+            }
+            it->second = content;
+        }
+        generate_data(content, timer);
+        return;
+    }
+    header_length += 4;
+
+    std::string hex_digest = Sha256::hex(raw_data.data() + header_length, raw_data.size() - header_length);
+    ndn::Name name(content->getName().getPrefix(1));
+    name.append(global::BODY_NAMESPACE).append(hex_digest);
+
+    std::shared_ptr<NdnContent> body;
+    { // block for RAII
+        std::lock_guard<std::mutex> lock(_map_mutex);
+        auto it = _contents.find(name.toUri());
+        if (it != _contents.end() && !it->second->getRawStream()->is_aborted()) {
+            body = it->second;
+        }
+    }
+    if (body) {
+        // a body is kept as long as the longest lived response using it
+        body->refresh();
+        body->setFreshness(std::max(body->getFreshness(), content->getFreshness()));
+        body->setStaleWindow(std::max(body->getStaleWindow(), content->getStaleWindow()));
+    } else {
+        body = std::make_shared<NdnContent>();
+        body->setName(name);
+        body->setFreshness(content->getFreshness());
+        body->setStaleWindow(content->getStaleWindow());
+        body->setTimestamp(content->getTimestamp());
+        body->getRawStream()->append_raw_data(raw_data.data() + header_length, raw_data.size() - header_length);
+        body->getRawStream()->is_completed(true);
+        { // block for RAII
+            std::lock_guard<std::mutex> lock(_map_mutex);
+            _contents[name.toUri()] = body;
+        }
+        generate_data(body, std::make_shared<boost::asio::deadline_timer>(_ios));
+    }
+
+    header->setBodyDigest(hex_digest);
+    header->getRawStream()->append_raw_data(raw_data.data(), header_length);
+    header->getRawStream()->is_completed(true);
+    generate_data(header, timer);
 }
 
 void NdnResolver::purge_old_data() {
@@ -161,19 +634,46 @@ void NdnResolver::purge_old_data() {
 #ifndef NDEBUG
     size_t remove_count = 0;
 #endif
-    auto it = _contents.begin();
-    while(it != _contents.end()) {
-        if(it->second->getLastAccess() + std::chrono::seconds(30) < time_point) {
-            it = _contents.erase(it);
+    for (auto *contents : {&_contents, &_replaced}) {
+        auto it = contents->begin();
+        while(it != contents->end()) {
+            // contents allowed to be served stale are kept until the end of their stale window
+            auto retention = std::max<std::chrono::milliseconds>(std::chrono::seconds(30), std::chrono::milliseconds(
+                    (it->second->getFreshness() + it->second->getStaleWindow()).count()));
+            if(it->second->getLastAccess() + retention < time_point) {
+                it = contents->erase(it);
 #ifndef NDEBUG
-            ++remove_count;
+                ++remove_count;
 #endif
+            } else {
+                ++it;
+            }
+        }
+    }
+    auto in_flight_it = _in_flight.begin();
+    while (in_flight_it != _in_flight.end()) {
+        if (in_flight_it->second <= time_point) {
+            in_flight_it = _in_flight.erase(in_flight_it);
         } else {
-            ++it;
+            ++in_flight_it;
+        }
+    }
+    { // block for RAII
+        // requesters of retrievals which never produced a content
+        std::lock_guard<std::mutex> requesters_lock(_requesters_mutex);
+        auto requesters_it = _requesters.begin();
+        while (requesters_it != _requesters.end()) {
+            if (_contents.find(requesters_it->first) == _contents.end() && _in_flight.find(requesters_it->first) == _in_flight.end()) {
+                requesters_it = _requesters.erase(requesters_it);
+            } else {
+                ++requesters_it;
+            }
         }
     }
 #ifndef NDEBUG
-    std::cout << remove_count << " content(s) removed from buffer (" << _contents.size() << " remaining contents)" << std::endl;
+    std::cout << remove_count << " content(s) removed from buffer (" << _contents.size() << " remaining contents, "
+              << _in_flight.size() << " in flight, " << _dedupe_count << " duplicate(s) skipped, "
+              << _busy_count << " refused while busy)" << std::endl;
 #endif
     _purge_timer.expires_from_now(global::DEFAULT_WAIT_PURGE);
     _purge_timer.async_wait(boost::bind(&NdnResolver::purge_old_data, this));
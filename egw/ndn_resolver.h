@@ -16,8 +16,11 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <ndn-cxx/name.hpp>
 
+#include <atomic>
+#include <functional>
 #include <mutex>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "global.h"
 #include "module.h"
@@ -35,9 +38,30 @@ private:
     boost::asio::deadline_timer _purge_timer;
     std::mutex _map_mutex;
     std::unordered_map<std::string, std::shared_ptr<NdnContent>> _contents;
+    // contents replaced by a refresh by versioned name, still served to the ingress gateways retrieving them until purged
+    std::unordered_map<std::string, std::shared_ptr<NdnContent>> _replaced;
+    // contents whose request is being retrieved or sent to the origin, with the time after which the retrieval is given up
+    std::unordered_map<std::string, std::chrono::steady_clock::time_point> _in_flight;
+    std::atomic<size_t> _dedupe_count {0};
+    // above these loads, notifications of new requests are refused with a congestion Nack
+    size_t _busy_in_flight;
+    size_t _busy_origin_load;
+    std::function<size_t()> _origin_load;
+    std::atomic<size_t> _busy_count {0};
+
+    // ingress gateways still waiting for a content, an empty set means the retrieval was cancelled
+    std::mutex _requesters_mutex;
+    std::unordered_map<std::string, std::unordered_set<std::string>> _requesters;
+
+    // responses are published as a list of content-defined chunks named by their digest, which other responses may share
+    bool _chunking;
+    // response bodies are published under their digest, which responses of other URLs may share
+    bool _body_naming;
+    // every block of segments is followed by repair segments, so consumers on lossy links don't wait for retransmissions
+    bool _fec;
 
 public:
-    explicit NdnResolver(size_t concurrency);
+    explicit NdnResolver(size_t concurrency, bool chunking = false, bool body_naming = false, bool fec = false);
 
     ~NdnResolver() override = default;
 
@@ -49,6 +73,12 @@ public:
 
     void fromNdnSink(const std::shared_ptr<NdnContent> &content) override;
 
+    size_t getDedupeCount() const;
+
+    // must be called before start(), gives the number of origin sessions running or queued
+    void setOriginLoad(const std::function<size_t()> &origin_load, size_t busy_origin_load = global::DEFAULT_BUSY_ORIGIN_LOAD,
+                       size_t busy_in_flight = global::DEFAULT_BUSY_IN_FLIGHT);
+
 private:
     void fromNdnProducerHandler(const ndn::Interest &interest);
 
@@ -56,9 +86,35 @@ private:
 
     void fromNdnSinkHandler(const std::shared_ptr<NdnContent> &content);
 
+    // "OK" if the request must be retrieved, "SKIP" if its content exists or is being retrieved,
+    // "BUSY" if it may be refused and the egw is overloaded, a stale content is only retrieved again on refresh
+    std::string admit_request(const ndn::Name &content_name, const ndn::Name &client_prefix, const std::chrono::steady_clock::time_point &deadline,
+                              bool refresh = false, bool may_refuse = false);
+
+    bool is_overloaded(size_t in_flight);
+
+    // hands over every request of a batch retrieved from an ingress gateway as if it was retrieved on its own
+    void split_batch(const std::shared_ptr<NdnContent> &content, const std::shared_ptr<boost::asio::deadline_timer> &timer);
+
+    void cancelContent(const ndn::Interest &interest);
+
+    void replyState(const ndn::Interest &interest, const std::string &state);
+
     void checkContent(const ndn::Interest &interest, const std::shared_ptr<boost::asio::deadline_timer> &timer, size_t remaining_tries);
 
     void generate_data(const std::shared_ptr<NdnContent> &content, const std::shared_ptr<boost::asio::deadline_timer> &timer, uint64_t segment = 0);
 
+    void generate_repairs(const std::shared_ptr<NdnContent> &content, uint64_t block, bool final);
+
+    void chunk_data(const std::shared_ptr<NdnContent> &content, const std::shared_ptr<NdnContent> &chunk_list,
+                    const std::shared_ptr<boost::asio::deadline_timer> &timer, uint64_t offset = 0);
+
+    void publish_chunk(const std::shared_ptr<NdnContent> &content, const std::shared_ptr<NdnContent> &chunk_list, const char *buffer, size_t size);
+
+    // publishes the body of a complete response under its digest and the header under the response name,
+    // responses too large or too slow to be hashed before they are served are published as they are
+    void name_body(const std::shared_ptr<NdnContent> &content, const std::shared_ptr<NdnContent> &header,
+                   const std::shared_ptr<boost::asio::deadline_timer> &timer);
+
     void purge_old_data();
 };
\ No newline at end of file
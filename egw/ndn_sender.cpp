@@ -14,12 +14,17 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "ndn_sender.h"
 
-NdnProducerSubModule::NdnProducerSubModule(OffloadedNdnProducer &parent, const ndn::Name &prefix) : SubModule(1, parent), _prefix(prefix), _face(_ios) {
+NdnProducerSubModule::NdnProducerSubModule(OffloadedNdnProducer &parent, const ndn::Name &prefix, const ndn::Name &instance_prefix)
+        : SubModule(1, parent), _prefix(prefix), _instance_prefix(instance_prefix), _face(_ios) {
     _parent.attachNdnProducer(this);
 }
 
 void NdnProducerSubModule::run() {
     _face.setInterestFilter(_prefix, bind(&NdnProducerSubModule::onInterest, this, _2), boost::bind(&NdnProducerSubModule::onRegisterFailed, this));
+    if (!_instance_prefix.empty()) {
+        // only registered for the forwarding hints, the Interests keep names under the shared prefix
+        _face.setInterestFilter(_instance_prefix, bind(&NdnProducerSubModule::onInterest, this, _2), boost::bind(&NdnProducerSubModule::onRegisterFailed, this));
+    }
 }
 
 void NdnProducerSubModule::publish(const std::shared_ptr<ndn::Data> &data) {
@@ -34,6 +39,18 @@ void NdnProducerSubModule::publishHandler(const std::shared_ptr<ndn::Data> &data
     }
 }
 
+void NdnProducerSubModule::nack(const ndn::Interest &interest, ndn::lp::NackReason reason) {
+    _ios.post(boost::bind(&NdnProducerSubModule::nackHandler, this, interest, reason));
+}
+
+void NdnProducerSubModule::nackHandler(const ndn::Interest &interest, ndn::lp::NackReason reason) {
+    try {
+        _face.put(ndn::lp::Nack(interest).setReason(reason));
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+    }
+}
+
 void NdnProducerSubModule::onInterest(const ndn::Interest &interest) {
     _parent.fromNdnProducer(interest);
 }
@@ -23,10 +23,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 class NdnProducerSubModule : public SubModule<OffloadedNdnProducer>, public NdnProducer {
 private:
     ndn::Name _prefix;
+    // prefix of this egw among others, ingress gateways put it as forwarding hint to choose it
+    ndn::Name _instance_prefix;
     ndn::Face _face;
 
 public:
-    NdnProducerSubModule(OffloadedNdnProducer &parent, const ndn::Name &prefix);
+    NdnProducerSubModule(OffloadedNdnProducer &parent, const ndn::Name &prefix, const ndn::Name &instance_prefix = ndn::Name());
 
     ~NdnProducerSubModule() = default;
 
@@ -34,9 +36,13 @@ public:
 
     void publish(const std::shared_ptr<ndn::Data> &data) override;
 
+    void nack(const ndn::Interest &interest, ndn::lp::NackReason reason) override;
+
 private:
     void publishHandler(const std::shared_ptr<ndn::Data> &data);
 
+    void nackHandler(const ndn::Interest &interest, ndn::lp::NackReason reason);
+
     void onInterest(const ndn::Interest &interest);
 
     void onRegisterFailed();
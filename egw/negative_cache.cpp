@@ -0,0 +1,69 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "negative_cache.h"
+
+#include <iostream>
+
+void NegativeCache::insert(const std::string &origin, const std::string &reason, const std::chrono::seconds &ttl) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _entries[origin] = Entry{reason, std::chrono::steady_clock::now() + ttl};
+    ++_failure_count;
+}
+
+std::chrono::seconds NegativeCache::find(const std::string &origin, std::string &reason) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _entries.find(origin);
+    if (it == _entries.end()) {
+        return std::chrono::seconds(0);
+    }
+    auto remaining = std::chrono::duration_cast<std::chrono::seconds>(it->second.until - std::chrono::steady_clock::now());
+    if (remaining.count() <= 0) {
+        _entries.erase(it);
+        return std::chrono::seconds(0);
+    }
+    reason = it->second.reason;
+    ++_hit_count;
+    return remaining;
+}
+
+void NegativeCache::erase(const std::string &origin) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _entries.erase(origin);
+}
+
+void NegativeCache::purge() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto time_point = std::chrono::steady_clock::now();
+    auto it = _entries.begin();
+    while (it != _entries.end()) {
+        if (it->second.until <= time_point) {
+            it = _entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+#ifndef NDEBUG
+    std::cout << _entries.size() << " failing origin(s), " << _failure_count << " failure(s), "
+              << _hit_count << " request(s) failed fast" << std::endl;
+#endif
+}
+
+size_t NegativeCache::getFailureCount() const {
+    return _failure_count;
+}
+
+size_t NegativeCache::getHitCount() const {
+    return _hit_count;
+}
@@ -0,0 +1,54 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// origins which recently failed to be resolved or connected, indexed by "host:port"
+class NegativeCache {
+private:
+    struct Entry {
+        std::string reason;
+        std::chrono::steady_clock::time_point until;
+    };
+
+    std::mutex _mutex;
+    std::unordered_map<std::string, Entry> _entries;
+
+    std::atomic<size_t> _failure_count {0};
+    std::atomic<size_t> _hit_count {0};
+
+public:
+    NegativeCache() = default;
+
+    ~NegativeCache() = default;
+
+    void insert(const std::string &origin, const std::string &reason, const std::chrono::seconds &ttl);
+
+    // remaining time during which the origin is considered as failing, zero if it is not
+    std::chrono::seconds find(const std::string &origin, std::string &reason);
+
+    void erase(const std::string &origin);
+
+    void purge();
+
+    size_t getFailureCount() const;
+
+    size_t getHitCount() const;
+};
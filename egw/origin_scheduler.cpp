@@ -0,0 +1,115 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "origin_scheduler.h"
+
+OriginScheduler::OriginScheduler(size_t max_per_origin, size_t max_total, size_t max_queued)
+        : _max_per_origin(max_per_origin)
+        , _max_total(max_total)
+        , _max_queued(max_queued) {
+
+}
+
+OriginScheduler::Admission OriginScheduler::submit(const std::string &origin, const std::function<void()> &task) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _queues.find(origin);
+    // already waiting requests of the origin go first
+    if ((it == _queues.end() || it->second.empty()) && canRun(origin)) {
+        ++_active[origin];
+        ++_total_active;
+        return ADMITTED;
+    }
+    if (_total_queued >= _max_queued) {
+        ++_rejected_count;
+        return REJECTED;
+    }
+    auto &queue = _queues[origin];
+    if (queue.empty()) {
+        _round_robin.push_back(origin);
+    }
+    queue.push_back(Waiting{task, std::chrono::steady_clock::now()});
+    ++_total_queued;
+    return QUEUED;
+}
+
+std::function<void()> OriginScheduler::release(const std::string &origin) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto active_it = _active.find(origin);
+    if (active_it != _active.end()) {
+        --_total_active;
+        if (--active_it->second == 0) {
+            _active.erase(active_it);
+        }
+    }
+
+    // visits each waiting origin at most once, the ones at their own limit keep their turn for later
+    for (size_t i = 0, size = _round_robin.size(); i < size && _total_active < _max_total; ++i) {
+        std::string next_origin = _round_robin.front();
+        _round_robin.pop_front();
+        if (canRun(next_origin)) {
+            auto queue_it = _queues.find(next_origin);
+            Waiting waiting = std::move(queue_it->second.front());
+            queue_it->second.pop_front();
+            if (queue_it->second.empty()) {
+                _queues.erase(queue_it);
+            } else {
+                _round_robin.push_back(next_origin);
+            }
+            --_total_queued;
+            ++_active[next_origin];
+            ++_total_active;
+
+            long queue_time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - waiting.since).count();
+            ++_dequeued_count;
+            _total_queue_time += queue_time;
+            if (queue_time > _max_queue_time) {
+                _max_queue_time = queue_time;
+            }
+            return waiting.task;
+        } else {
+            _round_robin.push_back(next_origin);
+        }
+    }
+    return std::function<void()>();
+}
+
+size_t OriginScheduler::getLoad() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _total_active + _total_queued;
+}
+
+size_t OriginScheduler::getDequeuedCount() const {
+    return _dequeued_count;
+}
+
+size_t OriginScheduler::getRejectedCount() const {
+    return _rejected_count;
+}
+
+long OriginScheduler::getAverageQueueTime() const {
+    size_t count = _dequeued_count;
+    return count > 0 ? _total_queue_time / static_cast<long>(count) : 0;
+}
+
+long OriginScheduler::getMaxQueueTime() const {
+    return _max_queue_time;
+}
+
+bool OriginScheduler::canRun(const std::string &origin) const {
+    if (_total_active >= _max_total) {
+        return false;
+    }
+    auto it = _active.find(origin);
+    return it == _active.end() || it->second < _max_per_origin;
+}
@@ -0,0 +1,82 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// limits the number of concurrent requests per origin and in total,
+// waiting requests are served origin after origin in a round-robin way
+class OriginScheduler {
+public:
+    enum Admission {
+        ADMITTED,
+        QUEUED,
+        REJECTED
+    };
+
+private:
+    struct Waiting {
+        std::function<void()> task;
+        std::chrono::steady_clock::time_point since;
+    };
+
+    size_t _max_per_origin;
+    size_t _max_total;
+    size_t _max_queued;
+
+    std::mutex _mutex;
+    std::unordered_map<std::string, size_t> _active;
+    size_t _total_active = 0;
+    std::unordered_map<std::string, std::deque<Waiting>> _queues;
+    std::deque<std::string> _round_robin;
+    size_t _total_queued = 0;
+
+    std::atomic<size_t> _dequeued_count {0};
+    std::atomic<size_t> _rejected_count {0};
+    std::atomic<long> _total_queue_time {0};
+    std::atomic<long> _max_queue_time {0};
+
+public:
+    OriginScheduler(size_t max_per_origin, size_t max_total, size_t max_queued);
+
+    ~OriginScheduler() = default;
+
+    // an admitted task must be run by the caller, a queued one will be returned by a later release()
+    Admission submit(const std::string &origin, const std::function<void()> &task);
+
+    // frees a slot of the origin and returns the next task allowed to run, if any
+    std::function<void()> release(const std::string &origin);
+
+    // requests being sent to an origin or waiting for a slot
+    size_t getLoad();
+
+    size_t getDequeuedCount() const;
+
+    size_t getRejectedCount() const;
+
+    // in milliseconds, over every dequeued task
+    long getAverageQueueTime() const;
+
+    long getMaxQueueTime() const;
+
+private:
+    bool canRun(const std::string &origin) const;
+};
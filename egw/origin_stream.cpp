@@ -0,0 +1,37 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "origin_stream.h"
+
+OriginStream::OriginStream(boost::asio::io_service &ios)
+        : _ios(&ios)
+        , _socket(ios) {
+
+}
+
+void OriginStream::enableTls(boost::asio::ssl::context &context) {
+    _tls_stream.reset(new TlsStream(*_ios, context));
+}
+
+bool OriginStream::isSecure() const {
+    return static_cast<bool>(_tls_stream);
+}
+
+boost::asio::ip::tcp::socket &OriginStream::socket() {
+    return _tls_stream ? _tls_stream->next_layer() : _socket;
+}
+
+OriginStream::TlsStream &OriginStream::tls() {
+    return *_tls_stream;
+}
@@ -0,0 +1,64 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "revalidation_cache.h"
+
+RevalidationCache::RevalidationCache(size_t max_size) : _max_size(max_size) {
+
+}
+
+bool RevalidationCache::find(const std::string &key, Entry &entry) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _index.find(key);
+    if (it == _index.end()) {
+        return false;
+    }
+    _entries.splice(_entries.begin(), _entries, it->second);
+    entry = it->second->second;
+    return true;
+}
+
+void RevalidationCache::insert(const std::string &key, const Entry &entry) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (entry.body.size() > _max_size) {
+        return;
+    }
+    auto it = _index.find(key);
+    if (it != _index.end()) {
+        _size -= it->second->second.body.size();
+        _entries.erase(it->second);
+    }
+    _entries.emplace_front(key, entry);
+    _index[key] = _entries.begin();
+    _size += entry.body.size();
+    evict();
+}
+
+void RevalidationCache::erase(const std::string &key) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _index.find(key);
+    if (it != _index.end()) {
+        _size -= it->second->second.body.size();
+        _entries.erase(it->second);
+        _index.erase(it);
+    }
+}
+
+void RevalidationCache::evict() {
+    while (_size > _max_size && !_entries.empty()) {
+        _size -= _entries.back().second.body.size();
+        _index.erase(_entries.back().first);
+        _entries.pop_back();
+    }
+}
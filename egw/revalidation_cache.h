@@ -0,0 +1,56 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// recently received responses with a validator, kept to answer a 304 of the origin without downloading the body again
+class RevalidationCache {
+public:
+    struct Entry {
+        std::string version;
+        std::string status_code;
+        std::string reason;
+        std::map<std::string, std::string> fields;
+        std::string body;
+    };
+
+private:
+    size_t _max_size;
+    size_t _size = 0;
+
+    std::mutex _mutex;
+    // most recently used first
+    std::list<std::pair<std::string, Entry>> _entries;
+    std::unordered_map<std::string, std::list<std::pair<std::string, Entry>>::iterator> _index;
+
+public:
+    explicit RevalidationCache(size_t max_size);
+
+    ~RevalidationCache() = default;
+
+    bool find(const std::string &key, Entry &entry);
+
+    void insert(const std::string &key, const Entry &entry);
+
+    void erase(const std::string &key);
+
+private:
+    void evict();
+};
@@ -0,0 +1,29 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sha256.h"
+
+#include <openssl/sha.h>
+
+std::string Sha256::hex(const void *data, size_t size) {
+    static const char HEX[] = "0123456789abcdef";
+    unsigned char digest[SHA256_DIGEST_LENGTH];
+    SHA256(static_cast<const unsigned char *>(data), size, digest);
+    std::string hex_digest;
+    for (unsigned char byte : digest) {
+        hex_digest.push_back(HEX[byte >> 4]);
+        hex_digest.push_back(HEX[byte & 0x0f]);
+    }
+    return hex_digest;
+}
@@ -0,0 +1,33 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "system_dns_resolver.h"
+
+SystemDnsResolver::SystemDnsResolver(boost::asio::io_service &ios, const std::chrono::seconds &ttl)
+        : _resolver(ios)
+        , _ttl(ttl) {
+
+}
+
+void SystemDnsResolver::resolve(const std::string &domain, const std::string &port, const Callback &callback) {
+    boost::asio::ip::tcp::resolver::query query(domain, port, boost::asio::ip::tcp::resolver::query::numeric_service);
+    auto ttl = _ttl;
+    _resolver.async_resolve(query, [callback, ttl](const boost::system::error_code &err, boost::asio::ip::tcp::resolver::iterator iterator) {
+        std::vector<boost::asio::ip::tcp::endpoint> endpoints;
+        for (; iterator != boost::asio::ip::tcp::resolver::iterator(); ++iterator) {
+            endpoints.push_back(iterator->endpoint());
+        }
+        callback(err, endpoints, ttl);
+    });
+}
@@ -0,0 +1,31 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "dns_resolver.h"
+
+// getaddrinfo does not expose the TTL of records, a fixed one is given to every answer
+class SystemDnsResolver : public DnsResolver {
+private:
+    boost::asio::ip::tcp::resolver _resolver;
+    std::chrono::seconds _ttl;
+
+public:
+    SystemDnsResolver(boost::asio::io_service &ios, const std::chrono::seconds &ttl);
+
+    ~SystemDnsResolver() override = default;
+
+    void resolve(const std::string &domain, const std::string &port, const Callback &callback) override;
+};
@@ -0,0 +1,150 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <atomic>
+#include <thread>
+
+#include "../dns_cache.h"
+#include "check.h"
+#include "stub_dns_resolver.h"
+
+namespace {
+    const std::vector<boost::asio::ip::tcp::endpoint> LOCALHOST {
+            boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string("127.0.0.1"), 80)};
+
+    struct Answer {
+        size_t count = 0;
+        boost::system::error_code err;
+        std::vector<boost::asio::ip::tcp::endpoint> endpoints;
+        std::chrono::seconds ttl {0};
+    };
+
+    DnsResolver::Callback record(Answer &answer) {
+        return [&answer](const boost::system::error_code &err, const std::vector<boost::asio::ip::tcp::endpoint> &endpoints,
+                         const std::chrono::seconds &ttl) {
+            ++answer.count;
+            answer.err = err;
+            answer.endpoints = endpoints;
+            answer.ttl = ttl;
+        };
+    }
+}
+
+static void concurrent_lookups_are_coalesced() {
+    StubDnsResolver *stub;
+    std::unique_ptr<DnsCache> cache(new DnsCache(std::unique_ptr<DnsResolver>(stub = new StubDnsResolver()),
+                                                 std::chrono::seconds(5), std::chrono::seconds(300), std::chrono::seconds(5)));
+    Answer first, second, other;
+    cache->resolve("example.com", "80", record(first));
+    cache->resolve("example.com", "80", record(second));
+    cache->resolve("example.org", "80", record(other));
+    CHECK(stub->getLookupCount() == 2);
+
+    CHECK(stub->answer("example.com", "80", boost::system::error_code(), LOCALHOST, std::chrono::seconds(60)));
+    CHECK(first.count == 1 && second.count == 1 && other.count == 0);
+    CHECK(first.endpoints == LOCALHOST && second.endpoints == LOCALHOST);
+
+    // answered from the cache, directly
+    Answer third;
+    cache->resolve("example.com", "80", record(third));
+    CHECK(third.count == 1 && third.endpoints == LOCALHOST);
+    CHECK(stub->getLookupCount() == 2);
+}
+
+static void ttl_is_bounded() {
+    StubDnsResolver *stub;
+    std::unique_ptr<DnsCache> cache(new DnsCache(std::unique_ptr<DnsResolver>(stub = new StubDnsResolver()),
+                                                 std::chrono::seconds(5), std::chrono::seconds(300), std::chrono::seconds(5)));
+    Answer low, high;
+    cache->resolve("low.example", "80", record(low));
+    cache->resolve("high.example", "80", record(high));
+    stub->answer("low.example", "80", boost::system::error_code(), LOCALHOST, std::chrono::seconds(1));
+    stub->answer("high.example", "80", boost::system::error_code(), LOCALHOST, std::chrono::seconds(86400));
+    CHECK(low.ttl == std::chrono::seconds(5));
+    CHECK(high.ttl == std::chrono::seconds(300));
+}
+
+static void expired_entries_are_resolved_again() {
+    StubDnsResolver *stub;
+    // nothing may be kept
+    std::unique_ptr<DnsCache> cache(new DnsCache(std::unique_ptr<DnsResolver>(stub = new StubDnsResolver()),
+                                                 std::chrono::seconds(0), std::chrono::seconds(0), std::chrono::seconds(0)));
+    Answer first, second;
+    cache->resolve("example.com", "80", record(first));
+    stub->answer("example.com", "80", boost::system::error_code(), LOCALHOST, std::chrono::seconds(60));
+    cache->resolve("example.com", "80", record(second));
+    CHECK(stub->getLookupCount() == 2);
+    CHECK(second.count == 0);
+    stub->answer("example.com", "80", boost::system::error_code(), LOCALHOST, std::chrono::seconds(60));
+    CHECK(second.count == 1);
+}
+
+static void failures_are_cached() {
+    StubDnsResolver *stub;
+    std::unique_ptr<DnsCache> cache(new DnsCache(std::unique_ptr<DnsResolver>(stub = new StubDnsResolver()),
+                                                 std::chrono::seconds(5), std::chrono::seconds(300), std::chrono::seconds(30)));
+    Answer failed, empty, cached;
+    cache->resolve("broken.example", "80", record(failed));
+    stub->answer("broken.example", "80", boost::asio::error::host_not_found, {}, std::chrono::seconds(60));
+    CHECK(failed.err == boost::asio::error::host_not_found);
+    CHECK(failed.ttl == std::chrono::seconds(30));
+
+    // an answer without address is a failure too
+    cache->resolve("empty.example", "80", record(empty));
+    stub->answer("empty.example", "80", boost::system::error_code(), {}, std::chrono::seconds(60));
+    CHECK(empty.ttl == std::chrono::seconds(30));
+
+    cache->resolve("broken.example", "80", record(cached));
+    CHECK(cached.count == 1 && cached.err == boost::asio::error::host_not_found);
+    CHECK(stub->getLookupCount() == 2);
+}
+
+static void resolver_is_replaced_after_pending_lookups() {
+    StubDnsResolver *old_stub;
+    std::unique_ptr<DnsCache> cache(new DnsCache(std::unique_ptr<DnsResolver>(old_stub = new StubDnsResolver()),
+                                                 std::chrono::seconds(5), std::chrono::seconds(300), std::chrono::seconds(5)));
+    Answer pending;
+    cache->resolve("example.com", "80", record(pending));
+
+    auto new_stub = new StubDnsResolver();
+    std::atomic<bool> replaced {false};
+    std::thread replacer([&cache, &replaced, new_stub] {
+        cache->setResolver(std::unique_ptr<DnsResolver>(new_stub));
+        replaced = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    CHECK(!replaced);
+
+    // the former resolver is still alive to answer
+    old_stub->answer("example.com", "80", boost::system::error_code(), LOCALHOST, std::chrono::seconds(60));
+    replacer.join();
+    CHECK(replaced && pending.count == 1);
+
+    // the answers of the former resolver are forgotten
+    Answer after;
+    cache->resolve("example.com", "80", record(after));
+    CHECK(new_stub->getLookupCount() == 1 && after.count == 0);
+    new_stub->answer("example.com", "80", boost::system::error_code(), LOCALHOST, std::chrono::seconds(60));
+    CHECK(after.count == 1);
+}
+
+int main() {
+    concurrent_lookups_are_coalesced();
+    ttl_is_bounded();
+    expired_entries_are_resolved_again();
+    failures_are_cached();
+    resolver_is_replaced_after_pending_lookups();
+    std::cout << "dns_cache_test passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,110 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <map>
+
+#include "../fec_codec.h"
+#include "../global.h"
+#include "check.h"
+
+namespace {
+    const size_t SEGMENT_SIZE = 1000;
+
+    std::string makeBody(size_t size) {
+        std::string body(size, '\0');
+        for (size_t i = 0; i < size; ++i) {
+            body[i] = (char) ((i * 131 + i / 7) & 0xff);
+        }
+        return body;
+    }
+}
+
+// as many segments as repairs are lost in a short block ending with a short segment
+static void lost_segments_are_rebuilt() {
+    std::string body = makeBody(SEGMENT_SIZE * (global::DEFAULT_FEC_BLOCK_SIZE - 3) + 345);
+    std::vector<std::string> sent;
+    std::vector<size_t> sizes;
+    for (size_t offset = 0; offset < body.size(); offset += SEGMENT_SIZE) {
+        sent.push_back(body.substr(offset, SEGMENT_SIZE));
+        sizes.push_back(sent.back().size());
+    }
+    std::vector<std::string> repairs = FecCodec::encode(sent, global::DEFAULT_FEC_REPAIR_COUNT);
+    CHECK(repairs.size() == global::DEFAULT_FEC_REPAIR_COUNT);
+
+    std::vector<std::string> segments(sent);
+    std::vector<bool> received(sent.size(), true);
+    for (size_t i : {(size_t) 1, sent.size() - 1}) {
+        segments[i].clear();
+        received[i] = false;
+    }
+    std::map<size_t, std::string> received_repairs;
+    for (size_t i = 0; i < repairs.size(); ++i) {
+        received_repairs[i] = repairs[i];
+    }
+    CHECK(FecCodec::decode(segments, received, received_repairs, sizes));
+    CHECK(segments == sent);
+}
+
+static void lost_repair_is_replaced_by_another() {
+    std::vector<std::string> sent;
+    for (size_t i = 0; i < global::DEFAULT_FEC_BLOCK_SIZE; ++i) {
+        sent.push_back(makeBody(SEGMENT_SIZE - i * 10).substr(i));
+    }
+    std::vector<size_t> sizes;
+    for (const auto &segment : sent) {
+        sizes.push_back(segment.size());
+    }
+    std::vector<std::string> repairs = FecCodec::encode(sent, global::DEFAULT_FEC_REPAIR_COUNT);
+
+    // the first repair is lost, the second one rebuilds the only lost segment
+    std::vector<std::string> segments(sent);
+    std::vector<bool> received(sent.size(), true);
+    segments[3].clear();
+    received[3] = false;
+    std::map<size_t, std::string> received_repairs {{1, repairs[1]}};
+    CHECK(FecCodec::decode(segments, received, received_repairs, sizes));
+    CHECK(segments == sent);
+}
+
+static void too_many_losses_are_reported() {
+    std::vector<std::string> sent;
+    for (size_t i = 0; i < global::DEFAULT_FEC_BLOCK_SIZE; ++i) {
+        sent.push_back(makeBody(SEGMENT_SIZE).substr(i));
+    }
+    std::vector<size_t> sizes;
+    for (const auto &segment : sent) {
+        sizes.push_back(segment.size());
+    }
+    std::vector<std::string> repairs = FecCodec::encode(sent, global::DEFAULT_FEC_REPAIR_COUNT);
+
+    std::vector<std::string> segments(sent);
+    std::vector<bool> received(sent.size(), true);
+    for (size_t i = 0; i <= global::DEFAULT_FEC_REPAIR_COUNT; ++i) {
+        segments[i].clear();
+        received[i] = false;
+    }
+    std::map<size_t, std::string> received_repairs;
+    for (size_t i = 0; i < repairs.size(); ++i) {
+        received_repairs[i] = repairs[i];
+    }
+    CHECK(!FecCodec::decode(segments, received, received_repairs, sizes));
+}
+
+int main() {
+    lost_segments_are_rebuilt();
+    lost_repair_is_replaced_by_another();
+    too_many_losses_are_reported();
+    std::cout << "fec_codec_test passed" << std::endl;
+    return 0;
+}
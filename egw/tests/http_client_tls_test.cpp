@@ -0,0 +1,185 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <boost/asio/ssl.hpp>
+
+#include <openssl/pem.h>
+#include <openssl/x509v3.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <thread>
+
+#include "../http_client.h"
+#include "check.h"
+
+namespace {
+    // every domain is this host, so no DNS server is needed
+    class LoopbackDnsResolver : public DnsResolver {
+    public:
+        void resolve(const std::string &/*domain*/, const std::string &port, const Callback &callback) override {
+            auto endpoint = boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string("127.0.0.1"),
+                                                           (unsigned short) std::stoi(port));
+            callback(boost::system::error_code(), {endpoint}, std::chrono::seconds(60));
+        }
+    };
+
+    // stands for the NDN side of the egw, keeps the responses of the client
+    class ResponseCollector : public HttpSource {
+    private:
+        std::mutex _mutex;
+        std::condition_variable _received;
+        std::vector<std::shared_ptr<HttpResponse>> _responses;
+
+    public:
+        void fromHttpSink(const std::shared_ptr<HttpRequest> &/*http_request*/, const std::shared_ptr<HttpResponse> &http_response) override {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _responses.push_back(http_response);
+            _received.notify_all();
+        }
+
+        // the response once completely read, nullptr if it doesn't come in time
+        std::shared_ptr<HttpResponse> wait(size_t index) {
+            std::shared_ptr<HttpResponse> http_response;
+            { // block for RAII
+                std::unique_lock<std::mutex> lock(_mutex);
+                if (!_received.wait_for(lock, std::chrono::seconds(10), [this, index] { return _responses.size() > index; })) {
+                    return nullptr;
+                }
+                http_response = _responses[index];
+            }
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+            while (!http_response->getRawStream()->is_completed() && !http_response->getRawStream()->is_aborted() &&
+                   std::chrono::steady_clock::now() < deadline) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            return http_response->getRawStream()->is_completed() ? http_response : nullptr;
+        }
+    };
+
+    // self-signed certificate of localhost, written to certificate_file for the client to trust it
+    void makeCertificate(std::shared_ptr<EVP_PKEY> &key, std::shared_ptr<X509> &certificate, const std::string &certificate_file) {
+        std::shared_ptr<EVP_PKEY_CTX> key_context(EVP_PKEY_CTX_new_id(EVP_PKEY_RSA, nullptr), EVP_PKEY_CTX_free);
+        EVP_PKEY *raw_key = nullptr;
+        CHECK(EVP_PKEY_keygen_init(key_context.get()) == 1);
+        CHECK(EVP_PKEY_CTX_set_rsa_keygen_bits(key_context.get(), 2048) == 1);
+        CHECK(EVP_PKEY_keygen(key_context.get(), &raw_key) == 1);
+        key.reset(raw_key, EVP_PKEY_free);
+
+        certificate.reset(X509_new(), X509_free);
+        X509_set_version(certificate.get(), 2);
+        ASN1_INTEGER_set(X509_get_serialNumber(certificate.get()), 1);
+        X509_gmtime_adj(X509_getm_notBefore(certificate.get()), -60);
+        X509_gmtime_adj(X509_getm_notAfter(certificate.get()), 3600);
+        X509_set_pubkey(certificate.get(), key.get());
+        X509_NAME *name = X509_get_subject_name(certificate.get());
+        X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char *) "localhost", -1, -1, 0);
+        X509_set_issuer_name(certificate.get(), name);
+        X509V3_CTX extension_context;
+        X509V3_set_ctx_nodb(&extension_context);
+        X509V3_set_ctx(&extension_context, certificate.get(), certificate.get(), nullptr, nullptr, 0);
+        X509_EXTENSION *extension = X509V3_EXT_conf_nid(nullptr, &extension_context, NID_subject_alt_name, (char *) "DNS:localhost");
+        CHECK(extension != nullptr);
+        X509_add_ext(certificate.get(), extension, -1);
+        X509_EXTENSION_free(extension);
+        CHECK(X509_sign(certificate.get(), key.get(), EVP_sha256()) > 0);
+
+        FILE *file = std::fopen(certificate_file.c_str(), "w");
+        CHECK(file != nullptr);
+        PEM_write_X509(file, certificate.get());
+        std::fclose(file);
+    }
+
+    std::shared_ptr<HttpRequest> makeRequest(unsigned short port) {
+        auto http_request = std::make_shared<HttpRequest>();
+        http_request->set_method("GET");
+        http_request->set_path("/");
+        http_request->set_version("HTTP/1.1");
+        http_request->set_field("host", "localhost:" + std::to_string(port));
+        http_request->set_field("x-forwarded-proto", "https");
+        http_request->is_parsed(true);
+        // no body
+        http_request->getRawStream()->is_completed(true);
+        return http_request;
+    }
+}
+
+// a local TLS origin closes every connection, so the second request needs a new handshake, which must resume the first session
+int main() {
+    std::string certificate_file = "/tmp/http_client_tls_test_" + std::to_string(::getpid()) + ".pem";
+    std::shared_ptr<EVP_PKEY> key;
+    std::shared_ptr<X509> certificate;
+    makeCertificate(key, certificate, certificate_file);
+
+    boost::asio::ssl::context server_context(boost::asio::ssl::context::sslv23_server);
+    CHECK(SSL_CTX_use_certificate(server_context.native_handle(), certificate.get()) == 1);
+    CHECK(SSL_CTX_use_PrivateKey(server_context.native_handle(), key.get()) == 1);
+
+    boost::asio::io_service server_ios;
+    boost::asio::ip::tcp::acceptor acceptor(server_ios, boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string("127.0.0.1"), 0));
+    unsigned short port = acceptor.local_endpoint().port();
+    const size_t connection_count = 2;
+    std::atomic<bool> resumed[connection_count];
+    std::atomic<bool> served[connection_count];
+    for (size_t i = 0; i < connection_count; ++i) {
+        resumed[i] = false;
+        served[i] = false;
+    }
+    std::thread origin([&] {
+        try {
+            for (size_t i = 0; i < connection_count; ++i) {
+                boost::asio::ssl::stream<boost::asio::ip::tcp::socket> stream(server_ios, server_context);
+                acceptor.accept(stream.lowest_layer());
+                stream.handshake(boost::asio::ssl::stream_base::server);
+                resumed[i] = SSL_session_reused(stream.native_handle()) == 1;
+                boost::asio::streambuf request;
+                boost::asio::read_until(stream, request, "\r\n\r\n");
+                std::string response = "HTTP/1.1 200 OK\r\ncontent-length: 5\r\nconnection: close\r\n\r\nhello";
+                boost::asio::write(stream, boost::asio::buffer(response));
+                SSL_shutdown(stream.native_handle());
+                stream.lowest_layer().close();
+                served[i] = true;
+            }
+        } catch (const std::exception &e) {
+            std::cerr << "origin: " << e.what() << std::endl;
+        }
+    });
+
+    ResponseCollector collector;
+    HttpClient http_client(1);
+    http_client.setDnsResolver(std::unique_ptr<DnsResolver>(new LoopbackDnsResolver()));
+    http_client.setTlsVerifyFile(certificate_file);
+    http_client.attachHttpSource(&collector);
+    collector.attachHttpSink(&http_client);
+    http_client.start();
+
+    for (size_t i = 0; i < connection_count; ++i) {
+        http_client.fromHttpSource(makeRequest(port));
+        auto http_response = collector.wait(i);
+        CHECK(http_response != nullptr);
+        CHECK(http_response->get_status_code() == "200");
+        std::string raw_data = http_response->getRawStream()->raw_data_as_string();
+        CHECK(raw_data.size() >= 5 && raw_data.compare(raw_data.size() - 5, 5, "hello") == 0);
+    }
+    origin.join();
+    http_client.stop();
+    std::remove(certificate_file.c_str());
+
+    CHECK(served[0] && served[1]);
+    CHECK(!resumed[0]);
+    CHECK(resumed[1]);
+    std::cout << "http_client_tls_test passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,85 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include "../ndn_resolver.h"
+#include "check.h"
+
+namespace {
+    // stands for the NDN face of the egw, keeps the segments published for the Interests
+    class DataCollector : public NdnProducer {
+    private:
+        std::mutex _mutex;
+        std::condition_variable _published;
+        std::map<std::string, std::shared_ptr<ndn::Data>> _datas;
+
+    public:
+        void publish(const std::shared_ptr<ndn::Data> &data) override {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _datas[data->getName().toUri()] = data;
+            _published.notify_all();
+        }
+
+        void nack(const ndn::Interest &/*interest*/, ndn::lp::NackReason /*reason*/) override {
+
+        }
+
+        // the Data answering the name, nullptr if it doesn't come in time
+        std::shared_ptr<ndn::Data> wait(const ndn::Name &name) {
+            std::unique_lock<std::mutex> lock(_mutex);
+            if (!_published.wait_for(lock, std::chrono::seconds(5), [this, &name] { return _datas.count(name.toUri()) > 0; })) {
+                return nullptr;
+            }
+            return _datas[name.toUri()];
+        }
+    };
+}
+
+// a response is completed after its last bytes were flushed in a segment, an empty segment must then tell where it ends
+int main() {
+    DataCollector collector;
+    NdnResolver ndn_resolver(1);
+    ndn_resolver.attachNdnProducer(&collector);
+    ndn_resolver.start();
+
+    auto content = std::make_shared<NdnContent>();
+    content->setName(ndn::Name("/egw/http/www.example.com").append("0123456789abcdef"));
+    content->setFreshness(ndn::time::milliseconds(10000));
+    content->setTimestamp(ndn::time::system_clock::now());
+    content->getRawStream()->append_raw_data("HTTP/1.1 200 OK\r\n\r\nhello");
+    ndn_resolver.fromNdnSink(content);
+    ndn::Name version(ndn::Name(content->getName()).appendTimestamp(content->getTimestamp()));
+
+    // the first bytes are flushed while the origin is still sending
+    ndn_resolver.fromNdnProducer(ndn::Interest(ndn::Name(version).appendSegment(0)));
+    auto first = collector.wait(ndn::Name(version).appendSegment(0));
+    CHECK(first != nullptr);
+    CHECK(first->getContent().value_size() == 24);
+    CHECK(first->getFinalBlockId().empty());
+
+    content->getRawStream()->is_completed(true);
+    ndn_resolver.fromNdnProducer(ndn::Interest(ndn::Name(version).appendSegment(1)));
+    auto last = collector.wait(ndn::Name(version).appendSegment(1));
+    CHECK(last != nullptr);
+    CHECK(last->getContent().value_size() == 0);
+    CHECK(!last->getFinalBlockId().empty() && last->getFinalBlockId().toSegment() == 1);
+
+    ndn_resolver.stop();
+    std::cout << "ndn_resolver_test passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,68 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include "../dns_resolver.h"
+
+// answers lookups only when told to, so tests control the order of events without a DNS server
+class StubDnsResolver : public DnsResolver {
+private:
+    std::mutex _mutex;
+    std::multimap<std::string, Callback> _pendings;
+    size_t _lookup_count = 0;
+
+public:
+    StubDnsResolver() = default;
+
+    ~StubDnsResolver() override = default;
+
+    void resolve(const std::string &domain, const std::string &port, const Callback &callback) override {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_lookup_count;
+        _pendings.emplace(domain + ":" + port, callback);
+    }
+
+    size_t getLookupCount() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _lookup_count;
+    }
+
+    size_t getPendingCount() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _pendings.size();
+    }
+
+    // answers every pending lookup of the domain, false if there was none
+    bool answer(const std::string &domain, const std::string &port, const boost::system::error_code &err,
+                const std::vector<boost::asio::ip::tcp::endpoint> &endpoints, const std::chrono::seconds &ttl) {
+        std::vector<Callback> callbacks;
+        { // block for RAII
+            std::lock_guard<std::mutex> lock(_mutex);
+            auto range = _pendings.equal_range(domain + ":" + port);
+            for (auto it = range.first; it != range.second; ++it) {
+                callbacks.push_back(it->second);
+            }
+            _pendings.erase(range.first, range.second);
+        }
+        for (const auto &callback : callbacks) {
+            callback(err, endpoints, ttl);
+        }
+        return !callbacks.empty();
+    }
+};
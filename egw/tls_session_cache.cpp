@@ -0,0 +1,78 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "tls_session_cache.h"
+
+#include <ctime>
+#include <iostream>
+
+TlsSessionCache::TlsSessionCache(size_t max_size)
+        : _max_size(max_size) {
+
+}
+
+void TlsSessionCache::prepare(const std::string &origin, SSL *ssl) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _sessions.find(origin);
+    if (it != _sessions.end()) {
+        // the session is referenced by ssl, it stays valid even if it is replaced in the cache
+        SSL_set_session(ssl, it->second.get());
+    }
+}
+
+void TlsSessionCache::store(const std::string &origin, SSL *ssl) {
+    SSL_SESSION *session = SSL_get_session(ssl);
+    if (!session || !SSL_SESSION_is_resumable(session)) {
+        return;
+    }
+    // connections are closed without TLS shutdown, which marks their own session as not resumable
+    session = SSL_SESSION_dup(session);
+    if (!session) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_sessions.size() >= _max_size && _sessions.find(origin) == _sessions.end()) {
+        // any session can go, it only costs a full handshake
+        _sessions.erase(_sessions.begin());
+    }
+    _sessions[origin] = std::shared_ptr<SSL_SESSION>(session, SSL_SESSION_free);
+}
+
+void TlsSessionCache::erase(const std::string &origin) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _sessions.erase(origin);
+}
+
+void TlsSessionCache::purge() {
+    std::lock_guard<std::mutex> lock(_mutex);
+#ifndef NDEBUG
+    size_t remove_count = 0;
+#endif
+    long now = std::time(nullptr);
+    auto it = _sessions.begin();
+    while (it != _sessions.end()) {
+        if (SSL_SESSION_get_time(it->second.get()) + SSL_SESSION_get_timeout(it->second.get()) <= now) {
+            it = _sessions.erase(it);
+#ifndef NDEBUG
+            ++remove_count;
+#endif
+        } else {
+            ++it;
+        }
+    }
+#ifndef NDEBUG
+    std::cout << remove_count << " TLS session(s) expired (" << _sessions.size() << " remaining)" << std::endl;
+#endif
+}
@@ -0,0 +1,46 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <openssl/ssl.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// last resumable TLS session of each HTTPS origin, new connections resume it instead of doing a full handshake
+class TlsSessionCache {
+private:
+    size_t _max_size;
+
+    std::mutex _mutex;
+    std::unordered_map<std::string, std::shared_ptr<SSL_SESSION>> _sessions;
+
+public:
+    explicit TlsSessionCache(size_t max_size);
+
+    ~TlsSessionCache() = default;
+
+    // offers the session of the origin to ssl, must be called before the handshake
+    void prepare(const std::string &origin, SSL *ssl);
+
+    // keeps the session of ssl for the origin, TLS 1.3 tickets may only be received after the handshake
+    void store(const std::string &origin, SSL *ssl);
+
+    void erase(const std::string &origin);
+
+    void purge();
+};
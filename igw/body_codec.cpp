@@ -0,0 +1,170 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "body_codec.h"
+
+#include <algorithm>
+#include <sstream>
+
+GzipEncoder::GzipEncoder() {
+    _stream.zalloc = Z_NULL;
+    _stream.zfree = Z_NULL;
+    _stream.opaque = Z_NULL;
+    // 16 + max window bits for a gzip wrapper instead of zlib
+    _initialized = deflateInit2(&_stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+}
+
+GzipEncoder::~GzipEncoder() {
+    if (_initialized) {
+        deflateEnd(&_stream);
+    }
+}
+
+bool GzipEncoder::encode(const char *data, size_t size, std::string &output, int flush) {
+    if (!_initialized) {
+        return false;
+    }
+    char buffer[4096];
+    _stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    _stream.avail_in = static_cast<uInt>(size);
+    do {
+        _stream.next_out = reinterpret_cast<Bytef*>(buffer);
+        _stream.avail_out = sizeof(buffer);
+        int ret = deflate(&_stream, flush);
+        if (ret == Z_STREAM_ERROR) {
+            return false;
+        }
+        output.append(buffer, sizeof(buffer) - _stream.avail_out);
+    } while (_stream.avail_out == 0);
+    return true;
+}
+
+GzipDecoder::GzipDecoder() {
+    _stream.zalloc = Z_NULL;
+    _stream.zfree = Z_NULL;
+    _stream.opaque = Z_NULL;
+    _stream.next_in = Z_NULL;
+    _stream.avail_in = 0;
+    // 32 + max window bits to detect a gzip or zlib header
+    _initialized = inflateInit2(&_stream, 32 + MAX_WBITS) == Z_OK;
+}
+
+GzipDecoder::~GzipDecoder() {
+    if (_initialized) {
+        inflateEnd(&_stream);
+    }
+}
+
+bool GzipDecoder::decode(const char *data, size_t size, std::string &output) {
+    if (!_initialized) {
+        return false;
+    }
+    char buffer[4096];
+    _stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    _stream.avail_in = static_cast<uInt>(size);
+    while (!_finished && _stream.avail_in > 0) {
+        _stream.next_out = reinterpret_cast<Bytef*>(buffer);
+        _stream.avail_out = sizeof(buffer);
+        int ret = inflate(&_stream, Z_NO_FLUSH);
+        if (ret == Z_STREAM_END) {
+            _finished = true;
+        } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+            return false;
+        }
+        output.append(buffer, sizeof(buffer) - _stream.avail_out);
+    }
+    return true;
+}
+
+bool GzipDecoder::is_finished() const {
+    return _finished;
+}
+
+bool ChunkedDecoder::decode(const char *data, size_t size, std::string &output) {
+    _pending.append(data, size);
+    size_t delimiter_index;
+    while (_state != DONE) {
+        switch (_state) {
+            case SIZE:
+                if ((delimiter_index = _pending.find("\r\n")) == std::string::npos) {
+                    return true;
+                }
+                try {
+                    // chunk extensions after ';' are ignored
+                    _remaining_bytes = std::stoul(_pending.substr(0, _pending.find(';')), nullptr, 16);
+                } catch (const std::exception &e) {
+                    return false;
+                }
+                _pending.erase(0, delimiter_index + 2);
+                _state = _remaining_bytes > 0 ? DATA : TRAILER;
+                break;
+            case DATA: {
+                size_t min = std::min(_remaining_bytes, _pending.size());
+                output.append(_pending, 0, min);
+                _pending.erase(0, min);
+                _remaining_bytes -= min;
+                if (_remaining_bytes > 0) {
+                    return true;
+                }
+                _state = DATA_END;
+                break;
+            }
+            case DATA_END:
+                if (_pending.size() < 2) {
+                    return true;
+                }
+                _pending.erase(0, 2);
+                _state = SIZE;
+                break;
+            case TRAILER:
+                if ((delimiter_index = _pending.find("\r\n")) == std::string::npos) {
+                    return true;
+                }
+                _pending.erase(0, delimiter_index + 2);
+                if (delimiter_index == 0) {
+                    _state = DONE;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    return true;
+}
+
+bool ChunkedDecoder::is_finished() const {
+    return _state == DONE;
+}
+
+std::string make_chunk(const std::string &data) {
+    std::stringstream ss;
+    ss << std::hex << data.size() << "\r\n" << data << "\r\n";
+    return ss.str();
+}
+
+bool is_compressible(const std::string &content_type) {
+    std::string type = content_type.substr(0, content_type.find(';'));
+    std::transform(type.begin(), type.end(), type.begin(), ::tolower);
+    type.erase(type.find_last_not_of(' ') + 1);
+    // an event stream must reach the client as soon as it is produced
+    if (type == "text/event-stream") {
+        return false;
+    }
+    auto ends_with = [&type](const std::string &suffix) {
+        return type.size() >= suffix.size() && type.compare(type.size() - suffix.size(), suffix.size(), suffix) == 0;
+    };
+    return type.compare(0, 5, "text/") == 0 || ends_with("+json") || ends_with("+xml") ||
+           type == "application/json" || type == "application/javascript" || type == "application/x-javascript" ||
+           type == "application/ecmascript" || type == "application/xml";
+}
@@ -0,0 +1,165 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "byte_range.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+
+static bool parse_number(const std::string &value, uint64_t &number) {
+    // 19 digits always fit in 64 bits
+    if (value.empty() || value.size() > 19 || !std::all_of(value.begin(), value.end(), ::isdigit)) {
+        return false;
+    }
+    number = std::strtoull(value.c_str(), nullptr, 10);
+    return true;
+}
+
+ByteRange::ByteRange(const std::string &range, const std::string &if_range) {
+    parse(range, if_range);
+}
+
+void ByteRange::parse(const std::string &range, const std::string &if_range) {
+    _valid = false;
+    _resolved = false;
+    std::string value = range;
+    value.erase(std::remove_if(value.begin(), value.end(), ::isspace), value.end());
+    size_t delimiter_index = value.find('=');
+    std::string unit = value.substr(0, delimiter_index);
+    std::transform(unit.begin(), unit.end(), unit.begin(), ::tolower);
+    // several ranges would need a multipart response, the full one is served instead
+    if (delimiter_index == std::string::npos || unit != "bytes" || value.find(',') != std::string::npos) {
+        return;
+    }
+    std::string spec = value.substr(delimiter_index + 1);
+    size_t dash_index = spec.find('-');
+    if (dash_index == std::string::npos) {
+        return;
+    }
+    std::string first = spec.substr(0, dash_index);
+    std::string last = spec.substr(dash_index + 1);
+    if (first.empty()) {
+        // suffix range, the last bytes of the body
+        _suffix = true;
+        _first = 0;
+        _valid = parse_number(last, _last) && _last > 0;
+    } else {
+        _suffix = false;
+        _last = std::numeric_limits<uint64_t>::max();
+        _valid = parse_number(first, _first) && (last.empty() || (parse_number(last, _last) && _first <= _last));
+    }
+    _if_range = if_range;
+}
+
+bool ByteRange::isValid() const {
+    return _valid;
+}
+
+std::string ByteRange::toString() const {
+    if (!_valid) {
+        return std::string();
+    }
+    std::string range = "bytes=" + (_suffix ? "" : std::to_string(_first)) + "-" +
+                        (_last != std::numeric_limits<uint64_t>::max() ? std::to_string(_last) : "");
+    return _if_range.empty() ? range : range + ";" + _if_range;
+}
+
+bool ByteRange::resolve(const std::string &response) {
+    size_t header_end = response.find("\r\n\r\n");
+    if (!_valid || header_end == std::string::npos) {
+        return false;
+    }
+
+    std::stringstream header(response.substr(0, header_end + 2));
+    std::string header_line;
+    std::getline(header, header_line);
+    size_t delimiter_index = header_line.find(' ');
+    if (delimiter_index == std::string::npos || header_line.compare(delimiter_index + 1, 4, "200 ") != 0) {
+        return false;
+    }
+    std::string content_length;
+    std::string transfer_encoding;
+    std::string etag;
+    std::string last_modified;
+    while (std::getline(header, header_line) && (delimiter_index = header_line.find(':')) != std::string::npos) {
+        std::string name = header_line.substr(0, delimiter_index);
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        std::string value = header_line.substr(delimiter_index + 1);
+        value.erase(0, value.find_first_not_of(' '));
+        value.erase(value.find_last_not_of(" \r") + 1);
+        if (name == "content-length") {
+            content_length = value;
+        } else if (name == "transfer-encoding") {
+            transfer_encoding = value;
+        } else if (name == "etag") {
+            etag = value;
+        } else if (name == "last-modified") {
+            last_modified = value;
+        }
+    }
+
+    // bytes of a chunked body are not at a known offset
+    uint64_t length;
+    if (!transfer_encoding.empty() || !parse_number(content_length, length) || length == 0) {
+        return false;
+    }
+    // if-range holds either a strong entity tag or a date
+    if (!_if_range.empty() && (_if_range[0] == '"' || _if_range.compare(0, 2, "W/") == 0 ?
+                               _if_range != etag || etag.compare(0, 2, "W/") == 0 : _if_range != last_modified)) {
+        return false;
+    }
+    uint64_t first = _first;
+    uint64_t last = _last;
+    if (_suffix) {
+        first = length > _last ? length - _last : 0;
+        last = length - 1;
+    } else if (_first >= length) {
+        // not satisfiable
+        return false;
+    } else {
+        last = std::min(_last, length - 1);
+    }
+
+    _resolved_first = first;
+    _resolved_last = last;
+    _length = length;
+    _header_length = header_end + 4;
+    _resolved = true;
+    return true;
+}
+
+bool ByteRange::isResolved() const {
+    return _resolved;
+}
+
+uint64_t ByteRange::getFirst() const {
+    return _resolved_first;
+}
+
+uint64_t ByteRange::getLast() const {
+    return _resolved_last;
+}
+
+uint64_t ByteRange::getLength() const {
+    return _length;
+}
+
+size_t ByteRange::getHeaderLength() const {
+    return _header_length;
+}
+
+std::string ByteRange::getContentRange() const {
+    return "bytes " + std::to_string(_resolved_first) + "-" + std::to_string(_resolved_last) + "/" + std::to_string(_length);
+}
@@ -0,0 +1,66 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <string>
+
+// single range of a range header field in bytes, resolved against the header of the full response once it is received
+class ByteRange {
+private:
+    bool _valid = false;
+    bool _suffix = false;
+    uint64_t _first = 0;
+    uint64_t _last = std::numeric_limits<uint64_t>::max();
+    std::string _if_range;
+
+    bool _resolved = false;
+    uint64_t _resolved_first = 0;
+    uint64_t _resolved_last = 0;
+    uint64_t _length = 0;
+    size_t _header_length = 0;
+
+public:
+    ByteRange() = default;
+
+    ByteRange(const std::string &range, const std::string &if_range);
+
+    ~ByteRange() = default;
+
+    void parse(const std::string &range, const std::string &if_range);
+
+    bool isValid() const;
+
+    // canonical form of the range, requests with the same one can share a response
+    std::string toString() const;
+
+    // true if the response given by its first bytes can be served partially, a full response is served otherwise
+    bool resolve(const std::string &response);
+
+    bool isResolved() const;
+
+    uint64_t getFirst() const;
+
+    uint64_t getLast() const;
+
+    // length of the full body
+    uint64_t getLength() const;
+
+    // length of the HTTP header in front of the body, the raw offset of the byte n of the body is n + header length
+    size_t getHeaderLength() const;
+
+    std::string getContentRange() const;
+};
@@ -0,0 +1,84 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "cache_control.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+CacheControl::CacheControl(const std::string &header) {
+    parse(header);
+}
+
+void CacheControl::parse(const std::string &header) {
+    size_t pos = 0;
+    while (pos < header.size()) {
+        // directive name
+        size_t name_start = header.find_first_not_of(" \t,", pos);
+        if (name_start == std::string::npos) {
+            break;
+        }
+        size_t name_end = header.find_first_of(" \t,=", name_start);
+        std::string name = header.substr(name_start, name_end - name_start);
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        pos = name_end;
+
+        // optional value, token or quoted string which may contain commas
+        std::string value;
+        size_t value_start = pos != std::string::npos ? header.find_first_not_of(" \t", pos) : std::string::npos;
+        if (value_start != std::string::npos && header[value_start] == '=') {
+            value_start = header.find_first_not_of(" \t", value_start + 1);
+            if (value_start != std::string::npos && header[value_start] == '"') {
+                size_t value_end = header.find('"', value_start + 1);
+                value = header.substr(value_start + 1, value_end != std::string::npos ? value_end - value_start - 1 : std::string::npos);
+                pos = value_end != std::string::npos ? value_end + 1 : header.size();
+            } else if (value_start != std::string::npos) {
+                size_t value_end = header.find_first_of(" \t,", value_start);
+                value = header.substr(value_start, value_end - value_start);
+                pos = value_end;
+            } else {
+                pos = std::string::npos;
+            }
+        }
+        if (pos == std::string::npos) {
+            pos = header.size();
+        }
+        pos = header.find(',', pos);
+        if (pos == std::string::npos) {
+            pos = header.size();
+        }
+
+        // the first occurrence of a directive is the one kept
+        if (!name.empty()) {
+            _directives.emplace(name, value);
+        }
+    }
+}
+
+bool CacheControl::has(const std::string &directive) const {
+    return _directives.find(directive) != _directives.end();
+}
+
+std::string CacheControl::get(const std::string &directive) const {
+    auto it = _directives.find(directive);
+    return it != _directives.end() ? it->second : std::string();
+}
+
+long CacheControl::getSeconds(const std::string &directive) const {
+    auto it = _directives.find(directive);
+    if (it == _directives.end() || it->second.empty() || !std::all_of(it->second.begin(), it->second.end(), ::isdigit)) {
+        return -1;
+    }
+    return std::strtol(it->second.c_str(), nullptr, 10);
+}
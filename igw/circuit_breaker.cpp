@@ -0,0 +1,101 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "circuit_breaker.h"
+
+#include <iostream>
+#include <algorithm>
+
+CircuitBreaker::CircuitBreaker(size_t threshold, const std::chrono::milliseconds &open_time,
+                               const std::chrono::milliseconds &min_backoff, const std::chrono::milliseconds &max_backoff)
+        : _threshold(threshold)
+        , _open_time(open_time)
+        , _min_backoff(min_backoff)
+        , _max_backoff(max_backoff) {
+
+}
+
+bool CircuitBreaker::allow(const std::string &prefix) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _entries.find(prefix);
+    if (it == _entries.end() || it->second.state == CLOSED) {
+        return true;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (it->second.state == OPEN && it->second.since + it->second.open_time <= now) {
+        it->second.state = HALF_OPEN;
+        it->second.probing = false;
+    }
+    // only one probe at a time, a lost probe is replaced after the same delay as an open state
+    if (it->second.state == HALF_OPEN && (!it->second.probing || it->second.since + it->second.open_time <= now)) {
+        it->second.probing = true;
+        it->second.since = now;
+        return true;
+    }
+    return false;
+}
+
+void CircuitBreaker::onSuccess(const std::string &prefix) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _entries.find(prefix);
+    if (it != _entries.end()) {
+#ifndef NDEBUG
+        if (it->second.state != CLOSED) {
+            std::cout << "circuit breaker closed for " << prefix << std::endl;
+        }
+#endif
+        _entries.erase(it);
+    }
+}
+
+void CircuitBreaker::onFailure(const std::string &prefix) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    Entry &entry = _entries[prefix];
+    ++entry.failures;
+    if (entry.state == HALF_OPEN || (entry.state == CLOSED && entry.failures >= _threshold)) {
+        entry.state = OPEN;
+        entry.probing = false;
+        entry.since = std::chrono::steady_clock::now();
+        entry.open_time = _open_time;
+        std::cerr << "circuit breaker opened for " << prefix << " after " << entry.failures << " failure(s)" << std::endl;
+    }
+}
+
+void CircuitBreaker::onOverload(const std::string &prefix) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    Entry &entry = _entries[prefix];
+    auto backoff = _min_backoff;
+    for (size_t i = 0; i < entry.overloads && backoff < _max_backoff; ++i) {
+        backoff *= 2;
+    }
+    ++entry.overloads;
+    entry.state = OPEN;
+    entry.probing = false;
+    entry.since = std::chrono::steady_clock::now();
+    entry.open_time = std::min(backoff, _max_backoff);
+#ifndef NDEBUG
+    std::cout << "backing off " << prefix << " for " << entry.open_time.count() << " ms after " << entry.overloads << " overload(s)" << std::endl;
+#endif
+}
+
+long CircuitBreaker::retryAfter(const std::string &prefix) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _entries.find(prefix);
+    if (it == _entries.end() || it->second.state == CLOSED) {
+        return 0;
+    }
+    auto remaining = std::chrono::duration_cast<std::chrono::seconds>(it->second.since + it->second.open_time - std::chrono::steady_clock::now());
+    return std::max(remaining.count(), 1L);
+}
@@ -0,0 +1,67 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// keeps track of consecutive failures per egw prefix to answer immediately when an egw is unreachable
+class CircuitBreaker {
+private:
+    enum state_type {
+        CLOSED,
+        OPEN,
+        HALF_OPEN,
+    };
+
+    struct Entry {
+        state_type state = CLOSED;
+        size_t failures = 0;
+        bool probing = false;
+        std::chrono::steady_clock::time_point since;
+        // open time of a failure, or backoff doubled by every consecutive overload
+        std::chrono::milliseconds open_time = std::chrono::milliseconds(0);
+        size_t overloads = 0;
+    };
+
+    size_t _threshold;
+    std::chrono::milliseconds _open_time;
+    std::chrono::milliseconds _min_backoff;
+    std::chrono::milliseconds _max_backoff;
+
+    std::mutex _mutex;
+    std::unordered_map<std::string, Entry> _entries;
+
+public:
+    CircuitBreaker(size_t threshold, const std::chrono::milliseconds &open_time,
+                   const std::chrono::milliseconds &min_backoff, const std::chrono::milliseconds &max_backoff);
+
+    ~CircuitBreaker() = default;
+
+    // returns false if requests to this prefix must fail fast, true lets a request (or a half-open probe) pass
+    bool allow(const std::string &prefix);
+
+    void onSuccess(const std::string &prefix);
+
+    void onFailure(const std::string &prefix);
+
+    // the egw answered but is saturated, it is left alone for a backoff growing with consecutive overloads
+    void onOverload(const std::string &prefix);
+
+    // seconds before the next probe is allowed, 0 if the breaker is closed
+    long retryAfter(const std::string &prefix);
+};
@@ -0,0 +1,46 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "client_stream.h"
+
+ClientStream::ClientStream(boost::asio::ip::tcp::socket &&socket)
+        : _socket(std::move(socket)) {
+
+}
+
+ClientStream::ClientStream(boost::asio::io_service &ios, boost::asio::ssl::context &context)
+        : _socket(ios)
+        , _tls_stream(new TlsStream(ios, context)) {
+
+}
+
+ClientStream::~ClientStream() {
+    if (_tls_stream && SSL_is_init_finished(_tls_stream->native_handle())) {
+        // connections are closed without close_notify, a quiet shutdown keeps their session in the cache
+        SSL_set_quiet_shutdown(_tls_stream->native_handle(), 1);
+        SSL_shutdown(_tls_stream->native_handle());
+    }
+}
+
+bool ClientStream::isSecure() const {
+    return static_cast<bool>(_tls_stream);
+}
+
+boost::asio::ip::tcp::socket &ClientStream::socket() {
+    return _tls_stream ? _tls_stream->next_layer() : _socket;
+}
+
+ClientStream::TlsStream &ClientStream::tls() {
+    return *_tls_stream;
+}
@@ -0,0 +1,80 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+#include <boost/version.hpp>
+
+#include <memory>
+#include <utility>
+
+// connection of a client, TLS clients are served through a TLS stream over the socket
+class ClientStream {
+public:
+    typedef boost::asio::ssl::stream<boost::asio::ip::tcp::socket> TlsStream;
+
+private:
+    boost::asio::ip::tcp::socket _socket;
+    std::unique_ptr<TlsStream> _tls_stream;
+
+public:
+    explicit ClientStream(boost::asio::ip::tcp::socket &&socket);
+
+    // the socket of the TLS stream is the one to accept the connection with
+    ClientStream(boost::asio::io_service &ios, boost::asio::ssl::context &context);
+
+    ClientStream(ClientStream &&) = default;
+
+    ClientStream &operator=(ClientStream &&) = default;
+
+    ~ClientStream();
+
+    bool isSecure() const;
+
+    boost::asio::ip::tcp::socket &socket();
+
+    TlsStream &tls();
+
+#if BOOST_VERSION >= 106600
+    typedef boost::asio::ip::tcp::socket::executor_type executor_type;
+
+    executor_type get_executor() {
+        return _socket.get_executor();
+    }
+#else
+    boost::asio::io_service &get_io_service() {
+        return _socket.get_io_service();
+    }
+#endif
+
+    template<typename MutableBufferSequence, typename ReadHandler>
+    void async_read_some(const MutableBufferSequence &buffers, ReadHandler &&handler) {
+        if (_tls_stream) {
+            _tls_stream->async_read_some(buffers, std::forward<ReadHandler>(handler));
+        } else {
+            _socket.async_read_some(buffers, std::forward<ReadHandler>(handler));
+        }
+    }
+
+    template<typename ConstBufferSequence, typename WriteHandler>
+    void async_write_some(const ConstBufferSequence &buffers, WriteHandler &&handler) {
+        if (_tls_stream) {
+            _tls_stream->async_write_some(buffers, std::forward<WriteHandler>(handler));
+        } else {
+            _socket.async_write_some(buffers, std::forward<WriteHandler>(handler));
+        }
+    }
+};
@@ -0,0 +1,99 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "domain_router.h"
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+DomainRouter::DomainRouter(const std::string &file)
+        : _file(file) {
+
+}
+
+bool DomainRouter::isEnabled() const {
+    return !_file.empty();
+}
+
+bool DomainRouter::reload() {
+    struct stat file_status;
+    if (_file.empty() || stat(_file.c_str(), &file_status) != 0 || file_status.st_mtime == _modification) {
+        return false;
+    }
+    std::ifstream file(_file);
+    if (!file) {
+        std::cerr << "can't read routes from " << _file << std::endl;
+        return false;
+    }
+
+    std::unordered_map<std::string, ndn::Name> routes;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream tokens(line.substr(0, line.find('#')));
+        std::string domain;
+        std::string prefix;
+        if (!(tokens >> domain >> prefix)) {
+            continue;
+        }
+        std::transform(domain.begin(), domain.end(), domain.begin(), ::tolower);
+        try {
+            routes[domain] = ndn::Name(prefix);
+        } catch (const std::exception &e) {
+            std::cerr << "invalid prefix " << prefix << " for " << domain << std::endl;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _routes.swap(routes);
+    _modification = file_status.st_mtime;
+    return true;
+}
+
+bool DomainRouter::route(const std::string &host, ndn::Name &prefix) {
+    std::string domain(host);
+    std::transform(domain.begin(), domain.end(), domain.begin(), ::tolower);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_routes.empty()) {
+        return false;
+    }
+    // the first suffix found is the longest one
+    size_t position = 0;
+    while (position != std::string::npos) {
+        auto it = _routes.find(domain.substr(position));
+        if (it != _routes.end()) {
+            prefix = it->second;
+            std::vector<std::string> labels;
+            std::istringstream remaining(domain.substr(0, position));
+            std::string label;
+            while (std::getline(remaining, label, '.')) {
+                labels.emplace_back(label);
+            }
+            auto labels_it = labels.rbegin();
+            while (labels_it != labels.rend()) {
+                prefix.append(*labels_it++);
+            }
+            return true;
+        }
+        position = domain.find('.', position);
+        if (position != std::string::npos) {
+            ++position;
+        }
+    }
+    return false;
+}
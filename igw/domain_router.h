@@ -0,0 +1,47 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <ndn-cxx/name.hpp>
+
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// maps domains to the NDN prefixes of the servers publishing them natively, the other domains go through the egw,
+// each line of the file is "<domain> <NDN prefix>", a domain also matches its subdomains
+class DomainRouter {
+private:
+    std::string _file;
+    time_t _modification {0};
+
+    std::mutex _mutex;
+    std::unordered_map<std::string, ndn::Name> _routes;
+
+public:
+    explicit DomainRouter(const std::string &file = "");
+
+    ~DomainRouter() = default;
+
+    bool isEnabled() const;
+
+    // loads the file again if it was modified since the last load, the table is kept if it can't be read
+    bool reload();
+
+    // prefix of the longest domain suffix of host in the table followed by the remaining labels of host,
+    // false if no domain of the table matches
+    bool route(const std::string &host, ndn::Name &prefix);
+};
@@ -0,0 +1,59 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "egw_ring.h"
+
+#include <set>
+
+#include "global.h"
+#include "sha1.h"
+
+void EgwRing::add(const ndn::Name &egw_prefix, size_t weight) {
+    for (size_t i = 0; i < weight * global::DEFAULT_EGW_RING_POINTS; ++i) {
+        _points.emplace(hash(egw_prefix.toUri() + "#" + std::to_string(i)), egw_prefix);
+    }
+}
+
+bool EgwRing::empty() const {
+    return _points.empty();
+}
+
+bool EgwRing::pick(const std::string &key, const std::function<bool(const std::string&)> &is_healthy, ndn::Name &egw_prefix) const {
+    if (_points.empty()) {
+        return false;
+    }
+    auto it = _points.lower_bound(hash(key));
+    std::set<std::string> tried;
+    for (size_t i = 0; i < _points.size(); ++i, ++it) {
+        if (it == _points.end()) {
+            it = _points.begin();
+        }
+        std::string uri = it->second.toUri();
+        if (!tried.insert(uri).second) {
+            continue;
+        }
+        if (tried.size() == 1) {
+            egw_prefix = it->second;
+        }
+        if (is_healthy(uri)) {
+            egw_prefix = it->second;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t EgwRing::hash(const std::string &value) {
+    // the first 64 bits of the SHA1, spread evenly even for close values
+    return std::stoull(SHA1{}(value).substr(0, 16), nullptr, 16);
+}
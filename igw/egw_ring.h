@@ -0,0 +1,46 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <ndn-cxx/name.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+
+// consistent hashing of requests over several egw instances, a request always goes to the same egw while it is healthy
+// and only the requests of an egw move when it is added, removed or failing
+class EgwRing {
+private:
+    // points of the ring owned by each egw, as many per unit of weight
+    std::map<uint64_t, ndn::Name> _points;
+
+public:
+    EgwRing() = default;
+
+    ~EgwRing() = default;
+
+    void add(const ndn::Name &egw_prefix, size_t weight = 1);
+
+    bool empty() const;
+
+    // egw owning the key, or the next healthy one after it on the ring, false if none is healthy
+    // in which case egw_prefix is the owner of the key
+    bool pick(const std::string &key, const std::function<bool(const std::string&)> &is_healthy, ndn::Name &egw_prefix) const;
+
+private:
+    static uint64_t hash(const std::string &value);
+};
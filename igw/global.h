@@ -24,4 +24,34 @@ namespace global {
     const boost::posix_time::seconds DEFAULT_TIMEOUT_READ_HTTP_HEADER {5};
     const boost::posix_time::seconds DEFAULT_TIMEOUT_READ_HTTP_BODY {2};
     const uint32_t DEFAULT_BUFFER_SIZE = 4096;
+    const boost::posix_time::milliseconds DEFAULT_WAIT_FLUSH {20};
+    const uint32_t TLV_SEGMENT_OFFSET = 128;
+    const uint32_t TLV_CHUNK_LIST = 129;
+    const std::string CHUNK_NAMESPACE = "_chunk";
+    const uint32_t TLV_BODY_DIGEST = 130;
+    const std::string BODY_NAMESPACE = "_body";
+    const uint32_t TLV_FEC = 131;
+    const uint32_t TLV_FEC_REPAIR = 132;
+    const std::string REPAIR_MARKER = "_repair";
+    const size_t DEFAULT_FEC_BLOCK_SIZE = 8;
+    const size_t DEFAULT_FEC_REPAIR_COUNT = 2;
+    const std::string CANCEL_MARKER = "cancel";
+    const std::string REFRESH_MARKER = "_refresh";
+    const std::string BATCH_MARKER = "_batch";
+    const boost::posix_time::milliseconds DEFAULT_BATCH_WINDOW {5};
+    const size_t DEFAULT_BATCH_MAX_REQUESTS = 32;
+    const size_t DEFAULT_BATCH_MAX_REQUEST_SIZE = 4096;
+    const boost::posix_time::seconds DEFAULT_WAIT_ROUTES_RELOAD {5};
+    const size_t DEFAULT_EGW_RING_POINTS = 100;
+    const size_t DEFAULT_BREAKER_THRESHOLD = 5;
+    const boost::posix_time::seconds DEFAULT_BREAKER_OPEN_TIME {10};
+    const boost::posix_time::milliseconds DEFAULT_OVERLOAD_MIN_BACKOFF {250};
+    const boost::posix_time::seconds DEFAULT_OVERLOAD_MAX_BACKOFF {8};
+    const boost::posix_time::seconds DEFAULT_TIMEOUT_TLS_HANDSHAKE {5};
+    const boost::posix_time::seconds DEFAULT_TLS_SESSION_TIMEOUT {300};
+    const long DEFAULT_TLS_SESSION_CACHE_SIZE = 20480;
+    const size_t DEFAULT_TLS_HANDSHAKE_CONCURRENCY = 2;
+    const uint32_t DEFAULT_HTTP2_MAX_CONCURRENT_STREAMS = 100;
+    const size_t DEFAULT_HTTP2_OUTPUT_BUFFER_SIZE = 65536;
+    const boost::posix_time::seconds DEFAULT_HTTP2_IDLE_TIMEOUT {60};
 };
@@ -0,0 +1,397 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "hpack.h"
+
+#include <memory>
+
+namespace {
+    // entry size overhead of RFC 7541 section 4.1
+    const size_t ENTRY_OVERHEAD = 32;
+
+    const std::pair<const char *, const char *> STATIC_TABLE[] {
+        {":authority", ""},
+        {":method", "GET"},
+        {":method", "POST"},
+        {":path", "/"},
+        {":path", "/index.html"},
+        {":scheme", "http"},
+        {":scheme", "https"},
+        {":status", "200"},
+        {":status", "204"},
+        {":status", "206"},
+        {":status", "304"},
+        {":status", "400"},
+        {":status", "404"},
+        {":status", "500"},
+        {"accept-charset", ""},
+        {"accept-encoding", "gzip, deflate"},
+        {"accept-language", ""},
+        {"accept-ranges", ""},
+        {"accept", ""},
+        {"access-control-allow-origin", ""},
+        {"age", ""},
+        {"allow", ""},
+        {"authorization", ""},
+        {"cache-control", ""},
+        {"content-disposition", ""},
+        {"content-encoding", ""},
+        {"content-language", ""},
+        {"content-length", ""},
+        {"content-location", ""},
+        {"content-range", ""},
+        {"content-type", ""},
+        {"cookie", ""},
+        {"date", ""},
+        {"etag", ""},
+        {"expect", ""},
+        {"expires", ""},
+        {"from", ""},
+        {"host", ""},
+        {"if-match", ""},
+        {"if-modified-since", ""},
+        {"if-none-match", ""},
+        {"if-range", ""},
+        {"if-unmodified-since", ""},
+        {"last-modified", ""},
+        {"link", ""},
+        {"location", ""},
+        {"max-forwards", ""},
+        {"proxy-authenticate", ""},
+        {"proxy-authorization", ""},
+        {"range", ""},
+        {"referer", ""},
+        {"refresh", ""},
+        {"retry-after", ""},
+        {"server", ""},
+        {"set-cookie", ""},
+        {"strict-transport-security", ""},
+        {"transfer-encoding", ""},
+        {"user-agent", ""},
+        {"vary", ""},
+        {"via", ""},
+        {"www-authenticate", ""}
+    };
+
+    const size_t STATIC_TABLE_SIZE = sizeof(STATIC_TABLE) / sizeof(STATIC_TABLE[0]);
+
+    // Huffman code of RFC 7541 appendix B, EOS excluded
+    const uint32_t HUFFMAN_CODES[256] {
+        0x1ff8, 0x7fffd8, 0xfffffe2, 0xfffffe3, 0xfffffe4, 0xfffffe5, 0xfffffe6, 0xfffffe7,
+        0xfffffe8, 0xffffea, 0x3ffffffc, 0xfffffe9, 0xfffffea, 0x3ffffffd, 0xfffffeb, 0xfffffec,
+        0xfffffed, 0xfffffee, 0xfffffef, 0xffffff0, 0xffffff1, 0xffffff2, 0x3ffffffe, 0xffffff3,
+        0xffffff4, 0xffffff5, 0xffffff6, 0xffffff7, 0xffffff8, 0xffffff9, 0xffffffa, 0xffffffb,
+        0x14, 0x3f8, 0x3f9, 0xffa, 0x1ff9, 0x15, 0xf8, 0x7fa,
+        0x3fa, 0x3fb, 0xf9, 0x7fb, 0xfa, 0x16, 0x17, 0x18,
+        0x0, 0x1, 0x2, 0x19, 0x1a, 0x1b, 0x1c, 0x1d,
+        0x1e, 0x1f, 0x5c, 0xfb, 0x7ffc, 0x20, 0xffb, 0x3fc,
+        0x1ffa, 0x21, 0x5d, 0x5e, 0x5f, 0x60, 0x61, 0x62,
+        0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a,
+        0x6b, 0x6c, 0x6d, 0x6e, 0x6f, 0x70, 0x71, 0x72,
+        0xfc, 0x73, 0xfd, 0x1ffb, 0x7fff0, 0x1ffc, 0x3ffc, 0x22,
+        0x7ffd, 0x3, 0x23, 0x4, 0x24, 0x5, 0x25, 0x26,
+        0x27, 0x6, 0x74, 0x75, 0x28, 0x29, 0x2a, 0x7,
+        0x2b, 0x76, 0x2c, 0x8, 0x9, 0x2d, 0x77, 0x78,
+        0x79, 0x7a, 0x7b, 0x7ffe, 0x7fc, 0x3ffd, 0x1ffd, 0xffffffc,
+        0xfffe6, 0x3fffd2, 0xfffe7, 0xfffe8, 0x3fffd3, 0x3fffd4, 0x3fffd5, 0x7fffd9,
+        0x3fffd6, 0x7fffda, 0x7fffdb, 0x7fffdc, 0x7fffdd, 0x7fffde, 0xffffeb, 0x7fffdf,
+        0xffffec, 0xffffed, 0x3fffd7, 0x7fffe0, 0xffffee, 0x7fffe1, 0x7fffe2, 0x7fffe3,
+        0x7fffe4, 0x1fffdc, 0x3fffd8, 0x7fffe5, 0x3fffd9, 0x7fffe6, 0x7fffe7, 0xffffef,
+        0x3fffda, 0x1fffdd, 0xfffe9, 0x3fffdb, 0x3fffdc, 0x7fffe8, 0x7fffe9, 0x1fffde,
+        0x7fffea, 0x3fffdd, 0x3fffde, 0xfffff0, 0x1fffdf, 0x3fffdf, 0x7fffeb, 0x7fffec,
+        0x1fffe0, 0x1fffe1, 0x3fffe0, 0x1fffe2, 0x7fffed, 0x3fffe1, 0x7fffee, 0x7fffef,
+        0xfffea, 0x3fffe2, 0x3fffe3, 0x3fffe4, 0x7ffff0, 0x3fffe5, 0x3fffe6, 0x7ffff1,
+        0x3ffffe0, 0x3ffffe1, 0xfffeb, 0x7fff1, 0x3fffe7, 0x7ffff2, 0x3fffe8, 0x1ffffec,
+        0x3ffffe2, 0x3ffffe3, 0x3ffffe4, 0x7ffffde, 0x7ffffdf, 0x3ffffe5, 0xfffff1, 0x1ffffed,
+        0x7fff2, 0x1fffe3, 0x3ffffe6, 0x7ffffe0, 0x7ffffe1, 0x3ffffe7, 0x7ffffe2, 0xfffff2,
+        0x1fffe4, 0x1fffe5, 0x3ffffe8, 0x3ffffe9, 0xffffffd, 0x7ffffe3, 0x7ffffe4, 0x7ffffe5,
+        0xfffec, 0xfffff3, 0xfffed, 0x1fffe6, 0x3fffe9, 0x1fffe7, 0x1fffe8, 0x7ffff3,
+        0x3fffea, 0x3fffeb, 0x1ffffee, 0x1ffffef, 0xfffff4, 0xfffff5, 0x3ffffea, 0x7ffff4,
+        0x3ffffeb, 0x7ffffe6, 0x3ffffec, 0x3ffffed, 0x7ffffe7, 0x7ffffe8, 0x7ffffe9, 0x7ffffea,
+        0x7ffffeb, 0xffffffe, 0x7ffffec, 0x7ffffed, 0x7ffffee, 0x7ffffef, 0x7fffff0, 0x3ffffee
+    };
+
+    const uint8_t HUFFMAN_CODE_LENGTHS[256] {
+        13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+        28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+        6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+        5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+        13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+        7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+        15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+        6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+        20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+        24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+        22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+        21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+        26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+        19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+        20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+        26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26
+    };
+
+    // binary tree of the Huffman code, children of node i are at 2 * i and 2 * i + 1 of a flat array
+    struct HuffmanTree {
+        // left, right children or -1, symbol of a leaf or -1
+        std::vector<int> children;
+        std::vector<int> symbols;
+
+        HuffmanTree() : children(2, -1), symbols(1, -1) {
+            for (int symbol = 0; symbol < 256; ++symbol) {
+                size_t node = 0;
+                for (int bit = HUFFMAN_CODE_LENGTHS[symbol] - 1; bit >= 0; --bit) {
+                    size_t child = 2 * node + ((HUFFMAN_CODES[symbol] >> bit) & 1);
+                    if (children[child] < 0) {
+                        children[child] = static_cast<int>(symbols.size());
+                        symbols.push_back(-1);
+                        children.push_back(-1);
+                        children.push_back(-1);
+                    }
+                    node = static_cast<size_t>(children[child]);
+                }
+                symbols[node] = symbol;
+            }
+        }
+    };
+
+    const HuffmanTree &huffman_tree() {
+        static const HuffmanTree tree;
+        return tree;
+    }
+}
+
+HpackDecoder::HpackDecoder(size_t settings_max_size)
+        : _size(0)
+        , _max_size(settings_max_size)
+        , _settings_max_size(settings_max_size) {
+
+}
+
+bool HpackDecoder::decode(const std::string &block, HeaderList &headers) {
+    size_t pos = 0;
+    bool header_seen = false;
+    while (pos < block.size()) {
+        uint8_t byte = static_cast<uint8_t>(block[pos]);
+        size_t index;
+        std::pair<std::string, std::string> entry;
+        if (byte & 0x80) {
+            // indexed header field
+            if (!decodeInteger(block, pos, 7, index) || index == 0 || !lookup(index, entry)) {
+                return false;
+            }
+            headers.emplace_back(std::move(entry));
+            header_seen = true;
+        } else if ((byte & 0xe0) == 0x20) {
+            // dynamic table size update, only allowed at the beginning of a block
+            if (header_seen || !decodeInteger(block, pos, 5, index) || index > _settings_max_size) {
+                return false;
+            }
+            _max_size = index;
+            evict(_max_size);
+        } else {
+            // literal header field, with incremental indexing, without indexing or never indexed
+            bool indexing = (byte & 0xc0) == 0x40;
+            if (!decodeInteger(block, pos, indexing ? 6 : 4, index)) {
+                return false;
+            }
+            if (index > 0) {
+                if (!lookup(index, entry)) {
+                    return false;
+                }
+            } else if (!decodeString(block, pos, entry.first)) {
+                return false;
+            }
+            if (!decodeString(block, pos, entry.second)) {
+                return false;
+            }
+            if (indexing) {
+                insert(entry.first, entry.second);
+            }
+            headers.emplace_back(std::move(entry));
+            header_seen = true;
+        }
+    }
+    return true;
+}
+
+bool HpackDecoder::lookup(size_t index, std::pair<std::string, std::string> &entry) const {
+    if (index <= STATIC_TABLE_SIZE) {
+        entry.first = STATIC_TABLE[index - 1].first;
+        entry.second = STATIC_TABLE[index - 1].second;
+        return true;
+    } else if (index - STATIC_TABLE_SIZE <= _dynamic_table.size()) {
+        entry = _dynamic_table[index - STATIC_TABLE_SIZE - 1];
+        return true;
+    }
+    return false;
+}
+
+void HpackDecoder::insert(const std::string &name, const std::string &value) {
+    size_t entry_size = name.size() + value.size() + ENTRY_OVERHEAD;
+    // an entry larger than the table empties it without being added
+    evict(entry_size <= _max_size ? _max_size - entry_size : 0);
+    if (entry_size <= _max_size) {
+        _dynamic_table.emplace_front(name, value);
+        _size += entry_size;
+    }
+}
+
+void HpackDecoder::evict(size_t max_size) {
+    while (_size > max_size && !_dynamic_table.empty()) {
+        _size -= _dynamic_table.back().first.size() + _dynamic_table.back().second.size() + ENTRY_OVERHEAD;
+        _dynamic_table.pop_back();
+    }
+}
+
+bool HpackDecoder::decodeInteger(const std::string &block, size_t &pos, uint8_t prefix_bits, size_t &value) {
+    if (pos >= block.size()) {
+        return false;
+    }
+    uint8_t max_prefix = static_cast<uint8_t>((1 << prefix_bits) - 1);
+    value = static_cast<uint8_t>(block[pos++]) & max_prefix;
+    if (value < max_prefix) {
+        return true;
+    }
+    // larger values are not needed by any sane peer, they would only overflow
+    for (unsigned int shift = 0; pos < block.size() && shift <= 28; shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(block[pos++]);
+        value += static_cast<size_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool HpackDecoder::decodeString(const std::string &block, size_t &pos, std::string &value) {
+    if (pos >= block.size()) {
+        return false;
+    }
+    bool huffman = (static_cast<uint8_t>(block[pos]) & 0x80) != 0;
+    size_t length;
+    if (!decodeInteger(block, pos, 7, length) || length > block.size() - pos) {
+        return false;
+    }
+    if (huffman) {
+        value.clear();
+        if (!decodeHuffman(block, pos, length, value)) {
+            return false;
+        }
+    } else {
+        value.assign(block, pos, length);
+    }
+    pos += length;
+    return true;
+}
+
+bool HpackDecoder::decodeHuffman(const std::string &block, size_t pos, size_t length, std::string &value) {
+    const HuffmanTree &tree = huffman_tree();
+    size_t node = 0;
+    // padding must be the most significant bits of EOS, so only ones and shorter than a byte
+    unsigned int padding_bits = 0;
+    bool padding_ones = true;
+    for (size_t i = pos; i < pos + length; ++i) {
+        uint8_t byte = static_cast<uint8_t>(block[i]);
+        for (int bit = 7; bit >= 0; --bit) {
+            unsigned int b = (byte >> bit) & 1;
+            int child = tree.children[2 * node + b];
+            if (child < 0) {
+                // only EOS is missing from the tree, it must not appear in a string
+                return false;
+            }
+            node = static_cast<size_t>(child);
+            ++padding_bits;
+            padding_ones = padding_ones && b;
+            if (tree.symbols[node] >= 0) {
+                value.push_back(static_cast<char>(tree.symbols[node]));
+                node = 0;
+                padding_bits = 0;
+                padding_ones = true;
+            }
+        }
+    }
+    return padding_bits < 8 && padding_ones;
+}
+
+std::string HpackEncoder::encode(const HeaderList &headers) {
+    std::string block;
+    for (const auto &header : headers) {
+        size_t name_index = 0;
+        size_t index = 0;
+        for (size_t i = 0; i < STATIC_TABLE_SIZE && index == 0; ++i) {
+            if (header.first == STATIC_TABLE[i].first) {
+                if (header.second == STATIC_TABLE[i].second) {
+                    index = i + 1;
+                } else if (name_index == 0) {
+                    name_index = i + 1;
+                }
+            }
+        }
+        if (index > 0) {
+            encodeInteger(block, 0x80, 7, index);
+        } else {
+            // literal header field without indexing
+            encodeInteger(block, 0x00, 4, name_index);
+            if (name_index == 0) {
+                encodeString(block, header.first);
+            }
+            encodeString(block, header.second);
+        }
+    }
+    return block;
+}
+
+void HpackEncoder::encodeInteger(std::string &block, uint8_t first_byte, uint8_t prefix_bits, size_t value) {
+    size_t max_prefix = (1u << prefix_bits) - 1;
+    if (value < max_prefix) {
+        block.push_back(static_cast<char>(first_byte | value));
+        return;
+    }
+    block.push_back(static_cast<char>(first_byte | max_prefix));
+    value -= max_prefix;
+    while (value >= 0x80) {
+        block.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    block.push_back(static_cast<char>(value));
+}
+
+void HpackEncoder::encodeString(std::string &block, const std::string &value) {
+    size_t bits = 0;
+    for (unsigned char c : value) {
+        bits += HUFFMAN_CODE_LENGTHS[c];
+    }
+    size_t huffman_length = (bits + 7) / 8;
+    if (huffman_length >= value.size()) {
+        encodeInteger(block, 0x00, 7, value.size());
+        block += value;
+        return;
+    }
+
+    encodeInteger(block, 0x80, 7, huffman_length);
+    uint64_t buffer = 0;
+    unsigned int buffered_bits = 0;
+    for (unsigned char c : value) {
+        buffer = (buffer << HUFFMAN_CODE_LENGTHS[c]) | HUFFMAN_CODES[c];
+        buffered_bits += HUFFMAN_CODE_LENGTHS[c];
+        while (buffered_bits >= 8) {
+            buffered_bits -= 8;
+            block.push_back(static_cast<char>(buffer >> buffered_bits));
+        }
+    }
+    if (buffered_bits > 0) {
+        // padded with the most significant bits of EOS
+        block.push_back(static_cast<char>((buffer << (8 - buffered_bits)) | (0xff >> buffered_bits)));
+    }
+}
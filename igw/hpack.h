@@ -0,0 +1,69 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+typedef std::vector<std::pair<std::string, std::string>> HeaderList;
+
+// HPACK decoder of HTTP/2 header blocks (RFC 7541), one per connection since its dynamic table is shared by all streams
+class HpackDecoder {
+private:
+    std::deque<std::pair<std::string, std::string>> _dynamic_table;
+    size_t _size;
+    size_t _max_size;
+    // limit given to the peer in SETTINGS_HEADER_TABLE_SIZE, table size updates can't exceed it
+    size_t _settings_max_size;
+
+public:
+    explicit HpackDecoder(size_t settings_max_size = 4096);
+
+    ~HpackDecoder() = default;
+
+    // decodes a complete header block, returns false on a compression error which is fatal to the connection
+    bool decode(const std::string &block, HeaderList &headers);
+
+private:
+    bool lookup(size_t index, std::pair<std::string, std::string> &entry) const;
+
+    void insert(const std::string &name, const std::string &value);
+
+    void evict(size_t max_size);
+
+    static bool decodeInteger(const std::string &block, size_t &pos, uint8_t prefix_bits, size_t &value);
+
+    static bool decodeString(const std::string &block, size_t &pos, std::string &value);
+
+    static bool decodeHuffman(const std::string &block, size_t pos, size_t length, std::string &value);
+};
+
+// HPACK encoder, it never inserts into the dynamic table of the peer so its size limit doesn't matter
+class HpackEncoder {
+public:
+    HpackEncoder() = default;
+
+    ~HpackEncoder() = default;
+
+    std::string encode(const HeaderList &headers);
+
+private:
+    static void encodeInteger(std::string &block, uint8_t first_byte, uint8_t prefix_bits, size_t value);
+
+    static void encodeString(std::string &block, const std::string &value);
+};
@@ -0,0 +1,871 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "http_server.h"
+
+#include <boost/bind.hpp>
+
+#include <iostream>
+#include <algorithm>
+
+namespace {
+    const std::string CONNECTION_PREFACE("PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n");
+    const size_t FRAME_HEADER_SIZE = 9;
+    const size_t DEFAULT_MAX_FRAME_SIZE = 16384;
+    const long DEFAULT_WINDOW_SIZE = 65535;
+    const long MAX_WINDOW_SIZE = 0x7fffffff;
+    const uint32_t HEADER_TABLE_SIZE = 4096;
+
+    enum frame_type : uint8_t {
+        DATA = 0x0,
+        HEADERS = 0x1,
+        PRIORITY = 0x2,
+        RST_STREAM = 0x3,
+        SETTINGS = 0x4,
+        PUSH_PROMISE = 0x5,
+        PING = 0x6,
+        GOAWAY = 0x7,
+        WINDOW_UPDATE = 0x8,
+        CONTINUATION = 0x9
+    };
+
+    enum frame_flag : uint8_t {
+        END_STREAM = 0x1,
+        ACK = 0x1,
+        END_HEADERS = 0x4,
+        PADDED = 0x8,
+        PRIORITY_FLAG = 0x20
+    };
+
+    enum settings_id : uint16_t {
+        SETTINGS_HEADER_TABLE_SIZE = 0x1,
+        SETTINGS_ENABLE_PUSH = 0x2,
+        SETTINGS_MAX_CONCURRENT_STREAMS = 0x3,
+        SETTINGS_INITIAL_WINDOW_SIZE = 0x4,
+        SETTINGS_MAX_FRAME_SIZE = 0x5
+    };
+
+    enum h2_error : uint32_t {
+        NO_ERROR = 0x0,
+        PROTOCOL_ERROR = 0x1,
+        INTERNAL_ERROR = 0x2,
+        FLOW_CONTROL_ERROR = 0x3,
+        FRAME_SIZE_ERROR = 0x6,
+        REFUSED_STREAM = 0x7,
+        COMPRESSION_ERROR = 0x9
+    };
+
+    uint32_t read_uint32(const char *data) {
+        return (static_cast<uint32_t>(static_cast<uint8_t>(data[0])) << 24) | (static_cast<uint32_t>(static_cast<uint8_t>(data[1])) << 16) |
+               (static_cast<uint32_t>(static_cast<uint8_t>(data[2])) << 8) | static_cast<uint32_t>(static_cast<uint8_t>(data[3]));
+    }
+
+    void append_uint32(std::string &data, uint32_t value) {
+        data.push_back(static_cast<char>(value >> 24));
+        data.push_back(static_cast<char>(value >> 16));
+        data.push_back(static_cast<char>(value >> 8));
+        data.push_back(static_cast<char>(value));
+    }
+
+    void append_setting(std::string &data, uint16_t id, uint32_t value) {
+        data.push_back(static_cast<char>(id >> 8));
+        data.push_back(static_cast<char>(id));
+        append_uint32(data, value);
+    }
+
+    // the HTTP2-Settings field of an upgrade is a SETTINGS payload in base64url
+    std::string decode_base64url(const std::string &input) {
+        std::string output;
+        uint32_t buffer = 0;
+        int buffered_bits = 0;
+        for (char c : input) {
+            int value;
+            if (c >= 'A' && c <= 'Z') {
+                value = c - 'A';
+            } else if (c >= 'a' && c <= 'z') {
+                value = c - 'a' + 26;
+            } else if (c >= '0' && c <= '9') {
+                value = c - '0' + 52;
+            } else if (c == '-' || c == '+') {
+                value = 62;
+            } else if (c == '_' || c == '/') {
+                value = 63;
+            } else {
+                continue;
+            }
+            buffer = (buffer << 6) | static_cast<uint32_t>(value);
+            buffered_bits += 6;
+            if (buffered_bits >= 8) {
+                buffered_bits -= 8;
+                output.push_back(static_cast<char>(buffer >> buffered_bits));
+            }
+        }
+        return output;
+    }
+
+    bool is_connection_specific(const std::string &name) {
+        return name == "connection" || name == "keep-alive" || name == "proxy-connection" || name == "transfer-encoding" ||
+               name == "upgrade";
+    }
+}
+
+#ifndef NDEBUG
+std::atomic<size_t> HttpServer::Http2Session::count {0};
+#endif
+
+HttpServer::Http2Session::Http2Session(HttpServer &http_server, ClientStream &&stream, const std::string &received)
+        : _http_server(http_server)
+        , _strand(http_server._ios)
+        , _send_timer(http_server._ios)
+        , _idle_timer(http_server._ios)
+        , _stream(std::move(stream))
+        , _input(received)
+        , _hpack_decoder(HEADER_TABLE_SIZE)
+        , _send_window(DEFAULT_WINDOW_SIZE)
+        , _initial_window_size(DEFAULT_WINDOW_SIZE)
+        , _max_frame_size(DEFAULT_MAX_FRAME_SIZE) {
+#ifndef NDEBUG
+    std::cout << "new HTTP/2 session (" << ++count << " active HTTP/2 session(s))" << std::endl;
+#endif
+}
+
+HttpServer::Http2Session::~Http2Session() {
+#ifndef NDEBUG
+    std::cout << "HTTP/2 session destroyed (" << --count << " remaining HTTP/2 session(s))" << std::endl;
+#endif
+}
+
+void HttpServer::Http2Session::start() {
+    std::string settings;
+    append_setting(settings, SETTINGS_MAX_CONCURRENT_STREAMS, global::DEFAULT_HTTP2_MAX_CONCURRENT_STREAMS);
+    send_frame(SETTINGS, 0, 0, settings);
+    flush();
+
+    _idle_timer.expires_from_now(global::DEFAULT_HTTP2_IDLE_TIMEOUT);
+    _idle_timer.async_wait(_strand.wrap(boost::bind(&Http2Session::idle_timer_handler, shared_from_this(), _1)));
+    if (process_frames()) {
+        read();
+    }
+}
+
+void HttpServer::Http2Session::start(const std::shared_ptr<HttpRequest> &http_request, const std::string &http2_settings) {
+    // the 101 response acknowledges the settings of the upgrade
+    apply_settings(decode_base64url(http2_settings));
+    _last_stream_id = 1;
+    open_stream(1, http_request);
+    http_request->getRawStream()->is_completed(true);
+    start();
+}
+
+void HttpServer::Http2Session::setHttpResponse(const std::shared_ptr<HttpRequest> &http_request, const std::shared_ptr<HttpResponse> &http_response) {
+    _strand.post(boost::bind(&Http2Session::attach_response, shared_from_this(), http_request, http_response));
+}
+
+void HttpServer::Http2Session::read() {
+    _stream.async_read_some(boost::asio::buffer(_read_buffer, global::DEFAULT_BUFFER_SIZE),
+                            _strand.wrap(boost::bind(&Http2Session::read_handler, shared_from_this(), _1, _2)));
+}
+
+void HttpServer::Http2Session::read_handler(const boost::system::error_code &err, size_t bytes_transferred) {
+    if (!err && !_closed) {
+        _input.append(_read_buffer, bytes_transferred);
+        _idle_timer.expires_from_now(global::DEFAULT_HTTP2_IDLE_TIMEOUT);
+        _idle_timer.async_wait(_strand.wrap(boost::bind(&Http2Session::idle_timer_handler, shared_from_this(), _1)));
+        if (process_frames()) {
+            read();
+        }
+    } else {
+        close();
+    }
+}
+
+void HttpServer::Http2Session::idle_timer_handler(const boost::system::error_code &err) {
+    if (err || _closed) {
+        return;
+    } else if (_streams.empty()) {
+        std::string payload;
+        append_uint32(payload, _last_stream_id);
+        append_uint32(payload, NO_ERROR);
+        send_frame(GOAWAY, 0, 0, payload);
+        _closing = true;
+        flush();
+    } else {
+        _idle_timer.expires_from_now(global::DEFAULT_HTTP2_IDLE_TIMEOUT);
+        _idle_timer.async_wait(_strand.wrap(boost::bind(&Http2Session::idle_timer_handler, shared_from_this(), _1)));
+    }
+}
+
+bool HttpServer::Http2Session::process_frames() {
+    if (!_preface_received) {
+        size_t size = std::min(_input.size(), CONNECTION_PREFACE.size());
+        if (_input.compare(0, size, CONNECTION_PREFACE, 0, size) != 0) {
+            std::cerr << "invalid HTTP/2 connection preface" << std::endl;
+            close();
+            return false;
+        } else if (size < CONNECTION_PREFACE.size()) {
+            return true;
+        }
+        _input.erase(0, CONNECTION_PREFACE.size());
+        _preface_received = true;
+    }
+
+    size_t pos = 0;
+    uint32_t error = NO_ERROR;
+    while (error == NO_ERROR && _input.size() - pos >= FRAME_HEADER_SIZE) {
+        const char *header = _input.data() + pos;
+        size_t length = (static_cast<size_t>(static_cast<uint8_t>(header[0])) << 16) |
+                        (static_cast<size_t>(static_cast<uint8_t>(header[1])) << 8) | static_cast<uint8_t>(header[2]);
+        auto type = static_cast<uint8_t>(header[3]);
+        auto flags = static_cast<uint8_t>(header[4]);
+        uint32_t stream_id = read_uint32(header + 5) & 0x7fffffff;
+        if (length > DEFAULT_MAX_FRAME_SIZE) {
+            error = FRAME_SIZE_ERROR;
+            break;
+        } else if (_input.size() - pos - FRAME_HEADER_SIZE < length) {
+            break;
+        }
+        std::string payload = _input.substr(pos + FRAME_HEADER_SIZE, length);
+        pos += FRAME_HEADER_SIZE + length;
+
+        // a header block can't be interleaved with any other frame
+        if (_continuation_stream_id != 0 && (type != CONTINUATION || stream_id != _continuation_stream_id)) {
+            error = PROTOCOL_ERROR;
+            break;
+        }
+        switch (type) {
+            case DATA:
+                error = process_data(stream_id, flags, payload);
+                break;
+            case HEADERS:
+                error = process_headers(stream_id, flags, payload);
+                break;
+            case PRIORITY:
+                if (stream_id == 0 || length != 5) {
+                    error = PROTOCOL_ERROR;
+                } else {
+                    process_priority(stream_id, payload.data());
+                }
+                break;
+            case RST_STREAM:
+                if (stream_id == 0 || length != 4) {
+                    error = PROTOCOL_ERROR;
+                } else {
+                    close_stream(stream_id, NO_ERROR);
+                }
+                break;
+            case SETTINGS:
+                error = stream_id == 0 ? process_settings(flags, payload) : PROTOCOL_ERROR;
+                break;
+            case PING:
+                if (stream_id != 0 || length != 8) {
+                    error = PROTOCOL_ERROR;
+                } else if (!(flags & ACK)) {
+                    send_frame(PING, ACK, 0, payload);
+                }
+                break;
+            case GOAWAY:
+                // the streams already opened are still served
+                _goaway_received = true;
+                break;
+            case WINDOW_UPDATE:
+                error = process_window_update(stream_id, payload);
+                break;
+            case CONTINUATION:
+                if (_continuation_stream_id == 0) {
+                    error = PROTOCOL_ERROR;
+                } else {
+                    _header_block += payload;
+                    if (flags & END_HEADERS) {
+                        error = process_header_block(stream_id, _continuation_flags);
+                    }
+                }
+                break;
+            case PUSH_PROMISE:
+                error = PROTOCOL_ERROR;
+                break;
+            default:
+                // unknown frame types must be ignored
+                break;
+        }
+    }
+    _input.erase(0, pos);
+
+    if (error != NO_ERROR) {
+        connection_error(error);
+        return false;
+    }
+    if (_goaway_received && _streams.empty()) {
+        _closing = true;
+    }
+    send_responses();
+    flush();
+    return true;
+}
+
+uint32_t HttpServer::Http2Session::process_headers(uint32_t stream_id, uint8_t flags, const std::string &payload) {
+    if (stream_id == 0) {
+        return PROTOCOL_ERROR;
+    }
+    size_t pos = 0;
+    size_t padding = 0;
+    if (flags & PADDED) {
+        if (payload.empty()) {
+            return PROTOCOL_ERROR;
+        }
+        padding = static_cast<uint8_t>(payload[0]);
+        pos = 1;
+    }
+    if (flags & PRIORITY_FLAG) {
+        if (payload.size() < pos + 5) {
+            return PROTOCOL_ERROR;
+        }
+        _header_priority = payload.substr(pos, 5);
+        pos += 5;
+    }
+    if (pos + padding > payload.size()) {
+        return PROTOCOL_ERROR;
+    }
+
+    _header_block = payload.substr(pos, payload.size() - pos - padding);
+    _continuation_flags = flags;
+    if (flags & END_HEADERS) {
+        return process_header_block(stream_id, flags);
+    }
+    _continuation_stream_id = stream_id;
+    return NO_ERROR;
+}
+
+uint32_t HttpServer::Http2Session::process_header_block(uint32_t stream_id, uint8_t flags) {
+    _continuation_stream_id = 0;
+    std::string priority;
+    priority.swap(_header_priority);
+    HeaderList headers;
+    // the block must be decoded even for an ignored stream, the dynamic table is shared with the next ones
+    if (!_hpack_decoder.decode(_header_block, headers)) {
+        return COMPRESSION_ERROR;
+    }
+    _header_block.clear();
+
+    auto it = _streams.find(stream_id);
+    if (it != _streams.end()) {
+        // trailers of the request body, they are not given to the sink
+        if (flags & END_STREAM) {
+            if (it->second.chunked_request) {
+                it->second.http_request->getRawStream()->append_raw_data("0\r\n\r\n");
+            }
+            it->second.http_request->getRawStream()->is_completed(true);
+        }
+        return NO_ERROR;
+    } else if (stream_id % 2 == 0 || stream_id <= _last_stream_id) {
+        return PROTOCOL_ERROR;
+    }
+    _last_stream_id = stream_id;
+    if (_goaway_received || _closing) {
+        return NO_ERROR;
+    } else if (_streams.size() >= global::DEFAULT_HTTP2_MAX_CONCURRENT_STREAMS) {
+        std::string payload;
+        append_uint32(payload, REFUSED_STREAM);
+        send_frame(RST_STREAM, 0, stream_id, payload);
+        return NO_ERROR;
+    }
+
+    auto http_request = std::make_shared<HttpRequest>();
+    std::string path;
+    std::string authority;
+    std::string cookie;
+    bool valid = true;
+    for (const auto &header : headers) {
+        if (header.first.empty() || std::any_of(header.first.begin(), header.first.end(), ::isupper)) {
+            valid = false;
+        } else if (header.first == ":method") {
+            http_request->set_method(header.second);
+        } else if (header.first == ":path") {
+            path = header.second;
+        } else if (header.first == ":authority") {
+            authority = header.second;
+        } else if (header.first[0] == ':') {
+            // :scheme is implied by the connection
+            valid = valid && header.first == ":scheme";
+        } else if (header.first == "cookie") {
+            // cookies may be split in several fields to be compressed better
+            cookie += (cookie.empty() ? "" : "; ") + header.second;
+        } else if (is_connection_specific(header.first)) {
+            valid = false;
+        } else if (header.first != "te") {
+            std::string value = http_request->get_field(header.first);
+            http_request->set_field(header.first, value.empty() ? header.second : value + ", " + header.second);
+        }
+    }
+    if (!cookie.empty()) {
+        http_request->set_field("cookie", cookie);
+    }
+    if (!authority.empty() && http_request->get_field("host").empty()) {
+        http_request->set_field("host", authority);
+    }
+    if (_stream.isSecure()) {
+        http_request->set_field("x-forwarded-proto", "https");
+    }
+    // the NDN side only speaks HTTP/1.1
+    http_request->set_version("HTTP/1.1");
+
+    if (!valid || path.empty() || !HttpServer::parse_url(path, http_request) || !http_request->has_minimal_requirements()) {
+        std::string payload;
+        append_uint32(payload, PROTOCOL_ERROR);
+        send_frame(RST_STREAM, 0, stream_id, payload);
+        return NO_ERROR;
+    }
+    if (!(flags & END_STREAM) && http_request->get_field("content-length").empty()) {
+        http_request->set_field("transfer-encoding", "chunked");
+    }
+
+    open_stream(stream_id, http_request);
+    Stream &stream = _streams[stream_id];
+    stream.chunked_request = !http_request->get_field("transfer-encoding").empty();
+    if (!priority.empty()) {
+        process_priority(stream_id, priority.data());
+    }
+    if (flags & END_STREAM) {
+        http_request->getRawStream()->is_completed(true);
+    }
+    return NO_ERROR;
+}
+
+uint32_t HttpServer::Http2Session::process_data(uint32_t stream_id, uint8_t flags, const std::string &payload) {
+    if (stream_id == 0) {
+        return PROTOCOL_ERROR;
+    }
+    // the whole payload counts for flow control, the window is given back as soon as it is received
+    if (!payload.empty()) {
+        std::string increment;
+        append_uint32(increment, static_cast<uint32_t>(payload.size()));
+        send_frame(WINDOW_UPDATE, 0, 0, increment);
+    }
+
+    auto it = _streams.find(stream_id);
+    if (it == _streams.end()) {
+        return stream_id > _last_stream_id ? PROTOCOL_ERROR : NO_ERROR;
+    }
+    size_t pos = 0;
+    size_t padding = 0;
+    if (flags & PADDED) {
+        if (payload.empty() || static_cast<uint8_t>(payload[0]) >= payload.size()) {
+            return PROTOCOL_ERROR;
+        }
+        padding = static_cast<uint8_t>(payload[0]);
+        pos = 1;
+    }
+
+    Stream &stream = it->second;
+    auto raw_stream = stream.http_request->getRawStream();
+    std::string data = payload.substr(pos, payload.size() - pos - padding);
+    if (!data.empty()) {
+        raw_stream->append_raw_data(stream.chunked_request ? make_chunk(data) : data);
+    }
+    if (flags & END_STREAM) {
+        if (stream.chunked_request) {
+            raw_stream->append_raw_data("0\r\n\r\n");
+        }
+        raw_stream->is_completed(true);
+    } else if (!payload.empty()) {
+        std::string increment;
+        append_uint32(increment, static_cast<uint32_t>(payload.size()));
+        send_frame(WINDOW_UPDATE, 0, stream_id, increment);
+    }
+    return NO_ERROR;
+}
+
+uint32_t HttpServer::Http2Session::process_settings(uint8_t flags, const std::string &payload) {
+    if (flags & ACK) {
+        return payload.empty() ? NO_ERROR : FRAME_SIZE_ERROR;
+    }
+    uint32_t error = apply_settings(payload);
+    if (error == NO_ERROR) {
+        send_frame(SETTINGS, ACK, 0, std::string());
+    }
+    return error;
+}
+
+uint32_t HttpServer::Http2Session::apply_settings(const std::string &payload) {
+    if (payload.size() % 6 != 0) {
+        return FRAME_SIZE_ERROR;
+    }
+    for (size_t pos = 0; pos < payload.size(); pos += 6) {
+        auto id = static_cast<uint16_t>((static_cast<uint8_t>(payload[pos]) << 8) | static_cast<uint8_t>(payload[pos + 1]));
+        uint32_t value = read_uint32(payload.data() + pos + 2);
+        switch (id) {
+            case SETTINGS_ENABLE_PUSH:
+                if (value > 1) {
+                    return PROTOCOL_ERROR;
+                }
+                break;
+            case SETTINGS_INITIAL_WINDOW_SIZE:
+                if (value > MAX_WINDOW_SIZE) {
+                    return FLOW_CONTROL_ERROR;
+                }
+                // applies to the streams already opened as well
+                for (auto &entry : _streams) {
+                    entry.second.send_window += static_cast<long>(value) - _initial_window_size;
+                }
+                _initial_window_size = value;
+                break;
+            case SETTINGS_MAX_FRAME_SIZE:
+                if (value < DEFAULT_MAX_FRAME_SIZE || value > 0xffffff) {
+                    return PROTOCOL_ERROR;
+                }
+                _max_frame_size = value;
+                break;
+            default:
+                // the encoder never indexes, the size of the dynamic table of the peer doesn't matter
+                break;
+        }
+    }
+    return NO_ERROR;
+}
+
+uint32_t HttpServer::Http2Session::process_window_update(uint32_t stream_id, const std::string &payload) {
+    if (payload.size() != 4) {
+        return FRAME_SIZE_ERROR;
+    }
+    uint32_t increment = read_uint32(payload.data()) & 0x7fffffff;
+    if (stream_id == 0) {
+        _send_window += increment;
+        return increment == 0 || _send_window > MAX_WINDOW_SIZE ? FLOW_CONTROL_ERROR : NO_ERROR;
+    }
+    auto it = _streams.find(stream_id);
+    if (it != _streams.end()) {
+        it->second.send_window += increment;
+        if (increment == 0 || it->second.send_window > MAX_WINDOW_SIZE) {
+            close_stream(stream_id, FLOW_CONTROL_ERROR);
+        }
+    }
+    return NO_ERROR;
+}
+
+void HttpServer::Http2Session::process_priority(uint32_t stream_id, const char *payload) {
+    // the exclusive flag is ignored, siblings simply share what their parent leaves
+    uint32_t dependency = read_uint32(payload) & 0x7fffffff;
+    auto it = _streams.find(stream_id);
+    if (it != _streams.end() && dependency != stream_id) {
+        it->second.dependency = dependency;
+        it->second.weight = static_cast<uint16_t>(static_cast<uint8_t>(payload[4]) + 1);
+    }
+}
+
+void HttpServer::Http2Session::open_stream(uint32_t stream_id, const std::shared_ptr<HttpRequest> &http_request) {
+    Stream &stream = _streams[stream_id];
+    stream.http_request = http_request;
+    stream.start = std::chrono::steady_clock::now();
+    stream.send_window = _initial_window_size;
+    _stream_ids[http_request] = stream_id;
+
+    http_request->is_parsed(true);
+    http_request->setDeadline(stream.start + std::chrono::seconds(global::DEFAULT_TIMEOUT.total_seconds()));
+    { // block for RAII
+        std::lock_guard<std::mutex> lock(_http_server._map_mutex);
+        _http_server._waiting_streams.emplace(http_request, shared_from_this());
+    }
+    _http_server._http_sink->fromHttpSource(http_request);
+}
+
+void HttpServer::Http2Session::attach_response(const std::shared_ptr<HttpRequest> &http_request, const std::shared_ptr<HttpResponse> &http_response) {
+    auto id_it = _stream_ids.find(http_request);
+    if (id_it == _stream_ids.end()) {
+        return;
+    }
+    Stream &stream = _streams[id_it->second];
+    if (stream.http_response) {
+        // the stream has already been answered with a timeout
+        return;
+    } else if (!http_response || http_response->getRawStream()->is_aborted()) {
+        stream.http_response = make_response("504", "Gateway Time-out", http_request->get_field("host") + http_request->get_path() +
+                                                                        " takes too much time");
+        _http_server._http_sink->cancelFromHttpSource(http_request);
+    } else if (!http_response->is_parsed()) {
+        stream.http_response = make_response("502", "Bad Gateway", "Can't parse response form " + http_request->get_field("host") +
+                                                                    http_request->get_path());
+    } else {
+        stream.http_response = http_response;
+        if (http_response->get_field("transfer-encoding").find("chunked") != std::string::npos) {
+            stream.chunked_decoder = std::make_shared<ChunkedDecoder>();
+        }
+        std::string content_encoding = http_response->get_field("content-encoding");
+        std::transform(content_encoding.begin(), content_encoding.end(), content_encoding.begin(), ::tolower);
+        if ((content_encoding == "gzip" || content_encoding == "x-gzip" || content_encoding == "deflate") &&
+                !HttpServer::accepts_encoding(http_request, content_encoding)) {
+            stream.gzip_decoder = std::make_shared<GzipDecoder>();
+        }
+    }
+    send_responses();
+    flush();
+}
+
+void HttpServer::Http2Session::send_responses() {
+    if (_closing || _closed) {
+        return;
+    }
+
+    auto time_point = std::chrono::steady_clock::now();
+    std::vector<uint32_t> failed_streams;
+    for (auto &entry : _streams) {
+        Stream &stream = entry.second;
+        if (!stream.http_response && time_point >= stream.start + std::chrono::seconds(global::DEFAULT_TIMEOUT.total_seconds())) {
+            stream.http_response = make_response("504", "Gateway Time-out", stream.http_request->get_field("host") +
+                                                                            stream.http_request->get_path() + " takes too much time");
+            { // block for RAII
+                std::lock_guard<std::mutex> lock(_http_server._map_mutex);
+                _http_server._waiting_streams.erase(stream.http_request);
+            }
+            _http_server._http_sink->cancelFromHttpSource(stream.http_request);
+        }
+        if (stream.http_response && !stream.headers_sent) {
+            send_headers(entry.first, stream);
+        }
+        if (stream.headers_sent && !fill_pending(stream)) {
+            failed_streams.push_back(entry.first);
+        }
+    }
+    for (auto stream_id : failed_streams) {
+        std::cerr << "HTTP/2 stream " << stream_id << " aborted" << std::endl;
+        close_stream(stream_id, INTERNAL_ERROR);
+    }
+
+    // DATA frames go to the stream which received the least relatively to its weight, once its parent can't progress
+    while (_output.size() < global::DEFAULT_HTTP2_OUTPUT_BUFFER_SIZE) {
+        auto next = _streams.end();
+        for (auto it = _streams.begin(); it != _streams.end(); ++it) {
+            Stream &stream = it->second;
+            bool ending = stream.body_completed && stream.pending.empty();
+            if (!stream.headers_sent || (!ending && (stream.pending.empty() || stream.send_window <= 0 || _send_window <= 0 || is_blocked(stream)))) {
+                continue;
+            }
+            if (next == _streams.end() || stream.sent_bytes * next->second.weight < next->second.sent_bytes * stream.weight) {
+                next = it;
+            }
+        }
+        if (next == _streams.end()) {
+            break;
+        }
+
+        Stream &stream = next->second;
+        size_t size = std::min({stream.pending.size(), _max_frame_size, static_cast<size_t>(std::max(stream.send_window, 0L)),
+                                static_cast<size_t>(std::max(_send_window, 0L))});
+        bool end_stream = stream.body_completed && size == stream.pending.size();
+        send_frame(DATA, end_stream ? END_STREAM : 0, next->first, stream.pending.substr(0, size));
+        stream.pending.erase(0, size);
+        stream.send_window -= size;
+        _send_window -= size;
+        stream.sent_bytes += size;
+        if (end_stream) {
+            _http_server.log(stream.http_request->get_method() + "\t" + stream.http_response->get_status_code() + "\t" +
+                             stream.http_request->get_field("host") + stream.http_request->get_path() + stream.http_request->get_query() + "\t" +
+                             std::to_string(stream.sent_bytes) + "\t" +
+                             std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - stream.start).count()));
+            _stream_ids.erase(stream.http_request);
+            _streams.erase(next);
+        } else if (!fill_pending(stream)) {
+            close_stream(next->first, INTERNAL_ERROR);
+        }
+    }
+
+    if (_goaway_received && _streams.empty()) {
+        _closing = true;
+    } else if (!_streams.empty() && !_send_scheduled) {
+        // responses are polled like the raw streams of HTTP/1.1 sessions
+        _send_scheduled = true;
+        _send_timer.expires_from_now(global::DEFAULT_WAIT_REDO);
+        _send_timer.async_wait(_strand.wrap(boost::bind(&Http2Session::send_timer_handler, shared_from_this(), _1)));
+    }
+}
+
+void HttpServer::Http2Session::send_timer_handler(const boost::system::error_code &err) {
+    _send_scheduled = false;
+    if (!err) {
+        send_responses();
+        flush();
+    }
+}
+
+void HttpServer::Http2Session::send_headers(uint32_t stream_id, Stream &stream) {
+    HeaderList headers;
+    headers.emplace_back(":status", stream.http_response->get_status_code());
+    for (const auto &field : stream.http_response->get_fields()) {
+        std::string name = field.first;
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        if (!is_connection_specific(name) && !(stream.gzip_decoder && (name == "content-encoding" || name == "content-length"))) {
+            headers.emplace_back(name, field.second);
+        }
+    }
+
+    // the header block is split in CONTINUATION frames if it doesn't fit in a single frame
+    std::string block = _hpack_encoder.encode(headers);
+    size_t size = std::min(block.size(), _max_frame_size);
+    send_frame(HEADERS, size == block.size() ? END_HEADERS : 0, stream_id, block.substr(0, size));
+    for (size_t pos = size; pos < block.size(); pos += size) {
+        size = std::min(block.size() - pos, _max_frame_size);
+        send_frame(CONTINUATION, pos + size == block.size() ? END_HEADERS : 0, stream_id, block.substr(pos, size));
+    }
+    stream.headers_sent = true;
+}
+
+bool HttpServer::Http2Session::fill_pending(Stream &stream) {
+    if (stream.body_completed) {
+        return true;
+    }
+    // HTTP/1.1 framing is removed, and the coding the client doesn't accept
+    auto raw_stream = stream.http_response->getRawStream();
+    char buffer[global::DEFAULT_BUFFER_SIZE];
+    long read_bytes = -1;
+    while (stream.pending.size() < _max_frame_size &&
+           (read_bytes = raw_stream->readSomeRawData(stream.pos, buffer, global::DEFAULT_BUFFER_SIZE)) > 0) {
+        stream.pos += read_bytes;
+        std::string payload;
+        if (stream.chunked_decoder) {
+            if (!stream.chunked_decoder->decode(buffer, read_bytes, payload)) {
+                return false;
+            }
+        } else {
+            payload.assign(buffer, read_bytes);
+        }
+        if (stream.gzip_decoder) {
+            if (!stream.gzip_decoder->decode(payload.data(), payload.size(), stream.pending)) {
+                return false;
+            }
+        } else {
+            stream.pending += payload;
+        }
+    }
+    if (read_bytes == 0) {
+        if (raw_stream->is_aborted()) {
+            return false;
+        }
+        stream.body_completed = true;
+    }
+    return true;
+}
+
+bool HttpServer::Http2Session::is_blocked(const Stream &stream) {
+    // a stream waits for its ancestors still able to send, the depth is bounded against dependency loops
+    uint32_t dependency = stream.dependency;
+    for (int depth = 0; dependency != 0 && depth < 16; ++depth) {
+        auto it = _streams.find(dependency);
+        if (it == _streams.end()) {
+            return false;
+        } else if (it->second.headers_sent && !it->second.pending.empty() && it->second.send_window > 0) {
+            return true;
+        }
+        dependency = it->second.dependency;
+    }
+    return false;
+}
+
+void HttpServer::Http2Session::close_stream(uint32_t stream_id, uint32_t error_code) {
+    auto it = _streams.find(stream_id);
+    if (it == _streams.end()) {
+        return;
+    }
+    auto http_request = it->second.http_request;
+    { // block for RAII
+        std::lock_guard<std::mutex> lock(_http_server._map_mutex);
+        _http_server._waiting_streams.erase(http_request);
+    }
+    http_request->getRawStream()->is_aborted(true);
+    // the response may be shared with other sessions, let the interpreter decide if it is still needed
+    _http_server._http_sink->cancelFromHttpSource(http_request);
+    if (error_code != NO_ERROR) {
+        std::string payload;
+        append_uint32(payload, error_code);
+        send_frame(RST_STREAM, 0, stream_id, payload);
+    }
+    _stream_ids.erase(http_request);
+    _streams.erase(it);
+}
+
+void HttpServer::Http2Session::send_frame(uint8_t type, uint8_t flags, uint32_t stream_id, const std::string &payload) {
+    _output.push_back(static_cast<char>(payload.size() >> 16));
+    _output.push_back(static_cast<char>(payload.size() >> 8));
+    _output.push_back(static_cast<char>(payload.size()));
+    _output.push_back(static_cast<char>(type));
+    _output.push_back(static_cast<char>(flags));
+    append_uint32(_output, stream_id);
+    _output += payload;
+}
+
+void HttpServer::Http2Session::flush() {
+    if (_closed || !_writing.empty()) {
+        return;
+    } else if (_output.empty()) {
+        if (_closing) {
+            close();
+        }
+        return;
+    }
+    _writing.swap(_output);
+    boost::asio::async_write(_stream, boost::asio::buffer(_writing),
+                             _strand.wrap(boost::bind(&Http2Session::write_handler, shared_from_this(), _1, _2)));
+}
+
+void HttpServer::Http2Session::write_handler(const boost::system::error_code &err, size_t bytes_transferred) {
+    _writing.clear();
+    if (err) {
+        close();
+        return;
+    }
+    send_responses();
+    flush();
+}
+
+void HttpServer::Http2Session::connection_error(uint32_t error_code) {
+    std::cerr << "HTTP/2 connection error " << error_code << std::endl;
+    std::string payload;
+    append_uint32(payload, _last_stream_id);
+    append_uint32(payload, error_code);
+    send_frame(GOAWAY, 0, 0, payload);
+    _closing = true;
+    flush();
+}
+
+void HttpServer::Http2Session::close() {
+    if (_closed) {
+        return;
+    }
+    _closed = true;
+    for (auto &entry : _streams) {
+        { // block for RAII
+            std::lock_guard<std::mutex> lock(_http_server._map_mutex);
+            _http_server._waiting_streams.erase(entry.second.http_request);
+        }
+        entry.second.http_request->getRawStream()->is_aborted(true);
+        _http_server._http_sink->cancelFromHttpSource(entry.second.http_request);
+    }
+    _streams.clear();
+    _stream_ids.clear();
+    _send_timer.cancel();
+    _idle_timer.cancel();
+    boost::system::error_code err;
+    _stream.socket().close(err);
+}
+
+std::shared_ptr<HttpResponse> HttpServer::Http2Session::make_response(const std::string &status_code, const std::string &reason,
+                                                                      const std::string &body) {
+    auto http_response = std::make_shared<HttpResponse>();
+    http_response->set_version("HTTP/1.1");
+    http_response->set_status_code(status_code);
+    http_response->set_reason(reason);
+    http_response->set_field("content-type", "text/plain");
+    http_response->set_field("content-length", std::to_string(body.size()));
+    http_response->getRawStream()->append_raw_data(body);
+    http_response->is_parsed(true);
+    http_response->getRawStream()->is_completed(true);
+    return http_response;
+}
@@ -15,7 +15,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "http_ndn_interpreter.h"
 
 #include <iostream>
+#include <algorithm>
 
+#include "cache_control.h"
 #include "sha1.h"
 
 static const std::set<std::string> STATIC_EXTENSIONS {
@@ -69,19 +71,27 @@ static std::string uri_encode(const std::string & sSrc){
     return sResult;
 }
 
-HttpNdnInterpreter::HttpNdnInterpreter(size_t concurrency)
-        : Module(concurrency) {
+HttpNdnInterpreter::HttpNdnInterpreter(size_t concurrency, const std::string &routes_file)
+        : Module(concurrency)
+        , _router(routes_file)
+        , _reload_timer(_ios) {
 
 }
 
 void HttpNdnInterpreter::run() {
-
+    if (_router.isEnabled()) {
+        reloadRoutes();
+    }
 }
 
 void HttpNdnInterpreter::fromHttpSource(const std::shared_ptr<HttpRequest> &http_request) {
     _ios.post(boost::bind(&HttpNdnInterpreter::fromHttpSourceHandler, this, http_request));
 }
 
+void HttpNdnInterpreter::cancelFromHttpSource(const std::shared_ptr<HttpRequest> &http_request) {
+    _ios.post(boost::bind(&HttpNdnInterpreter::cancelFromHttpSourceHandler, this, http_request));
+}
+
 void HttpNdnInterpreter::fromNdnSink(const std::shared_ptr<NdnContent> &content) {
     _ios.post(boost::bind(&HttpNdnInterpreter::fromNdnSinkHandler, this, content));
 }
@@ -91,10 +101,49 @@ void HttpNdnInterpreter::fromHttpSourceHandler(const std::shared_ptr<HttpRequest
     computeNames(http_request, timer);
 }
 
+void HttpNdnInterpreter::cancelFromHttpSourceHandler(const std::shared_ptr<HttpRequest> &http_request) {
+    std::string key;
+    { // block for RAII
+        std::lock_guard<std::mutex> lock(_pending_requests_mutex);
+        auto pending_it = std::find_if(_pending_requests.begin(), _pending_requests.end(),
+                                       [&](const decltype(_pending_requests)::value_type &pending) {
+                                           return pending.second.count(http_request) > 0;
+                                       });
+        if (pending_it != _pending_requests.end()) {
+            pending_it->second.erase(http_request);
+            if (pending_it->second.empty()) {
+                key = pending_it->first;
+                _pending_requests.erase(pending_it);
+            }
+        } else {
+            auto served_it = std::find_if(_served_requests.begin(), _served_requests.end(),
+                                          [&](const decltype(_served_requests)::value_type &served) {
+                                              return served.second.second.count(http_request) > 0;
+                                          });
+            if (served_it != _served_requests.end()) {
+                served_it->second.second.erase(http_request);
+                if (served_it->second.second.empty()) {
+                    auto raw_stream = served_it->second.first->getRawStream();
+                    if (!(raw_stream->is_completed() || raw_stream->is_aborted())) {
+                        // stops the retrieval of remaining segments
+                        raw_stream->is_aborted(true);
+                        key = served_it->first;
+                    }
+                    _served_requests.erase(served_it);
+                }
+            }
+        }
+    }
+    // only the last requester of a response can cancel it
+    if (!key.empty()) {
+        _ndn_sink->cancelFromNdnSource(makeContentName(http_request, key.substr(0, key.find(' '))));
+    }
+}
+
 void HttpNdnInterpreter::fromNdnSinkHandler(const std::shared_ptr<NdnContent> &content) {
     auto http_response = std::make_shared<HttpResponse>(content->getRawStream());
     auto timer = std::make_shared<boost::asio::deadline_timer>(_ios);
-    getHttpResponseHeader(content->getName().get(-1).toUri(), http_response, timer);
+    getHttpResponseHeader(makeKey(content->getName().get(-1).toUri(), content->getByteRange()), content->getByteRange(), http_response, timer);
 }
 
 void HttpNdnInterpreter::computeNames(const std::shared_ptr<HttpRequest> &http_request, const std::shared_ptr<boost::asio::deadline_timer> &timer) {
@@ -114,6 +163,14 @@ void HttpNdnInterpreter::computeNames(const std::shared_ptr<HttpRequest> &http_r
                 http_request->unset_field("proxy-connection");
             }
 
+            // the full response is named and retrieved, so every range of it can be served from the same segments
+            ByteRange byte_range;
+            if (http_request->get_method() == "GET" && !http_request->get_field("range").empty()) {
+                byte_range.parse(http_request->get_field("range"), http_request->get_field("if-range"));
+                http_request->unset_field("range");
+                http_request->unset_field("if-range");
+            }
+
             std::string body = http_request->getRawStream()->raw_data_as_string().substr(0, 1024);
             http_request->add_header_to_raw_stream();
             if (STATIC_EXTENSIONS.find(http_request->get_extension()) != STATIC_EXTENSIONS.end()) {
@@ -125,54 +182,7 @@ void HttpNdnInterpreter::computeNames(const std::shared_ptr<HttpRequest> &http_r
 
             std::string sha1 = SHA1{}(http_request->make_header() + body);
 
-
-            { // block for RAII
-                std::lock_guard<std::mutex> lock(_pending_requests_mutex);
-                auto it = _pending_requests.find(sha1);
-                if (it == _pending_requests.end()) {
-                    _pending_requests.emplace(sha1, std::unordered_set<std::shared_ptr<HttpRequest>>{http_request});
-                } else {
-                    it->second.insert(http_request);
-                    //std::cout << http_request->get_field("host") << http_request->get_path()
-                    //          << " (" << sha1 << ") count = " << it->second.size() << std::endl;
-                    return;
-                }
-            }
-
-            ndn::Name name("http");
-            // tokenize domain
-            std::string host = http_request->get_field("host");
-            auto host_it = host.find(':');
-            std::stringstream domain(host_it != std::string::npos ? host.substr(0, host_it) : host);
-            std::string domain_token;
-            std::vector<std::string> domain_tokens;
-            while (std::getline(domain, domain_token, '.')) {
-                domain_tokens.emplace_back(domain_token);
-            }
-            auto domain_it = domain_tokens.rbegin();
-            while (domain_it != domain_tokens.rend()) {
-                name.append(*domain_it++);
-            }
-
-            // tokenize path
-            std::stringstream path(http_request->get_path());
-            std::string path_token;
-            std::vector<std::string> path_tokens;
-            while (std::getline(path, path_token, '/')) {
-                if (!path_token.empty() && (path_token != "." && path_token != "..")) {
-                    path_tokens.emplace_back(path_token);
-                }
-            }
-            auto path_it = path_tokens.begin();
-            while (path_it != path_tokens.end()) {
-                name.append(uri_encode(*path_it++));
-            }
-
-            name.append(sha1);
-
-            auto ndn_content = std::make_shared<NdnContent>(http_request->getRawStream());
-            ndn_content->setName(name);
-            _ndn_sink->fromNdnSource(ndn_content);
+            requestContent(http_request, sha1, byte_range, timer);
         } else {
             timer->expires_from_now(global::DEFAULT_WAIT_REDO);
             timer->async_wait(boost::bind(&HttpNdnInterpreter::computeNames, this, http_request, timer));
@@ -180,7 +190,51 @@ void HttpNdnInterpreter::computeNames(const std::shared_ptr<HttpRequest> &http_r
     }
 }
 
-void HttpNdnInterpreter::getHttpResponseHeader(const std::string &sha1, const std::shared_ptr<HttpResponse> &http_response,
+void HttpNdnInterpreter::requestContent(const std::shared_ptr<HttpRequest> &http_request, const std::string &sha1, const ByteRange &byte_range,
+                                        const std::shared_ptr<boost::asio::deadline_timer> &timer) {
+    if (http_request->getRawStream()->is_aborted()) {
+        return;
+    }
+    std::string key = makeKey(sha1, byte_range);
+    { // block for RAII
+        std::lock_guard<std::mutex> lock(_pending_requests_mutex);
+        auto it = _pending_requests.find(key);
+        if (it != _pending_requests.end()) {
+            it->second.insert(http_request);
+            //std::cout << http_request->get_field("host") << http_request->get_path()
+            //          << " (" << sha1 << ") count = " << it->second.size() << std::endl;
+            return;
+        }
+        // the resolver knows a single byte range per name, another one waits until the pending response starts
+        auto same_name_it = _pending_requests.lower_bound(sha1);
+        if (same_name_it != _pending_requests.end() && same_name_it->first.compare(0, sha1.size(), sha1) == 0) {
+            timer->expires_from_now(global::DEFAULT_WAIT_REDO);
+            timer->async_wait(boost::bind(&HttpNdnInterpreter::requestContent, this, http_request, sha1, byte_range, timer));
+            return;
+        }
+        _pending_requests.emplace(key, std::unordered_set<std::shared_ptr<HttpRequest>>{http_request});
+    }
+
+    bool routed = false;
+    ndn::Name name = makeContentName(http_request, sha1, &routed);
+
+    auto ndn_content = std::make_shared<NdnContent>(http_request->getRawStream());
+    ndn_content->setName(name);
+    ndn_content->setRouted(routed);
+    ndn_content->setDeadline(http_request->getDeadline());
+    ndn_content->setByteRange(byte_range);
+    // the client won't take a stored response
+    CacheControl cache_control(http_request->get_field("cache-control"));
+    ndn_content->setRefresh(cache_control.has("no-cache") || cache_control.getSeconds("max-age") == 0 ||
+                            http_request->get_field("pragma").find("no-cache") != std::string::npos);
+    _ndn_sink->fromNdnSource(ndn_content);
+}
+
+std::string HttpNdnInterpreter::makeKey(const std::string &sha1, const ByteRange &byte_range) {
+    return byte_range.isValid() ? sha1 + " " + byte_range.toString() : sha1;
+}
+
+void HttpNdnInterpreter::getHttpResponseHeader(const std::string &key, const ByteRange &byte_range, const std::shared_ptr<HttpResponse> &http_response,
                                                const std::shared_ptr<boost::asio::deadline_timer> &timer) {
     if(!http_response->getRawStream()->is_aborted()) {
         // keep track of completion before doing the job because if set to true and no HTTP header found then discard
@@ -217,44 +271,113 @@ void HttpNdnInterpreter::getHttpResponseHeader(const std::string &sha1, const st
                 std::getline(header, header_line);
             }
 
+            if (byte_range.isResolved()) {
+                // the raw stream only holds the requested bytes of the body
+                http_response->set_status_code("206");
+                http_response->set_reason("Partial Content");
+                http_response->set_field("content-range", byte_range.getContentRange());
+                http_response->set_field("content-length", std::to_string(byte_range.getLast() - byte_range.getFirst() + 1));
+            }
+
             if (http_response->has_minimal_requirements()) {
                 http_response->is_parsed(true);
             } else {
                 http_response->getRawStream()->is_aborted(true);
             }
 
-            std::unordered_set<std::shared_ptr<HttpRequest>> set;
-            { // block for RAII
-                std::lock_guard<std::mutex> lock(_pending_requests_mutex);
-                set = std::move(_pending_requests.at(sha1));
-                _pending_requests.erase(sha1);
-            }
-            for (const auto& req : set) {
-                _http_source->fromHttpSink(req, http_response);
-            }
+            deliverHttpResponse(key, http_response);
         } else if (!is_complete) {
             timer->expires_from_now(global::DEFAULT_WAIT_REDO);
-            timer->async_wait(boost::bind(&HttpNdnInterpreter::getHttpResponseHeader, this, sha1, http_response, timer));
+            timer->async_wait(boost::bind(&HttpNdnInterpreter::getHttpResponseHeader, this, key, byte_range, http_response, timer));
         } else {
-            std::unordered_set<std::shared_ptr<HttpRequest>> set;
-            { // block for RAII
-                std::lock_guard<std::mutex> lock(_pending_requests_mutex);
-                set = std::move(_pending_requests.at(sha1));
-                _pending_requests.erase(sha1);
-            }
-            for (const auto& req : set) {
-                _http_source->fromHttpSink(req, http_response);
-            }
+            deliverHttpResponse(key, http_response);
         }
     } else {
-        std::unordered_set<std::shared_ptr<HttpRequest>> set;
-        { // block for RAII
-            std::lock_guard<std::mutex> lock(_pending_requests_mutex);
-            set = std::move(_pending_requests.at(sha1));
-            _pending_requests.erase(sha1);
+        deliverHttpResponse(key, http_response);
+    }
+}
+
+ndn::Name HttpNdnInterpreter::makeContentName(const std::shared_ptr<HttpRequest> &http_request, const std::string &sha1, bool *routed) {
+    ndn::Name name("http");
+    std::string host = http_request->get_field("host");
+    auto host_it = host.find(':');
+    if (host_it != std::string::npos) {
+        host = host.substr(0, host_it);
+    }
+    bool is_routed = _router.route(host, name);
+    if (routed != nullptr) {
+        *routed = is_routed;
+    }
+    if (!is_routed) {
+        // tokenize domain
+        std::stringstream domain(host);
+        std::string domain_token;
+        std::vector<std::string> domain_tokens;
+        while (std::getline(domain, domain_token, '.')) {
+            domain_tokens.emplace_back(domain_token);
+        }
+        auto domain_it = domain_tokens.rbegin();
+        while (domain_it != domain_tokens.rend()) {
+            name.append(*domain_it++);
         }
-        for (const auto& req : set) {
-            _http_source->fromHttpSink(req, http_response);
+    }
+
+    // tokenize path
+    std::stringstream path(http_request->get_path());
+    std::string path_token;
+    std::vector<std::string> path_tokens;
+    while (std::getline(path, path_token, '/')) {
+        if (!path_token.empty() && (path_token != "." && path_token != "..")) {
+            path_tokens.emplace_back(path_token);
         }
     }
+    auto path_it = path_tokens.begin();
+    while (path_it != path_tokens.end()) {
+        name.append(uri_encode(*path_it++));
+    }
+
+    name.append(sha1);
+    return name;
+}
+
+void HttpNdnInterpreter::deliverHttpResponse(const std::string &key, const std::shared_ptr<HttpResponse> &http_response) {
+    std::unordered_set<std::shared_ptr<HttpRequest>> set;
+    { // block for RAII
+        std::lock_guard<std::mutex> lock(_pending_requests_mutex);
+        auto it = _pending_requests.find(key);
+        if (it != _pending_requests.end()) {
+            set = std::move(it->second);
+            _pending_requests.erase(it);
+        }
+
+        // forget responses which ended since the last delivery
+        auto served_it = _served_requests.begin();
+        while (served_it != _served_requests.end()) {
+            auto raw_stream = served_it->second.first->getRawStream();
+            if (raw_stream->is_completed() || raw_stream->is_aborted()) {
+                served_it = _served_requests.erase(served_it);
+            } else {
+                ++served_it;
+            }
+        }
+        if (!set.empty() && !(http_response->getRawStream()->is_completed() || http_response->getRawStream()->is_aborted())) {
+            _served_requests[key] = std::make_pair(http_response, set);
+        }
+    }
+
+    if (set.empty()) {
+        // every requester gave up in the meantime
+        http_response->getRawStream()->is_aborted(true);
+    }
+    for (const auto& req : set) {
+        _http_source->fromHttpSink(req, http_response);
+    }
 }
+
+void HttpNdnInterpreter::reloadRoutes() {
+    if (_router.reload()) {
+        std::cout << "domain routes loaded" << std::endl;
+    }
+    _reload_timer.expires_from_now(global::DEFAULT_WAIT_ROUTES_RELOAD);
+    _reload_timer.async_wait(boost::bind(&HttpNdnInterpreter::reloadRoutes, this));
+}
\ No newline at end of file
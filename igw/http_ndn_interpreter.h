@@ -30,15 +30,23 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "http_request.h"
 #include "http_response.h"
 #include "ndn_content.h"
+#include "byte_range.h"
+#include "domain_router.h"
 
 class HttpNdnInterpreter : public Module, public HttpSink, public NdnSource {
 private:
     // mandatory, ndn-cxx lib throws exception when it sends burst of interest with same name
     std::mutex _pending_requests_mutex;
+    // keyed by the SHA1 of the name, followed by the byte range if any
     std::map<std::string, std::unordered_set<std::shared_ptr<HttpRequest>>> _pending_requests;
+    // requests which already got their response header, kept until the response body is completed
+    std::map<std::string, std::pair<std::shared_ptr<HttpResponse>, std::unordered_set<std::shared_ptr<HttpRequest>>>> _served_requests;
+
+    DomainRouter _router;
+    boost::asio::deadline_timer _reload_timer;
 
 public:
-    explicit HttpNdnInterpreter(size_t concurrency = 1);
+    explicit HttpNdnInterpreter(size_t concurrency = 1, const std::string &routes_file = "");
 
     ~HttpNdnInterpreter() override = default;
 
@@ -46,15 +54,31 @@ public:
 
     void fromHttpSource(const std::shared_ptr<HttpRequest> &http_request) override;
 
+    void cancelFromHttpSource(const std::shared_ptr<HttpRequest> &http_request) override;
+
     void fromNdnSink(const std::shared_ptr<NdnContent> &content) override;
 
 private:
     void fromHttpSourceHandler(const std::shared_ptr<HttpRequest> &http_request);
 
+    void cancelFromHttpSourceHandler(const std::shared_ptr<HttpRequest> &http_request);
+
     void fromNdnSinkHandler(const std::shared_ptr<NdnContent> &content);
 
     void computeNames(const std::shared_ptr<HttpRequest> &http_request, const std::shared_ptr<boost::asio::deadline_timer> &timer);
 
-    void getHttpResponseHeader(const std::string &sha1, const std::shared_ptr<HttpResponse> &http_response,
+    void requestContent(const std::shared_ptr<HttpRequest> &http_request, const std::string &sha1, const ByteRange &byte_range,
+                        const std::shared_ptr<boost::asio::deadline_timer> &timer);
+
+    static std::string makeKey(const std::string &sha1, const ByteRange &byte_range);
+
+    // routed is set if the domain is published by a native NDN server
+    ndn::Name makeContentName(const std::shared_ptr<HttpRequest> &http_request, const std::string &sha1, bool *routed = nullptr);
+
+    void reloadRoutes();
+
+    void getHttpResponseHeader(const std::string &key, const ByteRange &byte_range, const std::shared_ptr<HttpResponse> &http_response,
                                const std::shared_ptr<boost::asio::deadline_timer> &timer);
+
+    void deliverHttpResponse(const std::string &key, const std::shared_ptr<HttpResponse> &http_response);
 };
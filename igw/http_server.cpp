@@ -19,6 +19,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <iostream>
 #include <algorithm>
 #include <regex>
+#include <sstream>
 
 enum method_type {
     CONNECT,
@@ -47,12 +48,14 @@ std::map<std::string, method_type> available_methods {
 std::atomic<size_t> HttpServer::HttpSession::count {0};
 #endif
 
-HttpServer::HttpSession::HttpSession(HttpServer &http_server, boost::asio::ip::tcp::socket &&socket)
+HttpServer::HttpSession::HttpSession(HttpServer &http_server, ClientStream &&stream)
         : _http_server(http_server)
         , _strand(http_server._ios)
-        , _socket(std::move(socket))
+        , _handshake_strand(http_server._tls_ios)
+        , _stream(std::move(stream))
         , _read_timer(http_server._ios)
-        , _write_timer(http_server._ios) {
+        , _write_timer(http_server._ios)
+        , _decode_timer(http_server._ios) {
 #ifndef NDEBUG
 	std::cout << "new session (" << ++count << " active session(s))" << std::endl;
 #endif
@@ -78,10 +81,40 @@ void HttpServer::HttpSession::notify() {
     _write_timer.cancel();
 }
 
+void HttpServer::HttpSession::handshake() {
+    _read_timer.expires_from_now(global::DEFAULT_TIMEOUT_TLS_HANDSHAKE);
+    _read_timer.async_wait(_handshake_strand.wrap(boost::bind(&HttpSession::handshake_timer_handler, shared_from_this(), _1)));
+    // the intermediate steps of the handshake, where the asymmetric cryptography happens, are run by the strand
+    _stream.tls().async_handshake(boost::asio::ssl::stream_base::server,
+                                  _handshake_strand.wrap(boost::bind(&HttpSession::handshake_handler, shared_from_this(), _1)));
+}
+
+void HttpServer::HttpSession::handshake_handler(const boost::system::error_code &err) {
+    _read_timer.cancel();
+    const unsigned char *protocol = nullptr;
+    unsigned int length = 0;
+    if (!err) {
+        SSL_get0_alpn_selected(_stream.tls().native_handle(), &protocol, &length);
+    }
+    if (!err && length == 2 && std::equal(protocol, protocol + length, "h2")) {
+        std::make_shared<Http2Session>(_http_server, std::move(_stream), std::string())->start();
+    } else if (!err) {
+        start();
+    } else {
+        std::cerr << "TLS handshake failed (" << err.message() << ")" << std::endl;
+    }
+}
+
+void HttpServer::HttpSession::handshake_timer_handler(const boost::system::error_code &err) {
+    if (!err) {
+        _stream.socket().close();
+    }
+}
+
 void HttpServer::HttpSession::read_request_header() {
     _read_timer.expires_from_now(global::DEFAULT_TIMEOUT_READ_HTTP_HEADER);
     _read_timer.async_wait(_strand.wrap(boost::bind(&HttpSession::timer_handler, shared_from_this(), _1)));
-    boost::asio::async_read_until(_socket, _read_buffer, "\r\n\r\n",
+    boost::asio::async_read_until(_stream, _read_buffer, "\r\n\r\n",
                                   _strand.wrap(boost::bind(&HttpSession::read_request_header_handler, shared_from_this(), _1, _2)));
 }
 
@@ -106,13 +139,12 @@ void HttpServer::HttpSession::read_request_header_handler(const boost::system::e
             }
         }
 
-	    std::regex pattern("^(?:https?://)?(?:[^/]+?(?::\\d+)?)?(/.*?(?:[^/]+?(\\.\\w+?)?)?)(\\?.*)?$", std::regex_constants::icase);
-        std::smatch results;
-        if (url.size() <= 4096 && std::regex_search(url, results, pattern)) {
-            _http_request->set_path(results[1]);
-            _http_request->set_extension(results[2]);
-            _http_request->set_query(results[3]);
+        if (_http_request->get_method() == "PRI" && url == "*" && _http_request->get_version() == "HTTP/2.0") {
+            // HTTP/2 with prior knowledge, the rest of the preface and the first frames follow
+            start_http2();
+            return;
         }
+        HttpServer::parse_url(url, _http_request);
 
         std::getline(is, header_line);
         while ((delimiter_index = header_line.find(':')) != std::string::npos) {
@@ -124,8 +156,19 @@ void HttpServer::HttpSession::read_request_header_handler(const boost::system::e
             std::getline(is, header_line);
         }
 
+        if (_stream.isSecure()) {
+            // the egw has to reach the origin over TLS too, the scheme is lost with the request line
+            _http_request->set_field("x-forwarded-proto", "https");
+        }
+
         if (_http_request->has_minimal_requirements()) {
             _http_request->is_parsed(true);
+            if (wants_http2_upgrade()) {
+                upgrade_to_http2();
+                return;
+            }
+            // the time spent reading the body makes the real deadline a bit later, the budget stays conservative
+            _http_request->setDeadline(std::chrono::steady_clock::now() + std::chrono::seconds(global::DEFAULT_TIMEOUT.total_seconds()));
             auto it = available_methods.find(_http_request->get_method());
             if (it != available_methods.end()) {
                 _http_server._http_sink->fromHttpSource(_http_request);
@@ -200,7 +243,7 @@ void HttpServer::HttpSession::read_request_body(size_t remaining_bytes) {
     if (remaining_bytes > 0) {
         _read_timer.expires_from_now(global::DEFAULT_TIMEOUT_READ_HTTP_BODY);
         _read_timer.async_wait(_strand.wrap(boost::bind(&HttpSession::timer_handler, shared_from_this(), _1)));
-        boost::asio::async_read(_socket, _read_buffer, boost::asio::transfer_at_least(1),
+        boost::asio::async_read(_stream, _read_buffer, boost::asio::transfer_at_least(1),
                                 _strand.wrap(boost::bind(&HttpSession::read_request_body_handler, shared_from_this(),
                                                          _1, _2, remaining_bytes)));
     } else {
@@ -229,14 +272,14 @@ void HttpServer::HttpSession::read_request_body_chunk(long chunk_size) {
         //handler need more data
         _read_timer.expires_from_now(global::DEFAULT_TIMEOUT_READ_HTTP_BODY);
         _read_timer.async_wait(_strand.wrap(boost::bind(&HttpSession::timer_handler, shared_from_this(), _1)));
-        boost::asio::async_read(_socket, _read_buffer, boost::asio::transfer_at_least(1),
+        boost::asio::async_read(_stream, _read_buffer, boost::asio::transfer_at_least(1),
                                 _strand.wrap(boost::bind(&HttpSession::read_request_body_chunk_handler,
                                                          shared_from_this(), _1, _2, chunk_size)));
     } else if(chunk_size < 0) {
         //find next chunck size
         _read_timer.expires_from_now(global::DEFAULT_TIMEOUT_READ_HTTP_BODY);
         _read_timer.async_wait(_strand.wrap(boost::bind(&HttpSession::timer_handler, shared_from_this(), _1)));
-        boost::asio::async_read_until(_socket, _read_buffer, "\r\n",
+        boost::asio::async_read_until(_stream, _read_buffer, "\r\n",
                                       _strand.wrap(boost::bind(&HttpSession::read_request_body_chunk_handler,
                                                                shared_from_this(), _1, _2, chunk_size)));
     } else {
@@ -291,8 +334,11 @@ void HttpServer::HttpSession::write_response() {
         _http_response->is_parsed(true);
         _http_response->getRawStream()->is_completed(true);
 
-        std::lock_guard<std::mutex> lock(_http_server._map_mutex);
-        _http_server._waiting_sessions.erase(_http_request);
+        { // block for RAII
+            std::lock_guard<std::mutex> lock(_http_server._map_mutex);
+            _http_server._waiting_sessions.erase(_http_request);
+        }
+        _http_server._http_sink->cancelFromHttpSource(_http_request);
     } else if (!_http_response->is_parsed()) {
         _http_response = std::make_shared<HttpResponse>();
         std::string body = "Can't parse response form " + _http_request->get_field("host") + _http_request->get_path();
@@ -305,12 +351,147 @@ void HttpServer::HttpSession::write_response() {
         _http_response->set_field("content-length", std::to_string(body.size()));
         _http_response->is_parsed(true);
         _http_response->getRawStream()->is_completed(true);
+    } else {
+        std::string content_encoding = _http_response->get_field("content-encoding");
+        std::transform(content_encoding.begin(), content_encoding.end(), content_encoding.begin(), ::tolower);
+        // the egw may have compressed the body for the NDN side, or another client accepted it from the origin
+        if ((content_encoding == "gzip" || content_encoding == "x-gzip" || content_encoding == "deflate") &&
+                !HttpServer::accepts_encoding(_http_request, content_encoding)) {
+            decode_response();
+        }
     }
     write_response_header();
 }
 
+bool HttpServer::HttpSession::wants_http2_upgrade() {
+    std::string upgrade = _http_request->get_field("upgrade");
+    std::transform(upgrade.begin(), upgrade.end(), upgrade.begin(), ::tolower);
+    // h2c only exists in clear text, and a request body would have to be read before switching
+    return !_stream.isSecure() && upgrade.find("h2c") != std::string::npos && !_http_request->get_field("http2-settings").empty() &&
+           _http_request->get_field("content-length").empty() && _http_request->get_field("transfer-encoding").empty();
+}
+
+void HttpServer::HttpSession::upgrade_to_http2() {
+    auto response = std::make_shared<std::string>("HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n");
+    boost::asio::async_write(_stream, boost::asio::buffer(*response),
+                             _strand.wrap(boost::bind(&HttpSession::upgrade_to_http2_handler, shared_from_this(), _1, _2, response)));
+}
+
+void HttpServer::HttpSession::upgrade_to_http2_handler(const boost::system::error_code &err, size_t bytes_transferred,
+                                                       const std::shared_ptr<std::string> &response) {
+    if (!err) {
+        std::string http2_settings = _http_request->get_field("http2-settings");
+        // hop-by-hop fields of the upgrade are not part of the request given to the sink
+        _http_request->unset_field("upgrade");
+        _http_request->unset_field("http2-settings");
+        _http_request->unset_field("connection");
+        std::string received(boost::asio::buffers_begin(_read_buffer.data()), boost::asio::buffers_end(_read_buffer.data()));
+        std::make_shared<Http2Session>(_http_server, std::move(_stream), received)->start(_http_request, http2_settings);
+    }
+}
+
+void HttpServer::HttpSession::start_http2() {
+    // the connection now belongs to the HTTP/2 session, this one ends with its last handler
+    std::string received("PRI * HTTP/2.0\r\n");
+    received.append(boost::asio::buffers_begin(_read_buffer.data()), boost::asio::buffers_end(_read_buffer.data()));
+    std::make_shared<Http2Session>(_http_server, std::move(_stream), received)->start();
+}
+
+bool HttpServer::accepts_encoding(const std::shared_ptr<HttpRequest> &http_request, const std::string &encoding) {
+    std::string accept_encoding = http_request->get_field("accept-encoding");
+    std::transform(accept_encoding.begin(), accept_encoding.end(), accept_encoding.begin(), ::tolower);
+    std::stringstream ss(accept_encoding);
+    std::string token;
+    while (std::getline(ss, token, ',')) {
+        auto delimiter_index = token.find(';');
+        std::string name = token.substr(0, delimiter_index);
+        name.erase(0, name.find_first_not_of(' '));
+        name.erase(name.find_last_not_of(' ') + 1);
+        if (name == encoding || (name == "gzip" && encoding == "x-gzip") || name == "*") {
+            auto q_index = token.find("q=", delimiter_index != std::string::npos ? delimiter_index : token.size());
+            return q_index == std::string::npos || std::strtod(token.c_str() + q_index + 2, nullptr) > 0;
+        }
+    }
+    return false;
+}
+
+void HttpServer::HttpSession::decode_response() {
+    // the received response may be shared with other sessions, the decoded one belongs to this session only
+    auto http_response = std::make_shared<HttpResponse>();
+    bool chunked_output = _http_request->get_version() == "HTTP/1.1";
+    http_response->set_version(_http_response->get_version());
+    http_response->set_status_code(_http_response->get_status_code());
+    http_response->set_reason(_http_response->get_reason());
+    for (const auto &field : _http_response->get_fields()) {
+        http_response->set_field(field.first, field.second);
+    }
+    http_response->unset_field("content-encoding");
+    http_response->unset_field("content-length");
+    std::string etag = http_response->get_field("etag");
+    if (!etag.empty() && etag.compare(0, 2, "W/") != 0) {
+        // a strong validator belongs to the encoded bytes, the decoded ones are only equivalent
+        http_response->set_field("etag", "W/" + etag);
+    }
+    if (chunked_output) {
+        http_response->set_field("transfer-encoding", "chunked");
+    } else {
+        // the end of the body is given by the end of the connection
+        http_response->unset_field("transfer-encoding");
+        http_response->set_field("connection", "close");
+    }
+    http_response->is_parsed(true);
+
+    auto chunked_decoder = _http_response->get_field("transfer-encoding").find("chunked") != std::string::npos
+                           ? std::make_shared<ChunkedDecoder>() : std::shared_ptr<ChunkedDecoder>();
+    auto input = _http_response->getRawStream();
+    _http_response = http_response;
+    decode_body(input, http_response->getRawStream(), 0, chunked_output, chunked_decoder, std::make_shared<GzipDecoder>());
+}
+
+void HttpServer::HttpSession::decode_body(const std::shared_ptr<SeekableRawStream> &input, const std::shared_ptr<SeekableRawStream> &output, size_t pos,
+                                          bool chunked_output, const std::shared_ptr<ChunkedDecoder> &chunked_decoder,
+                                          const std::shared_ptr<GzipDecoder> &gzip_decoder) {
+    if (output->is_aborted()) {
+        return;
+    }
+
+    char buffer[global::DEFAULT_BUFFER_SIZE];
+    std::string payload;
+    std::string decoded;
+    long read_bytes;
+    bool valid = true;
+    while (valid && (read_bytes = input->readSomeRawData(pos, buffer, global::DEFAULT_BUFFER_SIZE)) > 0) {
+        pos += read_bytes;
+        if (chunked_decoder) {
+            payload.clear();
+            valid = chunked_decoder->decode(buffer, read_bytes, payload) && gzip_decoder->decode(payload.data(), payload.size(), decoded);
+        } else {
+            valid = gzip_decoder->decode(buffer, read_bytes, decoded);
+        }
+    }
+
+    if (!decoded.empty()) {
+        output->append_raw_data(chunked_output ? make_chunk(decoded) : decoded);
+    }
+    if (!valid) {
+        std::cerr << _http_request->get_field("host") << _http_request->get_path() << " -> can't decode response body" << std::endl;
+        output->is_aborted(true);
+    } else if (read_bytes < 0) {
+        _decode_timer.expires_from_now(global::DEFAULT_WAIT_REDO);
+        _decode_timer.async_wait(_strand.wrap(boost::bind(&HttpSession::decode_body, shared_from_this(), input, output, pos,
+                                                          chunked_output, chunked_decoder, gzip_decoder)));
+    } else if (input->is_aborted()) {
+        output->is_aborted(true);
+    } else {
+        if (chunked_output) {
+            output->append_raw_data("0\r\n\r\n");
+        }
+        output->is_completed(true);
+    }
+}
+
 void HttpServer::HttpSession::write_response_header() {
-        boost::asio::async_write(_socket, boost::asio::buffer(_http_response->make_header()),
+        boost::asio::async_write(_stream, boost::asio::buffer(_http_response->make_header()),
                                  _strand.wrap(boost::bind(&HttpSession::write_response_header_handler, shared_from_this(), _1, _2)));
 }
 
@@ -318,14 +499,14 @@ void HttpServer::HttpSession::write_response_header_handler(const boost::system:
     if(!err) {
         write_response_body(0);
     } else {
-        _http_response->getRawStream()->is_aborted(true);
+        _http_server._http_sink->cancelFromHttpSource(_http_request);
     }
 }
 
 void HttpServer::HttpSession::write_response_body(size_t total_bytes_transferred) {
     long read_bytes = _http_response->getRawStream()->readRawData(total_bytes_transferred, _write_buffer, global::DEFAULT_BUFFER_SIZE);
     if (read_bytes > 0) {
-        boost::asio::async_write(_socket, boost::asio::buffer(_write_buffer, read_bytes),
+        boost::asio::async_write(_stream, boost::asio::buffer(_write_buffer, read_bytes),
                                  _strand.wrap(boost::bind(&HttpSession::write_response_body_handler, shared_from_this(),
                                                           _1, _2, total_bytes_transferred)));
     } else if (read_bytes < 0) { // not enough data in response stream
@@ -346,17 +527,16 @@ void HttpServer::HttpSession::write_response_body_handler(const boost::system::e
     if (!err) {
         write_response_body(total_bytes_transferred + bytes_transferred);
     } else {
-        _http_response->getRawStream()->is_aborted(true);
+        _http_server._http_sink->cancelFromHttpSource(_http_request);
     }
 }
 
 void HttpServer::HttpSession::timer_handler(const boost::system::error_code &err) {
     if (!err) {
         _http_request->getRawStream()->is_aborted(true);
-        if(_http_response) {
-            _http_response->getRawStream()->is_aborted(true);
-        }
-        _socket.close();
+        // the response may be shared with other sessions, let the interpreter decide if it is still needed
+        _http_server._http_sink->cancelFromHttpSource(_http_request);
+        _stream.socket().close();
     }
 }
 
@@ -371,14 +551,60 @@ HttpServer::HttpServer(unsigned short port, size_t concurrency)
 
 }
 
+HttpServer::~HttpServer() {
+    _tls_ios.stop();
+    _tls_thread_pool.join_all();
+}
+
 void HttpServer::run() {
     accept();
+    if (_tls_acceptor) {
+        for (size_t i = 0; i < global::DEFAULT_TLS_HANDSHAKE_CONCURRENCY; ++i) {
+            _tls_thread_pool.create_thread(boost::bind(&boost::asio::io_service::run, &_tls_ios));
+        }
+        acceptTls();
+    }
+}
+
+void HttpServer::enableTls(unsigned short port, const std::string &certificate_chain_file, const std::string &private_key_file,
+                           const std::string &ciphers) {
+    _tls_context.reset(new boost::asio::ssl::context(boost::asio::ssl::context::sslv23_server));
+    _tls_context->set_options(boost::asio::ssl::context::default_workarounds | boost::asio::ssl::context::no_sslv2 |
+                              boost::asio::ssl::context::no_sslv3 | boost::asio::ssl::context::no_compression |
+                              boost::asio::ssl::context::single_dh_use);
+    _tls_context->use_certificate_chain_file(certificate_chain_file);
+    _tls_context->use_private_key_file(private_key_file, boost::asio::ssl::context::pem);
+
+    SSL_CTX *ctx = _tls_context->native_handle();
+    if (!ciphers.empty()) {
+        if (SSL_CTX_set_cipher_list(ctx, ciphers.c_str()) == 1) {
+            SSL_CTX_set_options(ctx, SSL_OP_CIPHER_SERVER_PREFERENCE);
+        } else {
+            std::cerr << "invalid cipher list " << ciphers << ", default ciphers are used" << std::endl;
+        }
+    }
+    // returning clients resume their session with a ticket, or with its id for those not supporting tickets
+    static const unsigned char session_id_context[] = "igw";
+    SSL_CTX_set_session_id_context(ctx, session_id_context, sizeof(session_id_context) - 1);
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_sess_set_cache_size(ctx, global::DEFAULT_TLS_SESSION_CACHE_SIZE);
+    SSL_CTX_set_timeout(ctx, global::DEFAULT_TLS_SESSION_TIMEOUT.total_seconds());
+    _alpn_protocols = std::string("\x02h2\x08http/1.1", 12);
+    SSL_CTX_set_alpn_select_cb(ctx, &HttpServer::select_alpn, this);
+
+    _tls_acceptor.reset(new boost::asio::ip::tcp::acceptor(_ios, boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), port), true));
+    _tls_ios_work.reset(new boost::asio::io_service::work(_tls_ios));
 }
 
 void HttpServer::accept() {
     _acceptor.async_accept(_acceptor_socket, boost::bind(&HttpServer::accept_handler, this, _1));
 }
 
+void HttpServer::acceptTls() {
+    auto stream = std::make_shared<ClientStream>(_ios, *_tls_context);
+    _tls_acceptor->async_accept(stream->socket(), boost::bind(&HttpServer::accept_tls_handler, this, stream, _1));
+}
+
 void HttpServer::fromHttpSink(const std::shared_ptr<HttpRequest> &http_request,
                               const std::shared_ptr<HttpResponse> &http_response) {
     _ios.post(boost::bind(&HttpServer::fromHttpSinkHandler, this, http_request, http_response));
@@ -392,11 +618,41 @@ void HttpServer::log(const std::string &line) {
 
 void HttpServer::accept_handler(const boost::system::error_code &err) {
     if (!err) {
-        std::make_shared<HttpSession>(*this, std::move(_acceptor_socket))->start();
+        std::make_shared<HttpSession>(*this, ClientStream(std::move(_acceptor_socket)))->start();
         accept();
     }
 }
 
+void HttpServer::accept_tls_handler(const std::shared_ptr<ClientStream> &stream, const boost::system::error_code &err) {
+    if (!err) {
+        std::make_shared<HttpSession>(*this, std::move(*stream))->handshake();
+        acceptTls();
+    }
+}
+
+bool HttpServer::parse_url(const std::string &url, const std::shared_ptr<HttpRequest> &http_request) {
+    std::regex pattern("^(?:https?://)?(?:[^/]+?(?::\\d+)?)?(/.*?(?:[^/]+?(\\.\\w+?)?)?)(\\?.*)?$", std::regex_constants::icase);
+    std::smatch results;
+    if (url.size() <= 4096 && std::regex_search(url, results, pattern)) {
+        http_request->set_path(results[1]);
+        http_request->set_extension(results[2]);
+        http_request->set_query(results[3]);
+        return true;
+    }
+    return false;
+}
+
+int HttpServer::select_alpn(SSL *ssl, const unsigned char **out, unsigned char *out_length, const unsigned char *in,
+                            unsigned int in_length, void *arg) {
+    auto &protocols = static_cast<HttpServer *>(arg)->_alpn_protocols;
+    // clients without a common protocol are still served with HTTP/1.1
+    if (SSL_select_next_proto(const_cast<unsigned char **>(out), out_length, reinterpret_cast<const unsigned char *>(protocols.data()),
+                              protocols.size(), in, in_length) != OPENSSL_NPN_NEGOTIATED) {
+        return SSL_TLSEXT_ERR_NOACK;
+    }
+    return SSL_TLSEXT_ERR_OK;
+}
+
 void HttpServer::fromHttpSinkHandler(const std::shared_ptr<HttpRequest> &http_request, const std::shared_ptr<HttpResponse> &http_response) {
     std::lock_guard<std::mutex> lock(_map_mutex);
     auto it = _waiting_sessions.find(http_request);
@@ -407,4 +663,11 @@ void HttpServer::fromHttpSinkHandler(const std::shared_ptr<HttpRequest> &http_re
         }
         _waiting_sessions.erase(it);
     }
+    auto stream_it = _waiting_streams.find(http_request);
+    if (stream_it != _waiting_streams.end()) {
+        if (auto session = stream_it->second.lock()) {
+            session->setHttpResponse(http_request, http_response);
+        }
+        _waiting_streams.erase(stream_it);
+    }
 }
\ No newline at end of file
@@ -15,9 +15,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #pragma once
 
 #include "boost/asio.hpp"
+#include <boost/asio/ssl.hpp>
+#include <boost/thread.hpp>
 
 #include <memory>
 #include <mutex>
+#include <map>
 #include <unordered_map>
 #include <fstream>
 #include <chrono>
@@ -28,6 +31,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "http_source.h"
 #include "http_request.h"
 #include "http_response.h"
+#include "body_codec.h"
+#include "client_stream.h"
+#include "hpack.h"
 
 class HttpServer : public Module, public HttpSource {
 private:
@@ -42,7 +48,10 @@ private:
         boost::asio::strand _strand;
         boost::asio::deadline_timer _read_timer;
         boost::asio::deadline_timer _write_timer;
-        boost::asio::ip::tcp::socket _socket;
+        boost::asio::deadline_timer _decode_timer;
+        // handshakes run on the TLS threads, away from the sessions already established
+        boost::asio::strand _handshake_strand;
+        ClientStream _stream;
         boost::asio::streambuf _read_buffer;
         char _write_buffer[global::DEFAULT_BUFFER_SIZE];
 
@@ -52,7 +61,7 @@ private:
         std::chrono::steady_clock::time_point _start;
 
     public:
-        HttpSession(HttpServer &http_server, boost::asio::ip::tcp::socket &&socket);
+        HttpSession(HttpServer &http_server, ClientStream &&stream);
 
         ~HttpSession();
 
@@ -62,7 +71,13 @@ private:
 
         void notify();
 
+        void handshake();
+
     private:
+        void handshake_handler(const boost::system::error_code &err);
+
+        void handshake_timer_handler(const boost::system::error_code &err);
+
         void read_request_header();
 
         void read_request_header_handler(const boost::system::error_code &err, size_t bytes_transferred);
@@ -77,6 +92,20 @@ private:
 
         void write_response();
 
+        bool wants_http2_upgrade();
+
+        void upgrade_to_http2();
+
+        void upgrade_to_http2_handler(const boost::system::error_code &err, size_t bytes_transferred, const std::shared_ptr<std::string> &response);
+
+        void start_http2();
+
+        void decode_response();
+
+        void decode_body(const std::shared_ptr<SeekableRawStream> &input, const std::shared_ptr<SeekableRawStream> &output, size_t pos,
+                         bool chunked_output, const std::shared_ptr<ChunkedDecoder> &chunked_decoder,
+                         const std::shared_ptr<GzipDecoder> &gzip_decoder);
+
         void write_response_header();
 
         void write_response_header_handler(const boost::system::error_code &err, size_t bytes_transferred);
@@ -89,12 +118,146 @@ private:
         void timer_handler(const boost::system::error_code &err);
     };
 
+    // HTTP/2 connection, each of its streams goes to the sink as an HTTP/1.1 request
+    class Http2Session : public std::enable_shared_from_this<Http2Session> {
+    private:
+        struct Stream {
+            std::shared_ptr<HttpRequest> http_request;
+            std::shared_ptr<HttpResponse> http_response;
+            std::chrono::steady_clock::time_point start;
+            bool headers_sent = false;
+            // position in the raw stream of the response and payload read but not sent yet
+            size_t pos = 0;
+            std::string pending;
+            bool body_completed = false;
+            std::shared_ptr<ChunkedDecoder> chunked_decoder;
+            std::shared_ptr<GzipDecoder> gzip_decoder;
+            long send_window;
+            size_t sent_bytes = 0;
+            uint32_t dependency = 0;
+            uint16_t weight = 16;
+            // request body without content-length, given to the sink with the chunked transfer coding
+            bool chunked_request = false;
+        };
+
+#ifndef NDEBUG
+        static std::atomic<size_t> count;
+#endif
+
+        HttpServer &_http_server;
+
+        boost::asio::strand _strand;
+        boost::asio::deadline_timer _send_timer;
+        boost::asio::deadline_timer _idle_timer;
+        ClientStream _stream;
+        char _read_buffer[global::DEFAULT_BUFFER_SIZE];
+        // received bytes not parsed yet, frames to be written and frames being written
+        std::string _input;
+        std::string _output;
+        std::string _writing;
+        bool _preface_received = false;
+        bool _send_scheduled = false;
+        bool _goaway_received = false;
+        bool _closing = false;
+        bool _closed = false;
+
+        HpackDecoder _hpack_decoder;
+        HpackEncoder _hpack_encoder;
+        std::map<uint32_t, Stream> _streams;
+        std::unordered_map<std::shared_ptr<HttpRequest>, uint32_t> _stream_ids;
+        uint32_t _last_stream_id = 0;
+        // header block being received in CONTINUATION frames
+        uint32_t _continuation_stream_id = 0;
+        uint8_t _continuation_flags = 0;
+        std::string _header_block;
+        std::string _header_priority;
+
+        // settings of the peer and flow control window of the connection
+        long _send_window;
+        long _initial_window_size;
+        size_t _max_frame_size;
+
+    public:
+        Http2Session(HttpServer &http_server, ClientStream &&stream, const std::string &received);
+
+        ~Http2Session();
+
+        // the preface must be the first bytes received
+        void start();
+
+        // for a connection upgraded from HTTP/1.1, the request becomes stream 1
+        void start(const std::shared_ptr<HttpRequest> &http_request, const std::string &http2_settings);
+
+        void setHttpResponse(const std::shared_ptr<HttpRequest> &http_request, const std::shared_ptr<HttpResponse> &http_response);
+
+    private:
+        void read();
+
+        void read_handler(const boost::system::error_code &err, size_t bytes_transferred);
+
+        void idle_timer_handler(const boost::system::error_code &err);
+
+        bool process_frames();
+
+        // frame handlers return the error code of a connection error, 0 if there is none
+        uint32_t process_headers(uint32_t stream_id, uint8_t flags, const std::string &payload);
+
+        uint32_t process_header_block(uint32_t stream_id, uint8_t flags);
+
+        uint32_t process_data(uint32_t stream_id, uint8_t flags, const std::string &payload);
+
+        uint32_t process_settings(uint8_t flags, const std::string &payload);
+
+        uint32_t apply_settings(const std::string &payload);
+
+        uint32_t process_window_update(uint32_t stream_id, const std::string &payload);
+
+        void process_priority(uint32_t stream_id, const char *payload);
+
+        void open_stream(uint32_t stream_id, const std::shared_ptr<HttpRequest> &http_request);
+
+        void attach_response(const std::shared_ptr<HttpRequest> &http_request, const std::shared_ptr<HttpResponse> &http_response);
+
+        void send_responses();
+
+        void send_timer_handler(const boost::system::error_code &err);
+
+        void send_headers(uint32_t stream_id, Stream &stream);
+
+        bool fill_pending(Stream &stream);
+
+        bool is_blocked(const Stream &stream);
+
+        void close_stream(uint32_t stream_id, uint32_t error_code);
+
+        void send_frame(uint8_t type, uint8_t flags, uint32_t stream_id, const std::string &payload);
+
+        void flush();
+
+        void write_handler(const boost::system::error_code &err, size_t bytes_transferred);
+
+        void connection_error(uint32_t error_code);
+
+        void close();
+
+        static std::shared_ptr<HttpResponse> make_response(const std::string &status_code, const std::string &reason, const std::string &body);
+    };
+
     std::mutex _map_mutex;
     std::unordered_map<std::shared_ptr<HttpRequest>, std::weak_ptr<HttpSession>> _waiting_sessions;
+    std::unordered_map<std::shared_ptr<HttpRequest>, std::weak_ptr<Http2Session>> _waiting_streams;
 
     boost::asio::ip::tcp::acceptor _acceptor;
     boost::asio::ip::tcp::socket _acceptor_socket;
 
+    std::unique_ptr<boost::asio::ssl::context> _tls_context;
+    std::unique_ptr<boost::asio::ip::tcp::acceptor> _tls_acceptor;
+    // ALPN protocols in wire format, by order of preference
+    std::string _alpn_protocols;
+    boost::asio::io_service _tls_ios;
+    std::unique_ptr<boost::asio::io_service::work> _tls_ios_work;
+    boost::thread_group _tls_thread_pool;
+
     std::mutex _file_mutex;
     std::ofstream _file;
     std::chrono::steady_clock::time_point _start;
@@ -102,17 +265,32 @@ private:
 public:
     explicit HttpServer(unsigned short port = 8080, size_t concurrency = 1);
 
-    ~HttpServer() override = default;
+    ~HttpServer() override;
 
     void run() override;
 
+    // must be called before start(), ciphers are the OpenSSL cipher list for TLS 1.2 and below, defaults if empty
+    void enableTls(unsigned short port, const std::string &certificate_chain_file, const std::string &private_key_file,
+                   const std::string &ciphers = std::string());
+
     void accept();
 
+    void acceptTls();
+
     void fromHttpSink(const std::shared_ptr<HttpRequest> &http_request, const std::shared_ptr<HttpResponse> &http_response) override;
 
     void log(const std::string &line);
 private:
     void accept_handler(const boost::system::error_code &err);
 
+    void accept_tls_handler(const std::shared_ptr<ClientStream> &stream, const boost::system::error_code &err);
+
+    static bool parse_url(const std::string &url, const std::shared_ptr<HttpRequest> &http_request);
+
+    static bool accepts_encoding(const std::shared_ptr<HttpRequest> &http_request, const std::string &encoding);
+
+    static int select_alpn(SSL *ssl, const unsigned char **out, unsigned char *out_length, const unsigned char *in,
+                           unsigned int in_length, void *arg);
+
     void fromHttpSinkHandler(const std::shared_ptr<HttpRequest> &http_request, const std::shared_ptr<HttpResponse> &http_response);
 };
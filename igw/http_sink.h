@@ -29,6 +29,9 @@ protected:
 public:
     virtual void fromHttpSource(const std::shared_ptr<HttpRequest> &http_request) = 0;
 
+    // the client of this request is gone, its response is no longer needed
+    virtual void cancelFromHttpSource(const std::shared_ptr<HttpRequest> &http_request) = 0;
+
     void attachHttpSource(HttpSource *http_source) {
         _http_source = http_source;
     }
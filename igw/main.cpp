@@ -16,6 +16,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <iostream>
 #include <csignal>
+#include <vector>
 
 #include "http_server.h"
 #include "http_ndn_interpreter.h"
@@ -32,6 +33,14 @@ static void signal_handler(int signum) {
 int main(int argc, char *argv[]) {
     unsigned short port = 8080;
     ndn::Name prefix("/http/iGW/");
+    bool serve_stale = false;
+    bool batching = false;
+    std::string routes_file;
+    std::vector<std::pair<ndn::Name, size_t>> egws;
+    unsigned short tls_port = 0;
+    std::string certificate_chain_file;
+    std::string private_key_file;
+    std::string ciphers;
 
     for(int i = 1; i < argc; ++i){
         switch (argv[i][1]){
@@ -41,9 +50,41 @@ int main(int argc, char *argv[]) {
             case 'n':
                 prefix = argv[++i];
                 break;
+            case 's':
+                serve_stale = true;
+                break;
+            case 'b':
+                batching = true;
+                break;
+            case 'r':
+                routes_file = argv[++i];
+                break;
+            case 'e': {
+                // EGW_NAME[:WEIGHT], once per egw instance
+                std::string egw = argv[++i];
+                size_t colon = egw.rfind(':');
+                if (colon != std::string::npos) {
+                    egws.emplace_back(egw.substr(0, colon), std::stoul(egw.substr(colon + 1)));
+                } else {
+                    egws.emplace_back(egw, 1);
+                }
+                break;
+            }
+            case 't':
+                tls_port = (unsigned short) std::stoi(argv[++i]);
+                break;
+            case 'c':
+                certificate_chain_file = argv[++i];
+                break;
+            case 'k':
+                private_key_file = argv[++i];
+                break;
+            case 'C':
+                ciphers = argv[++i];
+                break;
             case 'h':
             default:
-                std::cout << argv[0] << " [-p PORT_NUMBER] [-n NDN_NAME]" << std::endl;
+                std::cout << argv[0] << " [-p PORT_NUMBER] [-n NDN_NAME] [-s] [-b] [-r ROUTES_FILE] [-e EGW_NAME[:WEIGHT]]... [-t TLS_PORT_NUMBER -c CERTIFICATE_CHAIN_FILE -k PRIVATE_KEY_FILE [-C CIPHERS]]" << std::endl;
                 return -1;
         }
     }
@@ -51,8 +92,14 @@ int main(int argc, char *argv[]) {
     std::cout << "HTTP/NDN ingress gateway v1.1-2" << std::endl;
 
     HttpServer http_server(port, 4);
-    HttpNdnInterpreter interpreter(2);
-    NdnResolver ndn_resolver(prefix, 4);
+    if (tls_port != 0) {
+        http_server.enableTls(tls_port, certificate_chain_file, private_key_file, ciphers);
+    }
+    HttpNdnInterpreter interpreter(2, routes_file);
+    NdnResolver ndn_resolver(prefix, 4, serve_stale, batching);
+    for (const auto &egw : egws) {
+        ndn_resolver.addEgw(egw.first, egw.second);
+    }
     NdnConsumerSubModule ndn_receiver(ndn_resolver);
     NdnProducerSubModule ndn_sender(ndn_resolver, prefix);
 
@@ -67,7 +114,11 @@ int main(int argc, char *argv[]) {
     ndn_receiver.start();
     ndn_sender.start();
 
-    std::cout << "listens on 0.0.0.0:" << port << " and registered as " << prefix << std::endl;
+    std::cout << "listens on 0.0.0.0:" << port;
+    if (tls_port != 0) {
+        std::cout << " (TLS on 0.0.0.0:" << tls_port << ")";
+    }
+    std::cout << " and registered as " << prefix << std::endl;
     signal(SIGINT, signal_handler);
 
     do {
@@ -16,12 +16,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <memory>
 #include <atomic>
+#include <chrono>
 
 #include "seekable_raw_stream.h"
 
 class Message {
 protected:
     std::shared_ptr<SeekableRawStream> _raw_stream;
+    // time after which nobody waits for this message anymore
+    std::chrono::steady_clock::time_point _deadline {std::chrono::steady_clock::time_point::max()};
 
 public:
     Message() : _raw_stream(std::make_shared<SeekableRawStream>()) {
@@ -41,4 +44,12 @@ public:
     void setRawStream(const std::shared_ptr<SeekableRawStream> &raw_stream) {
         _raw_stream = raw_stream;
     }
+
+    const std::chrono::steady_clock::time_point& getDeadline() const {
+        return _deadline;
+    }
+
+    void setDeadline(const std::chrono::steady_clock::time_point &deadline) {
+        _deadline = deadline;
+    }
 };
\ No newline at end of file
@@ -16,7 +16,33 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <ndn-cxx/name.hpp>
 
+#include <chrono>
+
+#include "byte_range.h"
+
 class NdnConsumer {
 public:
-    virtual void retrieve(const ndn::Name &name) = 0;
+    // the deadline bounds the lifetime of the Interests sent for the first segment,
+    // a stale copy from a content store is accepted when must_be_fresh is false,
+    // only the segments covering a valid byte range are retrieved after the first one,
+    // a forwarding hint sends every Interest to the egw instance with this prefix
+    virtual void retrieve(const ndn::Name &name, const std::chrono::steady_clock::time_point &deadline, bool must_be_fresh,
+                          const ByteRange &byte_range, const ndn::Name &forwarding_hint) = 0;
+
+    void retrieve(const ndn::Name &name, const std::chrono::steady_clock::time_point &deadline, bool must_be_fresh,
+                  const ByteRange &byte_range) {
+        retrieve(name, deadline, must_be_fresh, byte_range, ndn::Name());
+    }
+
+    void retrieve(const ndn::Name &name, const std::chrono::steady_clock::time_point &deadline, bool must_be_fresh) {
+        retrieve(name, deadline, must_be_fresh, ByteRange());
+    }
+
+    void retrieve(const ndn::Name &name, const std::chrono::steady_clock::time_point &deadline) {
+        retrieve(name, deadline, true);
+    }
+
+    void retrieve(const ndn::Name &name) {
+        retrieve(name, std::chrono::steady_clock::time_point::max(), true);
+    }
 };
\ No newline at end of file
@@ -14,6 +14,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "ndn_content.h"
 
+#include <cstdlib>
+
+#include "global.h"
+
 NdnContent::NdnContent(const std::shared_ptr<SeekableRawStream> &raw_stream) : Message(raw_stream), _last_access(std::chrono::steady_clock::now()){
 
 }
@@ -34,6 +38,14 @@ void NdnContent::setFreshness(const ndn::time::milliseconds& freshness) {
     _freshness = freshness;
 }
 
+const ndn::time::milliseconds& NdnContent::getStaleWindow() const {
+    return _stale_window;
+}
+
+void NdnContent::setStaleWindow(const ndn::time::milliseconds &stale_window) {
+    _stale_window = stale_window;
+}
+
 const ndn::time::system_clock::time_point& NdnContent::getTimestamp() const {
     return _timestamp;
 }
@@ -42,6 +54,14 @@ void NdnContent::setTimestamp(const ndn::time::system_clock::time_point& timesta
     _timestamp = timestamp;
 }
 
+const std::chrono::steady_clock::time_point& NdnContent::getCreation() const {
+    return _creation;
+}
+
+bool NdnContent::isStale() const {
+    return _creation + std::chrono::milliseconds(_freshness.count()) <= std::chrono::steady_clock::now();
+}
+
 const std::chrono::steady_clock::time_point& NdnContent::getLastAccess() const {
     return _last_access;
 }
@@ -50,6 +70,107 @@ void NdnContent::refresh() {
     _last_access = std::chrono::steady_clock::now();
 }
 
+const ByteRange& NdnContent::getByteRange() const {
+    return _byte_range;
+}
+
+void NdnContent::setByteRange(const ByteRange &byte_range) {
+    _byte_range = byte_range;
+}
+
+bool NdnContent::isRouted() const {
+    return _routed;
+}
+
+void NdnContent::setRouted(bool routed) {
+    _routed = routed;
+}
+
+bool NdnContent::isCongested() const {
+    return _congested;
+}
+
+void NdnContent::setCongested(bool congested) {
+    _congested = congested;
+}
+
+bool NdnContent::isUnresponsive() const {
+    return _unresponsive;
+}
+
+void NdnContent::setUnresponsive(bool unresponsive) {
+    _unresponsive = unresponsive;
+}
+
+bool NdnContent::isRefresh() const {
+    return _refresh;
+}
+
+void NdnContent::setRefresh(bool refresh) {
+    _refresh = refresh;
+}
+
+const ndn::Name& NdnContent::getForwardingHint() const {
+    return _forwarding_hint;
+}
+
+void NdnContent::setForwardingHint(const ndn::Name &forwarding_hint) {
+    _forwarding_hint = forwarding_hint;
+}
+
+uint64_t NdnContent::getOffset(uint64_t segment) const {
+    auto it = _offsets.upper_bound(segment);
+    if (it == _offsets.begin()) {
+        return segment * global::DEFAULT_BUFFER_SIZE;
+    }
+    --it;
+    return it->second + (segment - it->first) * global::DEFAULT_BUFFER_SIZE;
+}
+
+void NdnContent::setOffset(uint64_t segment, uint64_t offset) {
+    _offsets[segment] = offset;
+}
+
+bool NdnContent::isFlushDue(uint64_t offset, const std::chrono::milliseconds &delay) {
+    auto time_point = std::chrono::steady_clock::now();
+    if (_flush_offset != offset) {
+        _flush_offset = offset;
+        _flush_since = time_point;
+    }
+    return _flush_since + delay <= time_point;
+}
+
+bool NdnContent::isChunkList() const {
+    return _chunk_list;
+}
+
+bool NdnContent::isChunkListCompleted() const {
+    return _chunk_list_completed;
+}
+
+void NdnContent::appendChunkList(const std::string &chunk_list, bool completed) {
+    _chunk_list = true;
+    _chunk_list_completed = completed;
+    _pending_chunks += chunk_list;
+}
+
+bool NdnContent::nextChunk(std::string &digest, size_t &size) {
+    size_t line_end = _pending_chunks.find('\n');
+    if (line_end == std::string::npos) {
+        return false;
+    }
+    size_t delimiter_index = _pending_chunks.find(' ');
+    digest = _pending_chunks.substr(0, delimiter_index);
+    size = delimiter_index < line_end ? std::strtoul(_pending_chunks.c_str() + delimiter_index + 1, nullptr, 10) : 0;
+    _pending_chunks.erase(0, line_end + 1);
+    ++_chunk_count;
+    return true;
+}
+
+size_t NdnContent::getChunkCount() const {
+    return _chunk_count;
+}
+
 bool NdnContent::addData(uint64_t segment, std::shared_ptr<ndn::Data> data) {
     refresh();
     return _datas.emplace(segment, data).second;
@@ -17,18 +17,46 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <ndn-cxx/data.hpp>
 
 #include <memory>
+#include <limits>
 
 #include "message.h"
 #include "seekable_raw_stream.h"
+#include "byte_range.h"
 
 class NdnContent : public Message {
 private:
     ndn::Name _name;
     ndn::time::milliseconds _freshness{0};
+    // time after the freshness during which the content may still be served while it is refreshed
+    ndn::time::milliseconds _stale_window{0};
     ndn::time::system_clock::time_point _timestamp;
 
+    std::chrono::steady_clock::time_point _creation {std::chrono::steady_clock::now()};
     std::chrono::steady_clock::time_point _last_access;
     std::map<uint64_t, std::shared_ptr<ndn::Data>> _datas;
+    // raw offset of the first byte of each segment, a segment is shorter than DEFAULT_BUFFER_SIZE when it is flushed early
+    std::map<uint64_t, uint64_t> _offsets;
+    // bytes waiting for a segment to be filled, since when they wait
+    uint64_t _flush_offset {std::numeric_limits<uint64_t>::max()};
+    std::chrono::steady_clock::time_point _flush_since;
+    // only the segments covering the range are retrieved when it can be resolved
+    ByteRange _byte_range;
+    // named under the prefix of a native NDN server instead of the egw namespace
+    bool _routed {false};
+    // the egw refused the notification with a congestion Nack
+    bool _congested {false};
+    // an Interest ran the default lifetime without answer or got a Nack for another reason than congestion,
+    // which a client deadline cutting the lifetime of the Interests short can't explain
+    bool _unresponsive {false};
+    // the egw retrieves a stale content again instead of serving its copy
+    bool _refresh {false};
+    // prefix of the egw instance chosen for the request, empty if any egw may answer
+    ndn::Name _forwarding_hint;
+    // lines of "<digest> <size>" of a response published as a list of chunks, not retrieved yet
+    bool _chunk_list {false};
+    bool _chunk_list_completed {false};
+    std::string _pending_chunks;
+    size_t _chunk_count {0};
 
 public:
     NdnContent() = default;
@@ -45,14 +73,68 @@ public:
 
     void setFreshness(const ndn::time::milliseconds &freshness);
 
+    const ndn::time::milliseconds& getStaleWindow() const;
+
+    void setStaleWindow(const ndn::time::milliseconds &stale_window);
+
     const ndn::time::system_clock::time_point& getTimestamp() const;
 
     void setTimestamp(const ndn::time::system_clock::time_point &freshness);
 
+    const std::chrono::steady_clock::time_point& getCreation() const;
+
+    // true once the freshness period elapsed since the creation
+    bool isStale() const;
+
     const std::chrono::steady_clock::time_point& getLastAccess() const;
 
     void refresh();
 
+    const ByteRange& getByteRange() const;
+
+    void setByteRange(const ByteRange &byte_range);
+
+    bool isRouted() const;
+
+    void setRouted(bool routed);
+
+    bool isCongested() const;
+
+    void setCongested(bool congested);
+
+    bool isUnresponsive() const;
+
+    void setUnresponsive(bool unresponsive);
+
+    bool isRefresh() const;
+
+    void setRefresh(bool refresh);
+
+    const ndn::Name& getForwardingHint() const;
+
+    void setForwardingHint(const ndn::Name &forwarding_hint);
+
+    // segments after the last known offset are assumed to be full
+    uint64_t getOffset(uint64_t segment) const;
+
+    void setOffset(uint64_t segment, uint64_t offset);
+
+    // true once the bytes from offset have waited for delay without filling a segment
+    bool isFlushDue(uint64_t offset, const std::chrono::milliseconds &delay);
+
+    bool isChunkList() const;
+
+    // true once the last segment of the chunk list is received
+    bool isChunkListCompleted() const;
+
+    void appendChunkList(const std::string &chunk_list, bool completed);
+
+    // takes the next chunk of the list, false if the list doesn't hold a whole line yet
+    bool nextChunk(std::string &digest, size_t &size);
+
+    // number of chunks taken from the list
+    size_t getChunkCount() const;
+
     bool addData(uint64_t segment, std::shared_ptr<ndn::Data> data);
 
     std::map<uint64_t, std::shared_ptr<ndn::Data>>::iterator findData(uint64_t segment);
@@ -15,12 +15,30 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "ndn_receiver.h"
 
 #include <ndn-cxx/transport/tcp-transport.hpp>
+#include <ndn-cxx/encoding/block-helpers.hpp>
+
+#include <algorithm>
+#include <sstream>
+
+#include "global.h"
+#include "fec_codec.h"
+#include "sha256.h"
 
 static const ndn::time::milliseconds INTERESTDEFAULTLIFETIME {1500};
 
+static ndn::time::milliseconds boundLifetime(const std::shared_ptr<NdnContent> &content, const ndn::time::milliseconds &lifetime) {
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(content->getDeadline() - std::chrono::steady_clock::now());
+    return std::max(std::min(lifetime, ndn::time::milliseconds(remaining.count())), ndn::time::milliseconds(0));
+}
+
 NdnConsumerSubModule::NdnConsumerSubModule(OffloadedNdnConsumer &parent)
+        : NdnConsumerSubModule(parent, std::make_shared<ndn::TcpTransport>("127.0.0.1", "6363")) {
+
+}
+
+NdnConsumerSubModule::NdnConsumerSubModule(OffloadedNdnConsumer &parent, const std::shared_ptr<ndn::Transport> &transport)
         : SubModule(1, parent)
-        , _face(std::make_shared<ndn::TcpTransport>("127.0.0.1", "6363"), _ios) {
+        , _face(transport, _ios) {
     _parent.attachNdnConsumer(this);
 }
 
@@ -28,35 +46,91 @@ void NdnConsumerSubModule::run() {
 
 }
 
-void NdnConsumerSubModule::retrieve(const ndn::Name &name) {
-    _ios.post(boost::bind(&NdnConsumerSubModule::retrieveHandler, this, name));
+void NdnConsumerSubModule::retrieve(const ndn::Name &name, const std::chrono::steady_clock::time_point &deadline, bool must_be_fresh,
+                                    const ByteRange &byte_range, const ndn::Name &forwarding_hint) {
+    _ios.post(boost::bind(&NdnConsumerSubModule::retrieveHandler, this, name, deadline, must_be_fresh, byte_range, forwarding_hint));
 }
 
-void NdnConsumerSubModule::retrieveHandler(const ndn::Name &name) {
+void NdnConsumerSubModule::retrieveHandler(const ndn::Name &name, const std::chrono::steady_clock::time_point &deadline, bool must_be_fresh,
+                                           const ByteRange &byte_range, const ndn::Name &forwarding_hint) {
     auto content = std::make_shared<NdnContent>();
     content->setName(name);
-    _face.expressInterest(ndn::Interest(name, INTERESTDEFAULTLIFETIME).setMustBeFresh(true),
-                          boost::bind(&NdnConsumerSubModule::onData, this, _1, _2, content, 0),
-                          boost::bind(&NdnConsumerSubModule::onNack, this, _1, _2, content),
-                          boost::bind(&NdnConsumerSubModule::onTimeout, this, _1, content, 0, 2));
+    content->setDeadline(deadline);
+    content->setByteRange(byte_range);
+    content->setForwardingHint(forwarding_hint);
+    ndn::time::milliseconds lifetime = boundLifetime(content, INTERESTDEFAULTLIFETIME);
+    if (lifetime.count() == 0) {
+        content->getRawStream()->is_aborted(true);
+        _parent.fromNdnConsumer(content);
+        return;
+    }
+    expressInterest(content, ndn::Interest(name, lifetime).setMustBeFresh(must_be_fresh),
+                             boost::bind(&NdnConsumerSubModule::onData, this, _1, _2, content, 0),
+                             boost::bind(&NdnConsumerSubModule::onNack, this, _1, _2, content),
+                             boost::bind(&NdnConsumerSubModule::onTimeout, this, _1, content, 0, 2));
 }
 
 void NdnConsumerSubModule::onData(const ndn::Interest &interest, const ndn::Data &data, const std::shared_ptr<NdnContent> &content, size_t seg) {
+    if (content->getRawStream()->is_aborted()) {
+        // nobody needs the remaining segments
+        return;
+    }
     if(data.getName().get(-1).isSegment() && data.getName().get(-1).toSegment() != seg) {
         // if here => library problem, only appear for 1st packet
-        _face.expressInterest(ndn::Interest(data.getName().getPrefix(-1).appendSegment(seg), INTERESTDEFAULTLIFETIME).setMustBeFresh(true),
-                              boost::bind(&NdnConsumerSubModule::onData, this, _1, _2, content, seg),
-                              boost::bind(&NdnConsumerSubModule::onNack, this, _1, _2, content),
-                              boost::bind(&NdnConsumerSubModule::onTimeout, this, _1, content, seg, 2));
+        expressInterest(content, ndn::Interest(data.getName().getPrefix(-1).appendSegment(seg), INTERESTDEFAULTLIFETIME).setMustBeFresh(interest.getMustBeFresh()),
+                                 boost::bind(&NdnConsumerSubModule::onData, this, _1, _2, content, seg),
+                                 boost::bind(&NdnConsumerSubModule::onNack, this, _1, _2, content),
+                                 boost::bind(&NdnConsumerSubModule::onTimeout, this, _1, content, seg, 2));
     } else {
-        content->getRawStream()->append_raw_data((const char *) data.getContent().value(), data.getContent().value_size());
-        if (data.getFinalBlockId().empty()) {
-            _face.expressInterest(ndn::Interest(ndn::Name(data.getName().getPrefix(-1)).appendSegment(seg + 1), INTERESTDEFAULTLIFETIME).setMustBeFresh(true),
-                                  boost::bind(&NdnConsumerSubModule::onData, this, _1, _2, content, seg + 1),
-                                  boost::bind(&NdnConsumerSubModule::onNack, this, _1, _2, content),
-                                  boost::bind(&NdnConsumerSubModule::onTimeout, this, _1, content, seg + 1, 2));
-        } else {
-            content->getRawStream()->is_completed(true);
+        if (seg == 0) {
+            content->setFreshness(data.getFreshnessPeriod());
+        }
+        if (data.getMetaInfo().findAppMetaInfo(global::TLV_CHUNK_LIST) != nullptr) {
+            // the response is made of chunks named by their digest, the segments only list them
+            content->appendChunkList(std::string((const char *) data.getContent().value(), data.getContent().value_size()),
+                                     !data.getFinalBlockId().empty());
+            retrieveChunk(data.getName().getPrefix(-1), content, seg + 1, interest.getMustBeFresh());
+            return;
+        }
+        auto digest_block = data.getMetaInfo().findAppMetaInfo(global::TLV_BODY_DIGEST);
+        if (digest_block != nullptr) {
+            // the segments only hold the header, the body is published under its digest and may come from another URL
+            content->getRawStream()->append_raw_data((const char *) data.getContent().value(), data.getContent().value_size());
+            if (data.getFinalBlockId().empty()) {
+                expressInterest(content, ndn::Interest(ndn::Name(data.getName().getPrefix(-1)).appendSegment(seg + 1), INTERESTDEFAULTLIFETIME).setMustBeFresh(interest.getMustBeFresh()),
+                                         boost::bind(&NdnConsumerSubModule::onData, this, _1, _2, content, seg + 1),
+                                         boost::bind(&NdnConsumerSubModule::onNack, this, _1, _2, content),
+                                         boost::bind(&NdnConsumerSubModule::onTimeout, this, _1, content, seg + 1, 2));
+            } else {
+                // held back from the client until the whole body matches its digest
+                std::shared_ptr<std::string> body = std::make_shared<std::string>();
+                ndn::Name name(data.getName().getPrefix(1));
+                name.append(global::BODY_NAMESPACE).append(ndn::readString(*digest_block));
+                // a body never changes, any cached copy is valid
+                expressInterest(content, ndn::Interest(name, INTERESTDEFAULTLIFETIME).setMustBeFresh(false),
+                                         boost::bind(&NdnConsumerSubModule::onBody, this, _1, _2, content, body, 0),
+                                         boost::bind(&NdnConsumerSubModule::onNack, this, _1, _2, content),
+                                         boost::bind(&NdnConsumerSubModule::onBodyTimeout, this, _1, content, body, 0, 2));
+            }
+            if (seg == 0) {
+                _parent.fromNdnConsumer(content);
+            }
+            return;
+        }
+        uint64_t next_seg = appendSegment(data, content, seg);
+        if (seg == 0 && !content->getRawStream()->is_completed() && !content->getByteRange().isResolved() &&
+                data.getMetaInfo().findAppMetaInfo(global::TLV_FEC) != nullptr) {
+            // the rest is retrieved by blocks, a lost segment is rebuilt from the repairs of its block instead of waiting for a timeout
+            auto block = std::make_shared<FecBlock>(0);
+            block->segments[0] = std::string((const char *) data.getContent().value(), data.getContent().value_size());
+            block->received[0] = true;
+            block->appended = 1;
+            retrieveBlock(data.getName().getPrefix(-1), content, block, interest.getMustBeFresh());
+        } else if (!content->getRawStream()->is_completed()) {
+            expressInterest(content, ndn::Interest(ndn::Name(data.getName().getPrefix(-1)).appendSegment(next_seg), INTERESTDEFAULTLIFETIME).setMustBeFresh(interest.getMustBeFresh()),
+                                     boost::bind(&NdnConsumerSubModule::onData, this, _1, _2, content, next_seg),
+                                     boost::bind(&NdnConsumerSubModule::onNack, this, _1, _2, content),
+                                     boost::bind(&NdnConsumerSubModule::onTimeout, this, _1, content, next_seg, 2));
         }
         if (!interest.getName().get(-1).isSegment() || interest.getName().get(-1).toSegment() == 0) {
             _parent.fromNdnConsumer(content);
@@ -64,17 +138,355 @@ void NdnConsumerSubModule::onData(const ndn::Interest &interest, const ndn::Data
     }
 }
 
+uint64_t NdnConsumerSubModule::appendSegment(const ndn::Data &data, const std::shared_ptr<NdnContent> &content, uint64_t seg) {
+    auto value = (const char *) data.getContent().value();
+    size_t size = data.getContent().value_size();
+    if (seg == 0 && content->getByteRange().isValid()) {
+        // the first segment holds the header of the response, which tells where the range is
+        ByteRange byte_range = content->getByteRange();
+        if (byte_range.resolve(std::string(value, size))) {
+            content->setByteRange(byte_range);
+        }
+    }
+
+    // producers give the raw offset of every segment since they may be shorter than DEFAULT_BUFFER_SIZE
+    uint64_t offset = content->getOffset(seg);
+    auto offset_block = data.getMetaInfo().findAppMetaInfo(global::TLV_SEGMENT_OFFSET);
+    if (offset_block != nullptr) {
+        offset = ndn::readNonNegativeInteger(*offset_block);
+    }
+    content->setOffset(seg, offset);
+    content->setOffset(seg + 1, offset + size);
+
+    const ByteRange &byte_range = content->getByteRange();
+    if (!byte_range.isResolved()) {
+        content->getRawStream()->append_raw_data(value, size);
+        if (!data.getFinalBlockId().empty()) {
+            content->getRawStream()->is_completed(true);
+        }
+        return seg + 1;
+    }
+
+    uint64_t begin = byte_range.getHeaderLength() + byte_range.getFirst();
+    uint64_t end = byte_range.getHeaderLength() + byte_range.getLast() + 1;
+    if (seg == 0) {
+        content->getRawStream()->append_raw_data(value, byte_range.getHeaderLength());
+    }
+    uint64_t from = std::max(begin, offset);
+    uint64_t to = std::min(end, offset + size);
+    if (from < to) {
+        content->getRawStream()->append_raw_data(value + (from - offset), to - from);
+    }
+    if (!data.getFinalBlockId().empty() || end <= offset + size) {
+        content->getRawStream()->is_completed(true);
+    }
+    // no segment is longer than DEFAULT_BUFFER_SIZE, skipping that many bytes per segment never goes past the range
+    return begin > offset + size ? seg + 1 + (begin - offset - size) / global::DEFAULT_BUFFER_SIZE : seg + 1;
+}
+
+void NdnConsumerSubModule::retrieveChunk(const ndn::Name &list_name, const std::shared_ptr<NdnContent> &content, uint64_t next_seg, bool must_be_fresh) {
+    std::string digest;
+    size_t size;
+    if (content->nextChunk(digest, size)) {
+        ndn::Name name(list_name.getPrefix(1));
+        name.append(global::CHUNK_NAMESPACE).append(digest);
+        // a chunk never changes, any cached copy is valid
+        expressInterest(content, ndn::Interest(name, INTERESTDEFAULTLIFETIME).setMustBeFresh(false),
+                                 boost::bind(&NdnConsumerSubModule::onChunk, this, _1, _2, content, list_name, next_seg, must_be_fresh),
+                                 boost::bind(&NdnConsumerSubModule::onNack, this, _1, _2, content),
+                                 boost::bind(&NdnConsumerSubModule::onChunkTimeout, this, _1, content, list_name, next_seg, must_be_fresh, 2));
+    } else if (content->isChunkListCompleted()) {
+        content->getRawStream()->is_completed(true);
+        if (content->getChunkCount() == 0) {
+            _parent.fromNdnConsumer(content);
+        }
+    } else {
+        expressInterest(content, ndn::Interest(ndn::Name(list_name).appendSegment(next_seg), INTERESTDEFAULTLIFETIME).setMustBeFresh(must_be_fresh),
+                                 boost::bind(&NdnConsumerSubModule::onData, this, _1, _2, content, next_seg),
+                                 boost::bind(&NdnConsumerSubModule::onNack, this, _1, _2, content),
+                                 boost::bind(&NdnConsumerSubModule::onTimeout, this, _1, content, next_seg, 2));
+    }
+}
+
+void NdnConsumerSubModule::onChunk(const ndn::Interest &interest, const ndn::Data &data, const std::shared_ptr<NdnContent> &content,
+                                   const ndn::Name &list_name, uint64_t next_seg, bool must_be_fresh) {
+    if (content->getRawStream()->is_aborted()) {
+        return;
+    }
+    // caches are trusted with the bytes only if they match the digest in the name
+    if (Sha256::hex(data.getContent().value(), data.getContent().value_size()) != interest.getName().get(-1).toUri()) {
+        content->getRawStream()->is_aborted(true);
+        if (isFirstDelivery(interest, content)) {
+            _parent.fromNdnConsumer(content);
+        }
+        std::cerr << interest.getName() << " doesn't match its digest" << std::endl;
+        return;
+    }
+    content->getRawStream()->append_raw_data((const char *) data.getContent().value(), data.getContent().value_size());
+    retrieveChunk(list_name, content, next_seg, must_be_fresh);
+    if (content->getChunkCount() == 1) {
+        // the first chunk holds the header of the response
+        _parent.fromNdnConsumer(content);
+    }
+}
+
+void NdnConsumerSubModule::onChunkTimeout(const ndn::Interest &interest, const std::shared_ptr<NdnContent> &content, const ndn::Name &list_name,
+                                          uint64_t next_seg, bool must_be_fresh, size_t remaining_tries) {
+    if (content->getRawStream()->is_aborted()) {
+        return;
+    }
+    ndn::time::milliseconds lifetime = interest.getInterestLifetime() * 2;
+    if (content->getChunkCount() == 1) {
+        lifetime = boundLifetime(content, lifetime);
+    }
+    if (remaining_tries > 0 && lifetime.count() > 0) {
+        ndn::Interest i(interest);
+        i.setInterestLifetime(lifetime);
+        i.refreshNonce();
+        expressInterest(content, i, boost::bind(&NdnConsumerSubModule::onChunk, this, _1, _2, content, list_name, next_seg, must_be_fresh),
+                                 boost::bind(&NdnConsumerSubModule::onNack, this, _1, _2, content),
+                                 boost::bind(&NdnConsumerSubModule::onChunkTimeout, this, _1, content, list_name, next_seg, must_be_fresh, remaining_tries - 1));
+    } else {
+        content->getRawStream()->is_aborted(true);
+        if (isFirstDelivery(interest, content)) {
+            _parent.fromNdnConsumer(content);
+        }
+        std::cout << interest.getName() << " unreachable" << std::endl;
+    }
+}
+
+void NdnConsumerSubModule::onBody(const ndn::Interest &interest, const ndn::Data &data, const std::shared_ptr<NdnContent> &content,
+                                  const std::shared_ptr<std::string> &body, uint64_t seg) {
+    if (content->getRawStream()->is_aborted()) {
+        return;
+    }
+    if (!data.getName().get(-1).isSegment() || data.getName().get(-1).toSegment() != seg) {
+        expressInterest(content, ndn::Interest(data.getName().getPrefix(-1).appendSegment(seg), INTERESTDEFAULTLIFETIME).setMustBeFresh(false),
+                                 boost::bind(&NdnConsumerSubModule::onBody, this, _1, _2, content, body, seg),
+                                 boost::bind(&NdnConsumerSubModule::onNack, this, _1, _2, content),
+                                 boost::bind(&NdnConsumerSubModule::onBodyTimeout, this, _1, content, body, seg, 2));
+        return;
+    }
+    body->append((const char *) data.getContent().value(), data.getContent().value_size());
+    if (data.getFinalBlockId().empty()) {
+        expressInterest(content, ndn::Interest(data.getName().getPrefix(-1).appendSegment(seg + 1), INTERESTDEFAULTLIFETIME).setMustBeFresh(false),
+                                 boost::bind(&NdnConsumerSubModule::onBody, this, _1, _2, content, body, seg + 1),
+                                 boost::bind(&NdnConsumerSubModule::onNack, this, _1, _2, content),
+                                 boost::bind(&NdnConsumerSubModule::onBodyTimeout, this, _1, content, body, seg + 1, 2));
+        return;
+    }
+
+    // caches are trusted with the body only if it matches the digest in its name
+    if (Sha256::hex(body->data(), body->size()) != data.getName().get(-3).toUri()) {
+        content->getRawStream()->is_aborted(true);
+        std::cerr << data.getName().getPrefix(-2) << " doesn't match its digest" << std::endl;
+        return;
+    }
+    content->getRawStream()->append_raw_data(body->data(), body->size());
+    content->getRawStream()->is_completed(true);
+}
+
+void NdnConsumerSubModule::onBodyTimeout(const ndn::Interest &interest, const std::shared_ptr<NdnContent> &content,
+                                         const std::shared_ptr<std::string> &body, uint64_t seg, size_t remaining_tries) {
+    if (content->getRawStream()->is_aborted()) {
+        return;
+    }
+    if (remaining_tries > 0) {
+        ndn::Interest i(interest);
+        i.setInterestLifetime(interest.getInterestLifetime() * 2);
+        i.refreshNonce();
+        expressInterest(content, i, boost::bind(&NdnConsumerSubModule::onBody, this, _1, _2, content, body, seg),
+                                 boost::bind(&NdnConsumerSubModule::onNack, this, _1, _2, content),
+                                 boost::bind(&NdnConsumerSubModule::onBodyTimeout, this, _1, content, body, seg, remaining_tries - 1));
+    } else {
+        // the header is already given to the parent
+        content->getRawStream()->is_aborted(true);
+        std::cout << interest.getName() << " unreachable" << std::endl;
+    }
+}
+
+void NdnConsumerSubModule::retrieveBlock(const ndn::Name &prefix, const std::shared_ptr<NdnContent> &content,
+                                         const std::shared_ptr<FecBlock> &block, bool must_be_fresh) {
+    for (size_t i = block->appended; i < global::DEFAULT_FEC_BLOCK_SIZE; ++i) {
+        if (!block->received[i]) {
+            expressInterest(content, ndn::Interest(ndn::Name(prefix).appendSegment(block->index * global::DEFAULT_FEC_BLOCK_SIZE + i), INTERESTDEFAULTLIFETIME).setMustBeFresh(must_be_fresh),
+                                     boost::bind(&NdnConsumerSubModule::onBlockData, this, _1, _2, content, prefix, block, must_be_fresh, i),
+                                     boost::bind(&NdnConsumerSubModule::onBlockNack, this, _1, _2, content, block, i),
+                                     boost::bind(&NdnConsumerSubModule::onBlockTimeout, this, _1, content, prefix, block, must_be_fresh, i, 2));
+        }
+    }
+    for (size_t i = 0; i < global::DEFAULT_FEC_REPAIR_COUNT; ++i) {
+        size_t position = global::DEFAULT_FEC_BLOCK_SIZE + i;
+        expressInterest(content, ndn::Interest(ndn::Name(prefix).append(global::REPAIR_MARKER).appendNumber(block->index * global::DEFAULT_FEC_REPAIR_COUNT + i), INTERESTDEFAULTLIFETIME).setMustBeFresh(must_be_fresh),
+                                 boost::bind(&NdnConsumerSubModule::onBlockData, this, _1, _2, content, prefix, block, must_be_fresh, position),
+                                 boost::bind(&NdnConsumerSubModule::onBlockNack, this, _1, _2, content, block, position),
+                                 boost::bind(&NdnConsumerSubModule::onBlockTimeout, this, _1, content, prefix, block, must_be_fresh, position, 2));
+    }
+}
+
+void NdnConsumerSubModule::onBlockData(const ndn::Interest &interest, const ndn::Data &data, const std::shared_ptr<NdnContent> &content, const ndn::Name &prefix,
+                                       const std::shared_ptr<FecBlock> &block, bool must_be_fresh, size_t position) {
+    if (content->getRawStream()->is_aborted() || block->done) {
+        return;
+    }
+    std::string value((const char *) data.getContent().value(), data.getContent().value_size());
+    if (position < global::DEFAULT_FEC_BLOCK_SIZE) {
+        block->segments[position] = value;
+        block->received[position] = true;
+        if (!data.getFinalBlockId().empty()) {
+            block->count = position + 1;
+            block->count_known = true;
+            block->last = true;
+        } else if (position + 1 == global::DEFAULT_FEC_BLOCK_SIZE) {
+            block->count_known = true;
+        }
+    } else {
+        auto description_block = data.getMetaInfo().findAppMetaInfo(global::TLV_FEC_REPAIR);
+        if (description_block == nullptr) {
+            return;
+        }
+        // offset of the block, whether it is the last one, then the size of each of its segments
+        std::istringstream description(ndn::readString(*description_block));
+        uint64_t offset;
+        int last;
+        size_t size;
+        description >> offset >> last;
+        block->sizes.clear();
+        while (description >> size) {
+            block->sizes.push_back(size);
+        }
+        block->count = block->sizes.size();
+        block->count_known = true;
+        block->last = last != 0;
+        block->repairs[position - global::DEFAULT_FEC_BLOCK_SIZE] = value;
+    }
+    appendBlock(content, prefix, block, must_be_fresh);
+    if (!block->done && isBlockLost(block)) {
+        // a segment given up while the count was unknown turns out to be in the block
+        content->getRawStream()->is_aborted(true);
+        std::cout << prefix << " block " << block->index << " unreachable" << std::endl;
+    }
+}
+
+void NdnConsumerSubModule::appendBlock(const std::shared_ptr<NdnContent> &content, const ndn::Name &prefix,
+                                       const std::shared_ptr<FecBlock> &block, bool must_be_fresh) {
+    // segments in order go to the client right away
+    while (block->appended < block->count && block->received[block->appended]) {
+        content->getRawStream()->append_raw_data(block->segments[block->appended]);
+        ++block->appended;
+    }
+    if (block->appended < block->count && !block->sizes.empty()) {
+        std::vector<std::string> segments(block->segments.begin(), block->segments.begin() + block->count);
+        std::vector<bool> received(block->received.begin(), block->received.begin() + block->count);
+        if (FecCodec::decode(segments, received, block->repairs, block->sizes)) {
+            for (size_t i = block->appended; i < block->count; ++i) {
+                content->getRawStream()->append_raw_data(segments[i]);
+            }
+            block->appended = block->count;
+        }
+    }
+    if (block->appended == block->count) {
+        block->done = true;
+        if (block->last) {
+            content->getRawStream()->is_completed(true);
+        } else {
+            retrieveBlock(prefix, content, std::make_shared<FecBlock>(block->index + 1), must_be_fresh);
+        }
+    }
+}
+
+void NdnConsumerSubModule::onBlockTimeout(const ndn::Interest &interest, const std::shared_ptr<NdnContent> &content, const ndn::Name &prefix,
+                                          const std::shared_ptr<FecBlock> &block, bool must_be_fresh, size_t position, size_t remaining_tries) {
+    // segments after the last one never come
+    if (content->getRawStream()->is_aborted() || block->done || (position < global::DEFAULT_FEC_BLOCK_SIZE && position >= block->count)) {
+        return;
+    }
+    if (remaining_tries > 0) {
+        ndn::Interest i(interest);
+        i.setInterestLifetime(interest.getInterestLifetime() * 2);
+        i.refreshNonce();
+        expressInterest(content, i, boost::bind(&NdnConsumerSubModule::onBlockData, this, _1, _2, content, prefix, block, must_be_fresh, position),
+                                 boost::bind(&NdnConsumerSubModule::onBlockNack, this, _1, _2, content, block, position),
+                                 boost::bind(&NdnConsumerSubModule::onBlockTimeout, this, _1, content, prefix, block, must_be_fresh, position, remaining_tries - 1));
+    } else {
+        // a repair that never comes is not needed if the segments of its block do
+        block->failed[position] = true;
+        if (isBlockLost(block)) {
+            content->getRawStream()->is_aborted(true);
+            std::cout << interest.getName() << " unreachable" << std::endl;
+        }
+    }
+}
+
+void NdnConsumerSubModule::onBlockNack(const ndn::Interest &interest, const ndn::lp::Nack &nack, const std::shared_ptr<NdnContent> &content,
+                                       const std::shared_ptr<FecBlock> &block, size_t position) {
+    if (content->getRawStream()->is_aborted() || block->done) {
+        return;
+    }
+    // segments past the end of the content may get a Nack, which only matters once they are known to be in the block
+    block->failed[position] = true;
+    if (isBlockLost(block)) {
+        content->getRawStream()->is_aborted(true);
+        std::cout << interest.getName() << " " << nack.getReason() << std::endl;
+    }
+}
+
+bool NdnConsumerSubModule::isBlockLost(const std::shared_ptr<FecBlock> &block) {
+    // the first segment of a block is always in it
+    if (block->failed[0] && !block->received[0]) {
+        return true;
+    }
+    if (block->count_known) {
+        for (size_t i = block->appended; i < block->count; ++i) {
+            if (block->failed[i] && !block->received[i]) {
+                return true;
+            }
+        }
+        return false;
+    }
+    for (size_t i = 0; i < block->failed.size(); ++i) {
+        if (!block->failed[i] && !(i < global::DEFAULT_FEC_BLOCK_SIZE && block->received[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool NdnConsumerSubModule::isFirstDelivery(const ndn::Interest &interest, const std::shared_ptr<NdnContent> &content) {
+    if (interest.getName().size() >= 2 && interest.getName().get(1).toUri() == global::BODY_NAMESPACE) {
+        // a body is retrieved once the header is given
+        return false;
+    }
+    if (!content->isChunkList()) {
+        return !interest.getName().get(-1).isSegment() || interest.getName().get(-1).toSegment() == 0;
+    }
+    // a chunk list is given with its first chunk, unless it fails before
+    bool chunk = interest.getName().size() >= 2 && interest.getName().get(-2).toUri() == global::CHUNK_NAMESPACE;
+    return content->getChunkCount() == 0 || (chunk && content->getChunkCount() == 1);
+}
+
 void NdnConsumerSubModule::onTimeout(const ndn::Interest &interest, const std::shared_ptr<NdnContent> &content, size_t seg, size_t remaining_tries) {
-    if(remaining_tries > 0) {
+    if (content->getRawStream()->is_aborted()) {
+        return;
+    }
+    if (interest.getInterestLifetime() >= INTERESTDEFAULTLIFETIME) {
+        content->setUnresponsive(true);
+    }
+    ndn::time::milliseconds lifetime = interest.getInterestLifetime() * 2;
+    if (seg == 0) {
+        // only the first segment is bounded, once the response has started the client waits for the rest
+        lifetime = boundLifetime(content, lifetime);
+    }
+    if(remaining_tries > 0 && lifetime.count() > 0) {
         ndn::Interest i(interest);
-        i.setInterestLifetime(i.getInterestLifetime() * 2);
+        i.setInterestLifetime(lifetime);
         i.refreshNonce();
-        _face.expressInterest(i, boost::bind(&NdnConsumerSubModule::onData, this, _1, _2, content, seg),
-                              boost::bind(&NdnConsumerSubModule::onNack, this, _1, _2, content),
-                              boost::bind(&NdnConsumerSubModule::onTimeout, this, _1, content, seg, remaining_tries - 1));
+        expressInterest(content, i, boost::bind(&NdnConsumerSubModule::onData, this, _1, _2, content, seg),
+                                 boost::bind(&NdnConsumerSubModule::onNack, this, _1, _2, content),
+                                 boost::bind(&NdnConsumerSubModule::onTimeout, this, _1, content, seg, remaining_tries - 1));
     } else {
         content->getRawStream()->is_aborted(true);
-        if (!interest.getName().get(-1).isSegment() || interest.getName().get(-1).toSegment() == 0) {
+        if (isFirstDelivery(interest, content)) {
             _parent.fromNdnConsumer(content);
         }
         std::cout << interest.getName() << " unreachable" << std::endl;
@@ -82,8 +494,14 @@ void NdnConsumerSubModule::onTimeout(const ndn::Interest &interest, const std::s
 }
 
 void NdnConsumerSubModule::onNack(const ndn::Interest &interest, const ndn::lp::Nack &nack, const std::shared_ptr<NdnContent> &content) {
+    if (content->getRawStream()->is_aborted()) {
+        return;
+    }
     content->getRawStream()->is_aborted(true);
-    if (!interest.getName().get(-1).isSegment() || interest.getName().get(-1).toSegment() == 0) {
+    // a saturated egw is backed off and the request goes to another one, instead of counting as a failure
+    content->setCongested(nack.getReason() == ndn::lp::NackReason::CONGESTION);
+    content->setUnresponsive(!content->isCongested());
+    if (isFirstDelivery(interest, content)) {
         _parent.fromNdnConsumer(content);
     }
     std::cout << interest.getName() << " " << nack.getReason() << std::endl;
@@ -16,28 +16,115 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <ndn-cxx/face.hpp>
 
+#include <map>
+#include <string>
+#include <vector>
+
 #include "sub_module.h"
 #include "ndn_consumer.h"
 #include "offloaded_ndn_consumer.h"
+#include "global.h"
 
 class NdnConsumerSubModule : public SubModule<OffloadedNdnConsumer>, public NdnConsumer {
 private:
+    // segments and repair segments of a block of DEFAULT_FEC_BLOCK_SIZE segments, retrieved together
+    struct FecBlock {
+        uint64_t index;
+        // segments in the block, fewer in the last one, known with its final segment, its last possible one or any repair
+        size_t count {global::DEFAULT_FEC_BLOCK_SIZE};
+        bool count_known {false};
+        bool last {false};
+        std::vector<size_t> sizes;
+        std::vector<std::string> segments;
+        std::vector<bool> received;
+        std::map<size_t, std::string> repairs;
+        // Interests which got a Nack or ran out of tries, by position
+        std::vector<bool> failed;
+        // segments of the block already in the raw stream
+        size_t appended {0};
+        bool done {false};
+
+        explicit FecBlock(uint64_t index)
+                : index(index)
+                , segments(global::DEFAULT_FEC_BLOCK_SIZE)
+                , received(global::DEFAULT_FEC_BLOCK_SIZE, false)
+                , failed(global::DEFAULT_FEC_BLOCK_SIZE + global::DEFAULT_FEC_REPAIR_COUNT, false) {
+
+        }
+    };
+
     ndn::Face _face;
 
 public:
     explicit NdnConsumerSubModule(OffloadedNdnConsumer &parent);
 
+    // the transport reaches the local forwarder, tests give one standing for the network
+    NdnConsumerSubModule(OffloadedNdnConsumer &parent, const std::shared_ptr<ndn::Transport> &transport);
+
     ~NdnConsumerSubModule() override = default;
 
     void run() override;
 
-    void retrieve(const ndn::Name &name) override;
+    void retrieve(const ndn::Name &name, const std::chrono::steady_clock::time_point &deadline, bool must_be_fresh,
+                  const ByteRange &byte_range, const ndn::Name &forwarding_hint) override;
 
 private:
-    void retrieveHandler(const ndn::Name &name);
+    void retrieveHandler(const ndn::Name &name, const std::chrono::steady_clock::time_point &deadline, bool must_be_fresh,
+                         const ByteRange &byte_range, const ndn::Name &forwarding_hint);
+
+    // every Interest of a content carries its forwarding hint, if any
+    template<class OnData, class OnNack, class OnTimeout>
+    void expressInterest(const std::shared_ptr<NdnContent> &content, ndn::Interest interest, OnData on_data, OnNack on_nack, OnTimeout on_timeout) {
+        if (!content->getForwardingHint().empty()) {
+            ndn::DelegationList forwarding_hint;
+            forwarding_hint.insert(0, content->getForwardingHint());
+            interest.setForwardingHint(forwarding_hint);
+        }
+        _face.expressInterest(interest, on_data, on_nack, on_timeout);
+    }
+
+    // appends the part of a segment the client needs, returns the next segment to retrieve
+    uint64_t appendSegment(const ndn::Data &data, const std::shared_ptr<NdnContent> &content, uint64_t seg);
 
     void onData(const ndn::Interest &interest, const ndn::Data &data, const std::shared_ptr<NdnContent> &content, size_t seg);
 
+    // retrieves the next chunk of a response published as a list of chunks, or the next segment of the list
+    void retrieveChunk(const ndn::Name &list_name, const std::shared_ptr<NdnContent> &content, uint64_t next_seg, bool must_be_fresh);
+
+    void onChunk(const ndn::Interest &interest, const ndn::Data &data, const std::shared_ptr<NdnContent> &content,
+                 const ndn::Name &list_name, uint64_t next_seg, bool must_be_fresh);
+
+    void onChunkTimeout(const ndn::Interest &interest, const std::shared_ptr<NdnContent> &content, const ndn::Name &list_name,
+                        uint64_t next_seg, bool must_be_fresh, size_t remaining_tries);
+
+    void onBody(const ndn::Interest &interest, const ndn::Data &data, const std::shared_ptr<NdnContent> &content,
+                const std::shared_ptr<std::string> &body, uint64_t seg);
+
+    void onBodyTimeout(const ndn::Interest &interest, const std::shared_ptr<NdnContent> &content,
+                       const std::shared_ptr<std::string> &body, uint64_t seg, size_t remaining_tries);
+
+    // expresses the Interests of every segment of the block not received yet and of its repair segments
+    void retrieveBlock(const ndn::Name &prefix, const std::shared_ptr<NdnContent> &content, const std::shared_ptr<FecBlock> &block, bool must_be_fresh);
+
+    // position is the index of the segment in the block, followed by the repairs
+    void onBlockData(const ndn::Interest &interest, const ndn::Data &data, const std::shared_ptr<NdnContent> &content, const ndn::Name &prefix,
+                     const std::shared_ptr<FecBlock> &block, bool must_be_fresh, size_t position);
+
+    void onBlockTimeout(const ndn::Interest &interest, const std::shared_ptr<NdnContent> &content, const ndn::Name &prefix,
+                        const std::shared_ptr<FecBlock> &block, bool must_be_fresh, size_t position, size_t remaining_tries);
+
+    void onBlockNack(const ndn::Interest &interest, const ndn::lp::Nack &nack, const std::shared_ptr<NdnContent> &content,
+                     const std::shared_ptr<FecBlock> &block, size_t position);
+
+    // true once a failed segment is known to be in the block, or once nothing is left to tell how many segments it has
+    bool isBlockLost(const std::shared_ptr<FecBlock> &block);
+
+    // appends the segments of the block which follow the ones already appended, rebuilding the missing ones if possible
+    void appendBlock(const std::shared_ptr<NdnContent> &content, const ndn::Name &prefix, const std::shared_ptr<FecBlock> &block, bool must_be_fresh);
+
+    // true if the content has not been given to the parent yet when this Interest fails
+    bool isFirstDelivery(const ndn::Interest &interest, const std::shared_ptr<NdnContent> &content);
+
     void onTimeout(const ndn::Interest &interest, const std::shared_ptr<NdnContent> &content, size_t seg, size_t remaining_tries);
 
     void onNack(const ndn::Interest &interest, const ndn::lp::Nack &nack, const std::shared_ptr<NdnContent> &content);
@@ -14,11 +14,25 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "ndn_resolver.h"
 
-NdnResolver::NdnResolver(const ndn::Name &prefix, size_t concurrency)
+#include <ndn-cxx/encoding/block-helpers.hpp>
+
+#include <algorithm>
+#include <sstream>
+
+NdnResolver::NdnResolver(const ndn::Name &prefix, size_t concurrency, bool serve_stale, bool batching)
         : Module(concurrency)
         , _prefix(prefix.wireEncode())
-        , _purge_timer(_ios) {
+        , _purge_timer(_ios)
+        , _breaker(global::DEFAULT_BREAKER_THRESHOLD, std::chrono::milliseconds(global::DEFAULT_BREAKER_OPEN_TIME.total_milliseconds()),
+                   std::chrono::milliseconds(global::DEFAULT_OVERLOAD_MIN_BACKOFF.total_milliseconds()),
+                   std::chrono::milliseconds(global::DEFAULT_OVERLOAD_MAX_BACKOFF.total_milliseconds()))
+        , _serve_stale(serve_stale)
+        , _batching(batching) {
+
+}
 
+void NdnResolver::addEgw(const ndn::Name &egw_prefix, size_t weight) {
+    _egw_ring.add(egw_prefix, weight);
 }
 
 void NdnResolver::run() {
@@ -38,17 +52,58 @@ void NdnResolver::fromNdnSource(const std::shared_ptr<NdnContent> &content) {
     _ios.post(boost::bind(&NdnResolver::fromNdnSourceHandler, this, content));
 }
 
+void NdnResolver::cancelFromNdnSource(const ndn::Name &name) {
+    _ios.post(boost::bind(&NdnResolver::cancelFromNdnSourceHandler, this, name));
+}
+
 void NdnResolver::fromNdnProducerHandler(const ndn::Interest &interest) {
     auto timer = std::make_shared<boost::asio::deadline_timer>(_ios);
     checkForContent(interest, timer, 7);
 }
 
 void NdnResolver::fromNdnConsumerHandler(const std::shared_ptr<NdnContent> &content) {
+    if (content->getName().get(-1).toUri() == global::CANCEL_MARKER) {
+        // acknowledgement of a cancellation, nothing to do
+        return;
+    }
+    ndn::Name notification(content->getName());
+    if (notification.get(-1).toUri() == global::REFRESH_MARKER) {
+        notification = notification.getPrefix(-1);
+    }
+    if (notification.get(-1).isNumber()) {
+        // remove the time budget of the notification
+        notification = notification.getPrefix(-1);
+    }
+    if (notification.size() == 4 && notification.get(1).toUri() == global::BATCH_MARKER) {
+        onBatchNotified(content, notification);
+        return;
+    }
     ndn::Name prefix;
     try {
-        prefix.wireDecode(content->getName().get(-2).blockFromValue());
-        ndn::Name name(content->getName().getPrefix(-2));
-        name.append(content->getName().get(-1));
+        prefix.wireDecode(notification.get(-2).blockFromValue());
+        ndn::Name name(notification.getPrefix(-2));
+        name.append(notification.get(-1));
+
+        ndn::Name forwarding_hint = forwardingHint(name);
+        std::string egw_prefix = breakerKey(name, forwarding_hint);
+        if (content->isCongested()) {
+            _breaker.onOverload(egw_prefix);
+            onOverloaded(name, false);
+            return;
+        }
+        if (content->getRawStream()->is_aborted()) {
+            // a notification given up because of an impatient client says nothing about the egw
+            if (content->isUnresponsive()) {
+                _breaker.onFailure(egw_prefix);
+            }
+            long retry_after = _breaker.retryAfter(egw_prefix);
+            if (retry_after > 0) {
+                replyServiceUnavailable(name, retry_after);
+                return;
+            }
+        } else {
+            _breaker.onSuccess(egw_prefix);
+        }
 
         if (content->getRawStream()->raw_data_as_string() == "OK") {
             std::shared_ptr<NdnContent> request;
@@ -66,30 +121,246 @@ void NdnResolver::fromNdnConsumerHandler(const std::shared_ptr<NdnContent> &cont
                 std::lock_guard<std::mutex> lock(_contents_mutex);
                 _pendings.emplace(name.get(-1).toUri(), timer);
             } else {
-                _ndn_consumer->retrieve(name);
+                _ndn_consumer->retrieve(name, content->getDeadline(), true, requestedByteRange(name), forwarding_hint);
             }
         } else {
-            _ndn_consumer->retrieve(name);
+            _ndn_consumer->retrieve(name, content->getDeadline(), true, requestedByteRange(name), forwarding_hint);
         }
     } catch (const std::exception &e) {
-        _ndn_source->fromNdnSink(content);
+        if (!content->getRawStream()->is_aborted()) {
+            recordStaleWindow(content);
+        }
+        if (isDeliverable(content)) {
+            _ndn_source->fromNdnSink(content);
+        }
     }
 }
 
 void NdnResolver::fromNdnSourceHandler(const std::shared_ptr<NdnContent> &content) {
+    auto budget = std::chrono::duration_cast<std::chrono::milliseconds>(content->getDeadline() - std::chrono::steady_clock::now());
+    if (budget.count() <= 0) {
+        // the client already gave up
+        return;
+    }
     ndn::Name old_name = content->getName();
+    ndn::Name forwarding_hint;
+    bool allowed;
+    if (!content->isRouted() && !_egw_ring.empty()) {
+        // the same request always reaches the same egw while it is healthy, the next egw of the ring takes over otherwise
+        allowed = _egw_ring.pick(old_name.get(-1).toUri(), boost::bind(&CircuitBreaker::allow, &_breaker, _1), forwarding_hint);
+    } else {
+        allowed = _breaker.allow(breakerKey(old_name, forwarding_hint));
+    }
+    if (!allowed) {
+        replyServiceUnavailable(old_name, _breaker.retryAfter(breakerKey(old_name, forwarding_hint)));
+        return;
+    }
+    content->setForwardingHint(forwarding_hint);
+    if (_serve_stale) {
+        bool stale = false;
+        { // block for RAII
+            std::lock_guard<std::mutex> lock(_stale_mutex);
+            auto it = _stale_windows.find(old_name.toUri());
+            auto time_point = std::chrono::steady_clock::now();
+            if (it != _stale_windows.end() && it->second.fresh_until <= time_point && time_point < it->second.stale_until &&
+                    _stale_races.find(old_name.toUri()) == _stale_races.end()) {
+                // the stale copy and the refreshed response race, the first one received is served
+                _stale_races.emplace(old_name.toUri(), StaleRace{false, 2});
+                stale = true;
+            }
+        }
+        if (stale) {
+            // the egw must not answer with the copy raced against
+            content->setRefresh(true);
+            _ndn_consumer->retrieve(old_name, content->getDeadline(), false, content->getByteRange(), forwarding_hint);
+        }
+    }
     ndn::Name new_name(_prefix);
     content->setName(new_name.append(old_name.get(-1)));
     { // block for RAII
         std::lock_guard<std::mutex> lock(_contents_mutex);
-        _contents.emplace(content->getName().toUri(), content);
+        // a former request with the same name may have asked for another byte range
+        _contents[content->getName().toUri()] = content;
+    }
+    // native NDN servers only know notifications of single requests, batches can't ask for a refresh
+    if (_batching && !content->isRouted() && !content->isRefresh() && addToBatch(content, old_name, budget.count())) {
+        return;
     }
-    ndn::Name notify_name(old_name.getPrefix(-1));
-    _ndn_consumer->retrieve(notify_name.append(_prefix).append(old_name.get(-1)));
+    sendNotification(content, old_name);
     auto timer = std::make_shared<boost::asio::deadline_timer>(_ios);
     generateDataPackets(content, timer);
 }
 
+void NdnResolver::sendNotification(const std::shared_ptr<NdnContent> &content, const ndn::Name &name) {
+    auto budget = std::chrono::duration_cast<std::chrono::milliseconds>(content->getDeadline() - std::chrono::steady_clock::now());
+    ndn::Name notify_name(name.getPrefix(-1));
+    // the egw gets the remaining time before the client gives up
+    notify_name.append(_prefix).append(name.get(-1)).appendNumber(std::max<long>(budget.count(), 0));
+    if (content->isRefresh()) {
+        notify_name.append(global::REFRESH_MARKER);
+    }
+    _ndn_consumer->retrieve(notify_name, content->getDeadline(), true, ByteRange(), content->getForwardingHint());
+}
+
+bool NdnResolver::addToBatch(const std::shared_ptr<NdnContent> &content, const ndn::Name &name, long budget) {
+    // requests still being received, or too large, are notified on their own
+    long size = content->getRawStream()->remainingBytes(0);
+    if (size < 0 || (size_t) size > global::DEFAULT_BATCH_MAX_REQUEST_SIZE) {
+        return false;
+    }
+    std::string egw_prefix = breakerKey(name, content->getForwardingHint());
+    std::shared_ptr<boost::asio::deadline_timer> full_batch_timer;
+    { // block for RAII
+        std::lock_guard<std::mutex> lock(_batches_mutex);
+        auto it = _batches.find(egw_prefix);
+        if (it == _batches.end()) {
+            it = _batches.emplace(egw_prefix, Batch{std::make_shared<boost::asio::deadline_timer>(_ios), name.getPrefix(1),
+                                                    content->getForwardingHint(), {}, {}}).first;
+            it->second.timer->expires_from_now(global::DEFAULT_BATCH_WINDOW);
+            it->second.timer->async_wait(boost::bind(&NdnResolver::sendBatch, this, egw_prefix, it->second.timer));
+        }
+        it->second.requests.emplace_back(name, content->getDeadline());
+        it->second.records += name.toUri() + " " + std::to_string(budget) + " " + std::to_string(size) + "\n" +
+                              content->getRawStream()->raw_data_as_string();
+        if (it->second.requests.size() >= global::DEFAULT_BATCH_MAX_REQUESTS) {
+            full_batch_timer = it->second.timer;
+        }
+    }
+    if (full_batch_timer) {
+        full_batch_timer->cancel();
+    }
+    return true;
+}
+
+void NdnResolver::sendBatch(const std::string &egw_prefix, const std::shared_ptr<boost::asio::deadline_timer> &timer) {
+    Batch batch;
+    std::string id;
+    { // block for RAII
+        std::lock_guard<std::mutex> lock(_batches_mutex);
+        auto it = _batches.find(egw_prefix);
+        if (it == _batches.end() || it->second.timer != timer) {
+            return;
+        }
+        batch = it->second;
+        _batches.erase(it);
+        // identifiers are not reused after a restart, an old batch could still be in caches
+        auto since_epoch = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch());
+        id = std::to_string(since_epoch.count()) + "-" + std::to_string(++_batch_count);
+        _sent_batches.emplace(id, batch.requests);
+    }
+
+    auto deadline = std::chrono::steady_clock::time_point::min();
+    for (const auto &request : batch.requests) {
+        deadline = std::max(deadline, request.second);
+    }
+    auto budget = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+
+    // the requests are retrieved together by the egw
+    auto content = std::make_shared<NdnContent>();
+    content->setName(ndn::Name(_prefix).append(global::BATCH_MARKER).append(id));
+    content->setDeadline(deadline);
+    content->getRawStream()->append_raw_data(batch.records);
+    content->getRawStream()->is_completed(true);
+    { // block for RAII
+        std::lock_guard<std::mutex> lock(_contents_mutex);
+        _contents[content->getName().toUri()] = content;
+    }
+    generateDataPackets(content, std::make_shared<boost::asio::deadline_timer>(_ios));
+
+    ndn::Name notify_name(batch.prefix);
+    notify_name.append(global::BATCH_MARKER).append(_prefix).append(id).appendNumber(std::max<long>(budget.count(), 0));
+    _ndn_consumer->retrieve(notify_name, deadline, true, ByteRange(), batch.forwarding_hint);
+}
+
+void NdnResolver::onBatchNotified(const std::shared_ptr<NdnContent> &content, const ndn::Name &notification) {
+    std::vector<std::pair<ndn::Name, std::chrono::steady_clock::time_point>> requests;
+    { // block for RAII
+        std::lock_guard<std::mutex> lock(_batches_mutex);
+        auto it = _sent_batches.find(notification.get(-1).toUri());
+        if (it == _sent_batches.end()) {
+            return;
+        }
+        requests = it->second;
+        _sent_batches.erase(it);
+    }
+    bool aborted = content->getRawStream()->is_aborted();
+    if (!requests.empty()) {
+        // a single exchange with the egw, a single success or failure
+        const ndn::Name &name = requests.front().first;
+        std::string egw_prefix = breakerKey(name, forwardingHint(name));
+        if (content->isCongested()) {
+            _breaker.onOverload(egw_prefix);
+            for (const auto &request : requests) {
+                onOverloaded(request.first, true);
+            }
+            return;
+        }
+        if (aborted && content->isUnresponsive()) {
+            _breaker.onFailure(egw_prefix);
+        } else if (!aborted) {
+            _breaker.onSuccess(egw_prefix);
+        }
+    }
+    for (const auto &request : requests) {
+        onNotified(request.first, request.second, aborted);
+    }
+}
+
+void NdnResolver::onNotified(const ndn::Name &name, const std::chrono::steady_clock::time_point &deadline, bool aborted) {
+    ndn::Name forwarding_hint = forwardingHint(name);
+    long retry_after = _breaker.retryAfter(breakerKey(name, forwarding_hint));
+    if (aborted && retry_after > 0) {
+        replyServiceUnavailable(name, retry_after);
+    } else {
+        _ndn_consumer->retrieve(name, deadline, true, requestedByteRange(name), forwarding_hint);
+    }
+}
+
+void NdnResolver::onOverloaded(const ndn::Name &name, bool batched) {
+    std::shared_ptr<NdnContent> request;
+    { // block for RAII
+        std::lock_guard<std::mutex> lock(_contents_mutex);
+        auto it = _contents.find(ndn::Name(_prefix).append(name.get(-1)).toUri());
+        if (it != _contents.end()) {
+            request = it->second;
+        }
+    }
+    if (!request) {
+        // cancelled by the client meanwhile
+        return;
+    }
+    ndn::Name forwarding_hint;
+    // the saturated egw is backed off, so the ring gives the next healthy egw for the request
+    if (!request->getForwardingHint().empty() && request->getDeadline() > std::chrono::steady_clock::now() &&
+            _egw_ring.pick(name.get(-1).toUri(), boost::bind(&CircuitBreaker::allow, &_breaker, _1), forwarding_hint)) {
+        request->setForwardingHint(forwarding_hint);
+        if (batched) {
+            // the egw retrieves the request on its own this time
+            generateDataPackets(request, std::make_shared<boost::asio::deadline_timer>(_ios));
+        }
+        sendNotification(request, name);
+    } else {
+        replyServiceUnavailable(name, _breaker.retryAfter(breakerKey(name, request->getForwardingHint())));
+    }
+}
+
+void NdnResolver::cancelFromNdnSourceHandler(const ndn::Name &name) {
+    ndn::Name forwarding_hint = forwardingHint(name);
+    { // block for RAII
+        std::lock_guard<std::mutex> lock(_stale_mutex);
+        // nobody waits for the stale copy nor the refresh anymore
+        _stale_races.erase(name.toUri());
+    }
+    { // block for RAII
+        std::lock_guard<std::mutex> lock(_contents_mutex);
+        _contents.erase(ndn::Name(_prefix).append(name.get(-1)).toUri());
+    }
+    // same shape as the notification so the egw knows which client gave up
+    ndn::Name cancel_name(name.getPrefix(-1));
+    cancel_name.append(_prefix).append(name.get(-1)).append(global::CANCEL_MARKER);
+    _ndn_consumer->retrieve(cancel_name, std::chrono::steady_clock::time_point::max(), true, ByteRange(), forwarding_hint);
+}
+
 void NdnResolver::checkForContent(const ndn::Interest &interest,
                                   const std::shared_ptr<boost::asio::deadline_timer> &timer, size_t remaining_tries) {
     if (remaining_tries > 0) {
@@ -139,7 +410,7 @@ void NdnResolver::checkForContent(const ndn::Interest &interest,
 
 void NdnResolver::waitContentCompletion(const ndn::Name &name, const std::shared_ptr<boost::asio::deadline_timer> &timer) {
     if (timer->expires_at() <= boost::asio::deadline_timer::traits_type::now()) {
-        _ndn_consumer->retrieve(name);
+        _ndn_consumer->retrieve(name, std::chrono::steady_clock::time_point::max(), true, requestedByteRange(name), forwardingHint(name));
         std::lock_guard<std::mutex> lock(_pendings_mutex);
         _pendings.erase(name.get(-1).toUri());
     } else {
@@ -152,10 +423,24 @@ void NdnResolver::generateDataPackets(const std::shared_ptr<NdnContent> &content
     int generation_tokens = 16;
     char buffer[global::DEFAULT_BUFFER_SIZE];
     long read_bytes;
-    while(generation_tokens > 0 && (read_bytes = content->getRawStream()->readRawData(segment * global::DEFAULT_BUFFER_SIZE, buffer, global::DEFAULT_BUFFER_SIZE)) > 0){
+    uint64_t offset = content->getOffset(segment);
+    // the last segment may have been flushed before the end of the request, an empty segment then carries the FinalBlockId
+    auto finalPublished = [&content](uint64_t segment) {
+        auto datas_it = segment > 0 ? content->findData(segment - 1) : content->end();
+        return datas_it != content->end() && !datas_it->second->getFinalBlockId().empty();
+    };
+    while(generation_tokens > 0 && ((read_bytes = content->getRawStream()->readSomeRawData(offset, buffer, global::DEFAULT_BUFFER_SIZE)) > 0 ||
+                                    (read_bytes == 0 && !content->getRawStream()->is_aborted() && !finalPublished(segment)))){
+        // a segment is cut short only once its bytes waited for DEFAULT_WAIT_FLUSH, so streamed request bodies still get through
+        if (read_bytes < global::DEFAULT_BUFFER_SIZE && content->getRawStream()->remainingBytes(offset + read_bytes) != 0 &&
+                !content->isFlushDue(offset, std::chrono::milliseconds(global::DEFAULT_WAIT_FLUSH.total_milliseconds()))) {
+            read_bytes = -1;
+            break;
+        }
         auto data = std::make_shared<ndn::Data>(ndn::Name(content->getName()).appendSegment(segment));
         data->setContent((uint8_t*)buffer, read_bytes);
-        if(content->getRawStream()->remainingBytes(segment * global::DEFAULT_BUFFER_SIZE + read_bytes) == 0){
+        data->setMetaInfo(ndn::MetaInfo().addAppMetaInfo(ndn::makeNonNegativeIntegerBlock(global::TLV_SEGMENT_OFFSET, offset)));
+        if(content->getRawStream()->remainingBytes(offset + read_bytes) == 0){
             data->setFinalBlockId(ndn::Name::Component::fromSegment(segment));
         }
         data->setFreshnessPeriod(content->getFreshness());
@@ -163,7 +448,8 @@ void NdnResolver::generateDataPackets(const std::shared_ptr<NdnContent> &content
 
         content->addData(segment, data);
 
-        ++segment;
+        offset += read_bytes;
+        content->setOffset(++segment, offset);
         --generation_tokens;
     }
 
@@ -196,6 +482,108 @@ void NdnResolver::purgeOldContents() {
 #ifndef NDEBUG
     std::cout << remove_count << " content(s) removed from buffer (" << _contents.size() << " remaining contents)" << std::endl;
 #endif
+    { // block for RAII
+        std::lock_guard<std::mutex> stale_lock(_stale_mutex);
+        auto stale_it = _stale_windows.begin();
+        while (stale_it != _stale_windows.end()) {
+            if (stale_it->second.stale_until <= time_point) {
+                stale_it = _stale_windows.erase(stale_it);
+            } else {
+                ++stale_it;
+            }
+        }
+    }
     _purge_timer.expires_from_now(global::DEFAULT_WAIT_PURGE);
     _purge_timer.async_wait(boost::bind(&NdnResolver::purgeOldContents, this));
 }
+
+void NdnResolver::recordStaleWindow(const std::shared_ptr<NdnContent> &content) {
+    // the HTTP header of the response is in the first segment
+    std::string raw_data = content->getRawStream()->raw_data_as_string();
+    size_t header_end = raw_data.find("\r\n\r\n");
+    std::string cache_control_field;
+    std::stringstream header(raw_data.substr(0, header_end));
+    std::string header_line;
+    while (std::getline(header, header_line)) {
+        auto delimiter_index = header_line.find(':');
+        std::string name = header_line.substr(0, delimiter_index);
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        if (delimiter_index != std::string::npos && name == "cache-control") {
+            cache_control_field += header_line.substr(delimiter_index + 1) + ",";
+        }
+    }
+
+    CacheControl cache_control(cache_control_field);
+    long stale_while_revalidate = cache_control.getSeconds("stale-while-revalidate");
+    std::lock_guard<std::mutex> lock(_stale_mutex);
+    if (header_end != std::string::npos && stale_while_revalidate > 0 && !cache_control.has("must-revalidate") &&
+            !cache_control.has("proxy-revalidate") && !cache_control.has("no-cache") && !cache_control.has("no-store")) {
+        auto fresh_until = std::chrono::steady_clock::now() + std::chrono::milliseconds(content->getFreshness().count());
+        _stale_windows[content->getName().toUri()] = StaleWindow{fresh_until, fresh_until + std::chrono::seconds(stale_while_revalidate)};
+    } else {
+        _stale_windows.erase(content->getName().toUri());
+    }
+}
+
+bool NdnResolver::isDeliverable(const std::shared_ptr<NdnContent> &content) {
+    return isDeliverable(content->getName(), content->getRawStream()->is_aborted());
+}
+
+bool NdnResolver::isDeliverable(const ndn::Name &name, bool failed) {
+    std::lock_guard<std::mutex> lock(_stale_mutex);
+    auto it = _stale_races.find(name.toUri());
+    if (it == _stale_races.end()) {
+        return true;
+    }
+    // a failure is only reported if the other retrieval failed too, the loser keeps on refreshing caches
+    --it->second.pending;
+    bool deliverable = !it->second.delivered && (!failed || it->second.pending == 0);
+    if (deliverable) {
+        it->second.delivered = true;
+    }
+    if (it->second.pending == 0) {
+        _stale_races.erase(it);
+    }
+    return deliverable;
+}
+
+ByteRange NdnResolver::requestedByteRange(const ndn::Name &name) {
+    std::lock_guard<std::mutex> lock(_contents_mutex);
+    auto it = _contents.find(ndn::Name(_prefix).append(name.get(-1)).toUri());
+    return it != _contents.end() ? it->second->getByteRange() : ByteRange();
+}
+
+ndn::Name NdnResolver::forwardingHint(const ndn::Name &name) {
+    std::lock_guard<std::mutex> lock(_contents_mutex);
+    auto it = _contents.find(ndn::Name(_prefix).append(name.get(-1)).toUri());
+    return it != _contents.end() ? it->second->getForwardingHint() : ndn::Name();
+}
+
+std::string NdnResolver::breakerKey(const ndn::Name &name, const ndn::Name &forwarding_hint) {
+    return forwarding_hint.empty() ? name.getPrefix(1).toUri() : forwarding_hint.toUri();
+}
+
+void NdnResolver::replyServiceUnavailable(const ndn::Name &name, long retry_after) {
+    // the interpreter matches the response with the requests of the same byte range
+    ByteRange byte_range = requestedByteRange(name);
+    { // block for RAII
+        std::lock_guard<std::mutex> lock(_contents_mutex);
+        _contents.erase(ndn::Name(_prefix).append(name.get(-1)).toUri());
+    }
+    // the refresh failed, a stale copy still racing it is served instead
+    if (!isDeliverable(name, true)) {
+        return;
+    }
+    std::string body = "gateway behind " + name.getPrefix(1).toUri() + " is unreachable";
+    auto response = std::make_shared<NdnContent>();
+    response->setName(name);
+    response->setByteRange(byte_range);
+    response->getRawStream()->append_raw_data("HTTP/1.1 503 Service Unavailable\r\n"
+                                              "connection: close\r\n"
+                                              "content-type: text/plain\r\n"
+                                              "content-length: " + std::to_string(body.size()) + "\r\n"
+                                              "retry-after: " + std::to_string(retry_after) + "\r\n"
+                                              "\r\n" + body);
+    response->getRawStream()->is_completed(true);
+    _ndn_source->fromNdnSink(response);
+}
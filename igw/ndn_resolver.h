@@ -20,6 +20,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <unordered_map>
 #include <mutex>
+#include <vector>
 
 #include "global.h"
 #include "module.h"
@@ -27,6 +28,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "offloaded_ndn_producer.h"
 #include "ndn_sink.h"
 #include "ndn_content.h"
+#include "circuit_breaker.h"
+#include "egw_ring.h"
+#include "cache_control.h"
 
 class NdnResolver : public Module, public NdnSink, public OffloadedNdnConsumer, public OffloadedNdnProducer {
 private:
@@ -40,11 +44,51 @@ private:
     std::mutex _pendings_mutex;
     std::unordered_map<std::string, std::shared_ptr<boost::asio::deadline_timer>> _pendings;
 
+    CircuitBreaker _breaker;
+    // egw instances sharing the requests, empty if NFD chooses the egw answering each notification
+    EgwRing _egw_ring;
+
+    // serve-stale mode, responses allowing stale-while-revalidate are served from any cache while being refreshed
+    struct StaleWindow {
+        std::chrono::steady_clock::time_point fresh_until;
+        std::chrono::steady_clock::time_point stale_until;
+    };
+    struct StaleRace {
+        bool delivered;
+        size_t pending;
+    };
+    bool _serve_stale;
+    std::mutex _stale_mutex;
+    std::unordered_map<std::string, StaleWindow> _stale_windows;
+    std::unordered_map<std::string, StaleRace> _stale_races;
+
+    // batching mode, small requests to the same egw within DEFAULT_BATCH_WINDOW share a single notification
+    struct Batch {
+        std::shared_ptr<boost::asio::deadline_timer> timer;
+        // prefix of the notification and egw instance it is sent to
+        ndn::Name prefix;
+        ndn::Name forwarding_hint;
+        // response names of the requests and when their clients give up
+        std::vector<std::pair<ndn::Name, std::chrono::steady_clock::time_point>> requests;
+        // every request as "<response name> <time budget> <size>\n<request>"
+        std::string records;
+    };
+    bool _batching;
+    uint64_t _batch_count {0};
+    std::mutex _batches_mutex;
+    // batches being filled by egw prefix, or by egw instance prefix when sharding
+    std::unordered_map<std::string, Batch> _batches;
+    // batches whose notification is sent, by batch identifier
+    std::unordered_map<std::string, std::vector<std::pair<ndn::Name, std::chrono::steady_clock::time_point>>> _sent_batches;
+
 public:
-    explicit NdnResolver(const ndn::Name &prefix, size_t concurrency = 1);
+    explicit NdnResolver(const ndn::Name &prefix, size_t concurrency = 1, bool serve_stale = false, bool batching = false);
 
     ~NdnResolver() override = default;
 
+    // the egw instance of each request is picked by consistent hashing, weights are relative shares of the requests
+    void addEgw(const ndn::Name &egw_prefix, size_t weight = 1);
+
     void run() override;
 
     void fromNdnProducer(const ndn::Interest &interest) override;
@@ -53,6 +97,8 @@ public:
 
     void fromNdnSource(const std::shared_ptr<NdnContent> &content) override;
 
+    void cancelFromNdnSource(const ndn::Name &name) override;
+
 private:
     void fromNdnProducerHandler(const ndn::Interest &interest);
 
@@ -60,6 +106,26 @@ private:
 
     void fromNdnSourceHandler(const std::shared_ptr<NdnContent> &content);
 
+    void cancelFromNdnSourceHandler(const ndn::Name &name);
+
+    // the egw gets the request name and the remaining time before the client gives up
+    void sendNotification(const std::shared_ptr<NdnContent> &content, const ndn::Name &name);
+
+    // true if the response name of the request is retrieved once the batch notification is acknowledged
+    bool addToBatch(const std::shared_ptr<NdnContent> &content, const ndn::Name &name, long budget);
+
+    void sendBatch(const std::string &egw_prefix, const std::shared_ptr<boost::asio::deadline_timer> &timer);
+
+    // retrieves the responses of a batch once the egw acknowledged its notification
+    void onBatchNotified(const std::shared_ptr<NdnContent> &content, const ndn::Name &notification);
+
+    // retrieves a response once its notification is acknowledged, a failure may trip the circuit breaker of the egw
+    void onNotified(const ndn::Name &name, const std::chrono::steady_clock::time_point &deadline, bool aborted);
+
+    // the egw refused the notification, the request is notified to the next egw of the ring if any,
+    // otherwise the client is told when to retry
+    void onOverloaded(const ndn::Name &name, bool batched);
+
     void checkForContent(const ndn::Interest &interest, const std::shared_ptr<boost::asio::deadline_timer> &timer,
                          size_t remaining_tries);
 
@@ -69,4 +135,22 @@ private:
                              const std::shared_ptr<boost::asio::deadline_timer> &timer, uint64_t segment = 0);
 
     void purgeOldContents();
+
+    void recordStaleWindow(const std::shared_ptr<NdnContent> &content);
+
+    bool isDeliverable(const std::shared_ptr<NdnContent> &content);
+
+    // a failed retrieval of a name racing a stale copy is only reported if both failed
+    bool isDeliverable(const ndn::Name &name, bool failed);
+
+    // byte range of the request answered by the response with this name
+    ByteRange requestedByteRange(const ndn::Name &name);
+
+    // egw instance the request answered by the response with this name was sent to, empty if not sharded
+    ndn::Name forwardingHint(const ndn::Name &name);
+
+    // failures are counted per egw instance when sharding, otherwise per egw prefix
+    std::string breakerKey(const ndn::Name &name, const ndn::Name &forwarding_hint);
+
+    void replyServiceUnavailable(const ndn::Name &name, long retry_after);
 };
\ No newline at end of file
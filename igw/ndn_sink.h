@@ -30,6 +30,9 @@ protected:
 public:
     virtual void fromNdnSource(const std::shared_ptr<NdnContent> &content) = 0;
 
+    // nobody waits anymore for the content with this name
+    virtual void cancelFromNdnSource(const ndn::Name &name) = 0;
+
     void attachNdnSource(NdnSource *ndn_source) {
         _ndn_source = ndn_source;
     }
@@ -0,0 +1,234 @@
+/*
+Copyright (C) 2015-2018  Xavier MARCHAL
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <ndn-cxx/encoding/block-helpers.hpp>
+#include <ndn-cxx/lp/packet.hpp>
+#include <ndn-cxx/security/key-chain.hpp>
+
+#include <atomic>
+#include <map>
+#include <set>
+#include <thread>
+
+#include "../fec_codec.h"
+#include "../ndn_receiver.h"
+#include "check.h"
+
+namespace {
+    const size_t SEGMENT_SIZE = 1000;
+
+    std::string makeBody(size_t size) {
+        std::string body(size, '\0');
+        for (size_t i = 0; i < size; ++i) {
+            body[i] = (char) ((i * 131 + i / 7) & 0xff);
+        }
+        return body;
+    }
+
+    // stands for the forwarder and the egw: answers with the segments and repairs of the contents published like the egw does,
+    // never answers the Interests of lost packets and sends a Nack for the names it doesn't know
+    class LossyTransport : public ndn::Transport {
+    private:
+        ndn::KeyChain _keychain;
+        std::map<ndn::Name, std::shared_ptr<ndn::Data>> _datas;
+        std::set<ndn::Name> _lost;
+        std::atomic<size_t> _lost_count {0};
+
+    public:
+        void publish(const ndn::Name &version, const std::string &body) {
+            std::vector<std::string> segments;
+            for (size_t offset = 0; offset < body.size(); offset += SEGMENT_SIZE) {
+                segments.push_back(body.substr(offset, SEGMENT_SIZE));
+            }
+            for (size_t first = 0; first < segments.size(); first += global::DEFAULT_FEC_BLOCK_SIZE) {
+                size_t count = std::min(global::DEFAULT_FEC_BLOCK_SIZE, segments.size() - first);
+                bool last = first + count == segments.size();
+                std::vector<std::string> block(segments.begin() + first, segments.begin() + first + count);
+                std::string description = std::to_string(first * SEGMENT_SIZE) + " " + (last ? "1" : "0");
+                for (size_t i = 0; i < count; ++i) {
+                    ndn::MetaInfo meta_info;
+                    meta_info.addAppMetaInfo(ndn::makeNonNegativeIntegerBlock(global::TLV_SEGMENT_OFFSET, (first + i) * SEGMENT_SIZE));
+                    meta_info.addAppMetaInfo(ndn::makeEmptyBlock(global::TLV_FEC));
+                    auto data = std::make_shared<ndn::Data>(ndn::Name(version).appendSegment(first + i));
+                    data->setMetaInfo(meta_info);
+                    if (last && i + 1 == count) {
+                        data->setFinalBlockId(ndn::Name::Component::fromSegment(first + i));
+                    }
+                    add(data, block[i]);
+                    if (first + i == 0) {
+                        // the first Interest only knows the name of the content, not its version
+                        _datas[version.getPrefix(-1)] = data;
+                    }
+                    description += " " + std::to_string(block[i].size());
+                }
+                std::vector<std::string> repairs = FecCodec::encode(block, global::DEFAULT_FEC_REPAIR_COUNT);
+                for (size_t i = 0; i < repairs.size(); ++i) {
+                    uint64_t index = first / global::DEFAULT_FEC_BLOCK_SIZE * global::DEFAULT_FEC_REPAIR_COUNT + i;
+                    auto data = std::make_shared<ndn::Data>(ndn::Name(version).append(global::REPAIR_MARKER).appendNumber(index));
+                    data->setMetaInfo(ndn::MetaInfo().addAppMetaInfo(ndn::makeStringBlock(global::TLV_FEC_REPAIR, description)));
+                    add(data, repairs[i]);
+                }
+            }
+        }
+
+        // the Interests of this name are never answered
+        void lose(const ndn::Name &name) {
+            _lost.insert(name);
+        }
+
+        // the Interests of this name get a Nack
+        void remove(const ndn::Name &name) {
+            _datas.erase(name);
+        }
+
+        size_t getLostCount() const {
+            return _lost_count;
+        }
+
+        void connect(boost::asio::io_service &io_service, const ReceiveCallback &receive_callback) override {
+            ndn::Transport::connect(io_service, receive_callback);
+            m_isConnected = true;
+        }
+
+        void close() override {
+            m_isConnected = false;
+        }
+
+        void pause() override {
+            m_isReceiving = false;
+        }
+
+        void resume() override {
+            m_isReceiving = true;
+        }
+
+        void send(const ndn::Block &wire) override {
+            ndn::Interest interest(wire);
+            if (_lost.count(interest.getName()) > 0) {
+                ++_lost_count;
+                return;
+            }
+            auto it = _datas.find(interest.getName());
+            if (it != _datas.end()) {
+                m_ioService->post(boost::bind(m_receiveCallback, it->second->wireEncode()));
+                return;
+            }
+            ndn::lp::Nack nack(interest);
+            nack.setReason(ndn::lp::NackReason::NO_ROUTE);
+            ndn::Block interest_wire = interest.wireEncode();
+            ndn::lp::Packet packet;
+            packet.add<ndn::lp::NackField>(nack.getHeader());
+            packet.add<ndn::lp::FragmentField>(std::make_pair(interest_wire.begin(), interest_wire.end()));
+            m_ioService->post(boost::bind(m_receiveCallback, packet.wireEncode()));
+        }
+
+        void send(const ndn::Block &/*header*/, const ndn::Block &payload) override {
+            send(payload);
+        }
+
+    private:
+        void add(const std::shared_ptr<ndn::Data> &data, const std::string &value) {
+            data->setContent((const uint8_t *) value.data(), value.size());
+            data->setFreshnessPeriod(ndn::time::milliseconds(10000));
+            _keychain.sign(*data, ndn::security::SigningInfo(ndn::security::SigningInfo::SIGNER_TYPE_SHA256));
+            _datas[data->getName()] = data;
+        }
+    };
+
+    // stands for the resolver of the igw, keeps the content given by the consumer
+    class ContentCollector : public OffloadedNdnConsumer {
+    private:
+        std::mutex _mutex;
+        std::shared_ptr<NdnContent> _content;
+
+    public:
+        void fromNdnConsumer(const std::shared_ptr<NdnContent> &content) override {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _content = content;
+        }
+
+        // the content once completely retrieved or given up, nullptr if it doesn't end in time
+        std::shared_ptr<NdnContent> wait() {
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+            while (std::chrono::steady_clock::now() < deadline) {
+                { // block for RAII
+                    std::lock_guard<std::mutex> lock(_mutex);
+                    if (_content && (_content->getRawStream()->is_completed() || _content->getRawStream()->is_aborted())) {
+                        return _content;
+                    }
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            return nullptr;
+        }
+    };
+
+    const ndn::Name NAME("/egw/http/www.example.com/0123456789abcdef");
+    const ndn::Name VERSION(ndn::Name(NAME).appendVersion(1));
+}
+
+// a segment lost in every block, the final one included, is rebuilt from the repairs without waiting for its retransmissions,
+// while the Interests past the end of the content get a Nack before any repair tells where it ends
+static void lost_segments_are_rebuilt() {
+    // 2 full blocks then a short one ending with a short segment
+    std::string body = makeBody(SEGMENT_SIZE * (global::DEFAULT_FEC_BLOCK_SIZE * 2 + 2) + 345);
+    auto transport = std::make_shared<LossyTransport>();
+    transport->publish(VERSION, body);
+    transport->lose(ndn::Name(VERSION).appendSegment(3));
+    transport->lose(ndn::Name(VERSION).appendSegment(global::DEFAULT_FEC_BLOCK_SIZE + 5));
+    transport->lose(ndn::Name(VERSION).appendSegment(global::DEFAULT_FEC_BLOCK_SIZE * 2 + 2));
+
+    ContentCollector collector;
+    NdnConsumerSubModule consumer(collector, transport);
+    consumer.start();
+    consumer.retrieve(NAME, std::chrono::steady_clock::now() + std::chrono::seconds(10), true, ByteRange(), ndn::Name());
+    auto content = collector.wait();
+    consumer.stop();
+
+    CHECK(content != nullptr);
+    CHECK(!content->getRawStream()->is_aborted());
+    CHECK(content->getRawStream()->raw_data_as_string() == body);
+    CHECK(transport->getLostCount() == 3);
+}
+
+// a block of which nothing comes is given up, even though no segment tells how many it has
+static void unreachable_block_is_given_up() {
+    std::string body = makeBody(SEGMENT_SIZE * global::DEFAULT_FEC_BLOCK_SIZE * 2);
+    auto transport = std::make_shared<LossyTransport>();
+    transport->publish(VERSION, body);
+    for (size_t i = global::DEFAULT_FEC_BLOCK_SIZE; i < global::DEFAULT_FEC_BLOCK_SIZE * 2; ++i) {
+        transport->remove(ndn::Name(VERSION).appendSegment(i));
+    }
+    for (size_t i = global::DEFAULT_FEC_REPAIR_COUNT; i < global::DEFAULT_FEC_REPAIR_COUNT * 2; ++i) {
+        transport->remove(ndn::Name(VERSION).append(global::REPAIR_MARKER).appendNumber(i));
+    }
+
+    ContentCollector collector;
+    NdnConsumerSubModule consumer(collector, transport);
+    consumer.start();
+    consumer.retrieve(NAME, std::chrono::steady_clock::now() + std::chrono::seconds(10), true, ByteRange(), ndn::Name());
+    auto content = collector.wait();
+    consumer.stop();
+
+    CHECK(content != nullptr);
+    CHECK(content->getRawStream()->is_aborted());
+    CHECK(content->getRawStream()->raw_data_as_string() == body.substr(0, SEGMENT_SIZE * global::DEFAULT_FEC_BLOCK_SIZE));
+}
+
+int main() {
+    lost_segments_are_rebuilt();
+    unreachable_block_is_given_up();
+    std::cout << "ndn_receiver_test passed" << std::endl;
+    return 0;
+}
@@ -16,6 +16,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <boost/asio.hpp>
 
+#include <chrono>
+
 namespace global {
     const boost::posix_time::milliseconds DEFAULT_WAIT_REDO(5);
     const boost::posix_time::seconds DEFAULT_WAIT_PURGE(60);
@@ -23,4 +25,11 @@ namespace global {
     const boost::posix_time::seconds DEFAULT_TIMEOUT_READ_HTTP_HEADER(5);
     const boost::posix_time::seconds DEFAULT_TIMEOUT_READ_HTTP_BODY(2);
     const uint32_t DEFAULT_BUFFER_SIZE = 4096;
+    const boost::posix_time::milliseconds DEFAULT_WAIT_FLUSH(20);
+    const uint32_t TLV_SEGMENT_OFFSET = 128;
+    const boost::posix_time::hours DEFAULT_HEURISTIC_FRESHNESS_MAX(24);
+    const int DEFAULT_HEURISTIC_FRESHNESS_DIVISOR = 10;
+    const std::chrono::seconds DEFAULT_IN_FLIGHT_TIMEOUT(30);
+    const std::string CANCEL_MARKER = "cancel";
+    const std::string REFRESH_MARKER = "_refresh";
 };
@@ -16,7 +16,19 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <ndn-cxx/interest.hpp>
 
+#include <chrono>
+
 class NdnConsumer {
 public:
-    virtual void retrieve(const ndn::Name &name) = 0;
+    // the deadline bounds the lifetime of the Interests sent for the first segment,
+    // a stale copy from a content store is accepted when must_be_fresh is false
+    virtual void retrieve(const ndn::Name &name, const std::chrono::steady_clock::time_point &deadline, bool must_be_fresh) = 0;
+
+    void retrieve(const ndn::Name &name, const std::chrono::steady_clock::time_point &deadline) {
+        retrieve(name, deadline, true);
+    }
+
+    void retrieve(const ndn::Name &name) {
+        retrieve(name, std::chrono::steady_clock::time_point::max(), true);
+    }
 };
\ No newline at end of file
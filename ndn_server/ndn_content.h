@@ -17,6 +17,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <ndn-cxx/data.hpp>
 
 #include <memory>
+#include <limits>
 
 #include "message.h"
 #include "seekable_raw_stream.h"
@@ -25,10 +26,18 @@ class NdnContent : public Message {
 private:
     ndn::Name _name;
     ndn::time::milliseconds _freshness{0};
+    // time after the freshness during which the content may still be served while it is refreshed
+    ndn::time::milliseconds _stale_window{0};
     ndn::time::system_clock::time_point _timestamp;
 
+    std::chrono::steady_clock::time_point _creation {std::chrono::steady_clock::now()};
     std::chrono::steady_clock::time_point _last_access;
     std::map<uint64_t, std::shared_ptr<ndn::Data>> _datas;
+    // raw offset of the first byte of each segment, a segment is shorter than DEFAULT_BUFFER_SIZE when it is flushed early
+    std::map<uint64_t, uint64_t> _offsets;
+    // bytes waiting for a segment to be filled, since when they wait
+    uint64_t _flush_offset {std::numeric_limits<uint64_t>::max()};
+    std::chrono::steady_clock::time_point _flush_since;
 
 public:
     NdnContent() = default;
@@ -45,14 +54,31 @@ public:
 
     void setFreshness(const ndn::time::milliseconds &freshness);
 
+    const ndn::time::milliseconds& getStaleWindow() const;
+
+    void setStaleWindow(const ndn::time::milliseconds &stale_window);
+
     const ndn::time::system_clock::time_point& getTimestamp() const;
 
     void setTimestamp(const ndn::time::system_clock::time_point &freshness);
 
+    const std::chrono::steady_clock::time_point& getCreation() const;
+
+    // true once the freshness period elapsed since the creation
+    bool isStale() const;
+
     const std::chrono::steady_clock::time_point& getLastAccess() const;
 
     void refresh();
 
+    // segments after the last known offset are assumed to be full
+    uint64_t getOffset(uint64_t segment) const;
+
+    void setOffset(uint64_t segment, uint64_t offset);
+
+    // true once the bytes from offset have waited for delay without filling a segment
+    bool isFlushDue(uint64_t offset, const std::chrono::milliseconds &delay);
+
     bool addData(uint64_t segment, std::shared_ptr<ndn::Data> data);
 
     std::map<uint64_t, std::shared_ptr<ndn::Data>>::iterator findData(uint64_t segment);
@@ -16,6 +16,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <regex>
 #include <algorithm>
+#include <set>
 
 const char SAFE[256] = {
 /*      0 1 2 3  4 5 6 7  8 9 A B  C D E F */
@@ -40,6 +41,24 @@ const char SAFE[256] = {
 /* F */ 0,0,0,0, 0,0,0,0, 0,0,0,0, 0,0,0,0
 };
 
+bool parse_http_date(const std::string &value, ndn::time::system_clock::time_point &time_point) {
+    if (value.empty()) {
+        return false;
+    }
+    try {
+        time_point = ndn::time::fromString(value, "%a, %d %b %Y %H:%M:%S %Z");
+        return true;
+    } catch (const std::exception &e) {
+        return false;
+    }
+}
+
+// status codes cacheable by default, RFC 7231 section 6.1
+bool is_heuristically_cacheable(const std::string &status_code) {
+    static const std::set<std::string> status_codes {"200", "203", "204", "206", "300", "301", "404", "405", "410", "414", "501"};
+    return status_codes.find(status_code) != status_codes.end();
+}
+
 std::string uri_encode(const std::string & sSrc){
     const char DEC2HEX[16 + 1] = "0123456789ABCDEF";
     const unsigned char * pSrc = (const unsigned char *)sSrc.c_str();
@@ -79,6 +98,7 @@ void NdnHttpInterpreter::fromHttpSink(const std::shared_ptr<HttpRequest> &http_r
 
 void NdnHttpInterpreter::fromNdnSourceHandler(const std::shared_ptr<NdnContent> &ndn_content) {
     auto http_request = std::make_shared<HttpRequest>(ndn_content->getRawStream());
+    http_request->setDeadline(ndn_content->getDeadline());
     { // block for RAII
         std::lock_guard<std::mutex> lock(_map_mutex);
         _pending_requests.emplace(http_request, ndn_content->getName().get(-1).toUri());
@@ -231,36 +251,69 @@ void NdnHttpInterpreter::fromHttpSinkHandler(const std::shared_ptr<HttpRequest>
 }
 
 void NdnHttpInterpreter::setNdnMessageCachability(const std::shared_ptr<NdnContent> &ndn_message, const std::shared_ptr<HttpResponse> &http_response) {
-    std::string cache_control = http_response->get_field("cache-control");
-    unsigned long delimiter;
+    CacheControl cache_control(http_response->get_field("cache-control"));
+    auto now = ndn::time::system_clock::now();
+    ndn::time::system_clock::time_point date;
+    if (!parse_http_date(http_response->get_field("date"), date) || date > now) {
+        date = now;
+    }
+    ndn::time::system_clock::time_point last_modified;
+    bool has_last_modified = parse_http_date(http_response->get_field("last-modified"), last_modified);
+
     // default freshness value
-    ndn::time::milliseconds freshness = ndn::time::milliseconds(0);
-    // follow the wish of the HTTP server
-    if (http_response->get_field("pragma") == "no-cache" || cache_control.find("no-store") != std::string::npos ||
-            cache_control.find("no-cache") != std::string::npos || cache_control.find("private") != std::string::npos) {
-        freshness = ndn::time::milliseconds(0);
-    } else if ((delimiter = cache_control.find("s-maxage")) != std::string::npos || (delimiter = cache_control.find("max-age")) != std::string::npos) {
-        try {
-            std::string sub = cache_control.substr(delimiter);
-            freshness = ndn::time::milliseconds(1000 * std::stol(sub.substr(sub.find('=') + 1)));
-        } catch (const std::exception &e) {}
+    ndn::time::milliseconds lifetime = ndn::time::milliseconds(0);
+    ndn::time::milliseconds stale_window = ndn::time::milliseconds(0);
+    long seconds;
+    // follow the wish of the HTTP server, the NDN network is a shared cache
+    if (cache_control.has("no-store") || cache_control.has("no-cache") || cache_control.has("private") ||
+            (http_response->get_field("cache-control").empty() && http_response->get_field("pragma").find("no-cache") != std::string::npos) ||
+            http_response->get_field("vary") == "*") {
+        lifetime = ndn::time::milliseconds(0);
+    } else if ((seconds = cache_control.getSeconds("s-maxage")) >= 0 || (seconds = cache_control.getSeconds("max-age")) >= 0) {
+        lifetime = ndn::time::milliseconds(1000 * seconds);
     } else if (!http_response->get_field("expires").empty()) {
-        try {
-            freshness = ndn::time::duration_cast<ndn::time::milliseconds>(
-                    ndn::time::fromString(http_response->get_field("expires"), "%a, %d %b %Y %H:%M:%S %Z") - ndn::time::system_clock::now());
-        } catch (const std::exception &e) {}
+        // an invalid date means already expired
+        ndn::time::system_clock::time_point expires;
+        if (parse_http_date(http_response->get_field("expires"), expires)) {
+            lifetime = ndn::time::duration_cast<ndn::time::milliseconds>(expires - date);
+        }
+    } else if (has_last_modified && last_modified < date && is_heuristically_cacheable(http_response->get_status_code())) {
+        // a resource unchanged for a long time is unlikely to change soon
+        lifetime = std::min(ndn::time::duration_cast<ndn::time::milliseconds>((date - last_modified) / global::DEFAULT_HEURISTIC_FRESHNESS_DIVISOR),
+                            ndn::time::milliseconds(global::DEFAULT_HEURISTIC_FRESHNESS_MAX.total_milliseconds()));
+    }
+
+    // time already spent in upstream caches
+    ndn::time::milliseconds age = ndn::time::duration_cast<ndn::time::milliseconds>(now - date);
+    std::string age_field = http_response->get_field("age");
+    if (!age_field.empty() && std::all_of(age_field.begin(), age_field.end(), ::isdigit)) {
+        age = std::max(age, ndn::time::milliseconds(1000 * std::strtol(age_field.c_str(), nullptr, 10)));
+    }
+    ndn::time::milliseconds freshness = lifetime - age;
+
+    // stale copies are forbidden as soon as the server asks for a revalidation
+    if (lifetime.count() > 0 && !cache_control.has("must-revalidate") && !cache_control.has("proxy-revalidate") && !cache_control.has("s-maxage")) {
+        if ((seconds = cache_control.getSeconds("stale-while-revalidate")) > 0) {
+            stale_window = ndn::time::milliseconds(1000 * seconds);
+        }
+        if ((seconds = cache_control.getSeconds("stale-if-error")) > 0) {
+            stale_window = std::max(stale_window, ndn::time::milliseconds(1000 * seconds));
+        }
+        // the content never changes under this name, a stale copy is as good as a fresh one
+        if (cache_control.has("immutable")) {
+            stale_window = std::max(stale_window, lifetime);
+        }
     }
 
     // it is possible to have a negative value
     if (freshness.count() < 0) {
+        // the part of the stale window already elapsed is lost too
+        stale_window = std::max(stale_window + freshness, ndn::time::milliseconds(0));
         freshness = ndn::time::milliseconds(0);
     }
     ndn_message->setFreshness(freshness);
+    ndn_message->setStaleWindow(stale_window);
 
     // use the version of the server if it specifies one
-    try {
-        ndn_message->setTimestamp(ndn::time::fromString(http_response->get_field("last-modified"), "%a, %d %b %Y %H:%M:%S %Z"));
-    } catch (const std::exception &e) {
-        ndn_message->setTimestamp(ndn::time::system_clock::now());
-    }
+    ndn_message->setTimestamp(has_last_modified ? last_modified : now);
 }
@@ -27,6 +27,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "ndn_content.h"
 #include "http_request.h"
 #include "http_response.h"
+#include "cache_control.h"
 
 class NdnHttpInterpreter : public Module, public NdnSink, public HttpSource {
 private:
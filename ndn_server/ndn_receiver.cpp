@@ -16,8 +16,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <ndn-cxx/transport/tcp-transport.hpp>
 
+#include <algorithm>
+
 static const ndn::time::milliseconds INTERESTDEFAULTLIFETIME {1500};
 
+static ndn::time::milliseconds boundLifetime(const std::shared_ptr<NdnContent> &content, const ndn::time::milliseconds &lifetime) {
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(content->getDeadline() - std::chrono::steady_clock::now());
+    return std::max(std::min(lifetime, ndn::time::milliseconds(remaining.count())), ndn::time::milliseconds(0));
+}
+
 NdnConsumerSubModule::NdnConsumerSubModule(OffloadedNdnConsumer &parent)
         : SubModule(1, parent)
         , _face(std::make_shared<ndn::TcpTransport>("127.0.0.1", "6363"), _ios) {
@@ -28,14 +35,21 @@ void NdnConsumerSubModule::run() {
 
 }
 
-void NdnConsumerSubModule::retrieve(const ndn::Name &name) {
-    _ios.post(boost::bind(&NdnConsumerSubModule::retrieveHandler, this, name));
+void NdnConsumerSubModule::retrieve(const ndn::Name &name, const std::chrono::steady_clock::time_point &deadline, bool must_be_fresh) {
+    _ios.post(boost::bind(&NdnConsumerSubModule::retrieveHandler, this, name, deadline, must_be_fresh));
 }
 
-void NdnConsumerSubModule::retrieveHandler(const ndn::Name &name) {
+void NdnConsumerSubModule::retrieveHandler(const ndn::Name &name, const std::chrono::steady_clock::time_point &deadline, bool must_be_fresh) {
     auto content = std::make_shared<NdnContent>();
     content->setName(name);
-    _face.expressInterest(ndn::Interest(name, INTERESTDEFAULTLIFETIME).setMustBeFresh(true),
+    content->setDeadline(deadline);
+    ndn::time::milliseconds lifetime = boundLifetime(content, INTERESTDEFAULTLIFETIME);
+    if (lifetime.count() == 0) {
+        content->getRawStream()->is_aborted(true);
+        _parent.fromNdnConsumer(content);
+        return;
+    }
+    _face.expressInterest(ndn::Interest(name, lifetime).setMustBeFresh(must_be_fresh),
                           boost::bind(&NdnConsumerSubModule::onData, this, _1, _2, content, 0),
                           boost::bind(&NdnConsumerSubModule::onNack, this, _1, _2, content),
                           boost::bind(&NdnConsumerSubModule::onTimeout, this, _1, content, 0, 2));
@@ -44,14 +58,17 @@ void NdnConsumerSubModule::retrieveHandler(const ndn::Name &name) {
 void NdnConsumerSubModule::onData(const ndn::Interest &interest, const ndn::Data &data, const std::shared_ptr<NdnContent> &content, size_t seg) {
     if(data.getName().get(-1).isSegment() && data.getName().get(-1).toSegment() != seg) {
         // if here => library problem, only appear for 1st packet
-        _face.expressInterest(ndn::Interest(data.getName().getPrefix(-1).appendSegment(seg), INTERESTDEFAULTLIFETIME).setMustBeFresh(true),
+        _face.expressInterest(ndn::Interest(data.getName().getPrefix(-1).appendSegment(seg), INTERESTDEFAULTLIFETIME).setMustBeFresh(interest.getMustBeFresh()),
                               boost::bind(&NdnConsumerSubModule::onData, this, _1, _2, content, seg),
                               boost::bind(&NdnConsumerSubModule::onNack, this, _1, _2, content),
                               boost::bind(&NdnConsumerSubModule::onTimeout, this, _1, content, seg, 2));
     } else {
+        if (seg == 0) {
+            content->setFreshness(data.getFreshnessPeriod());
+        }
         content->getRawStream()->append_raw_data((const char *) data.getContent().value(), data.getContent().value_size());
         if (data.getFinalBlockId().empty()) {
-            _face.expressInterest(ndn::Interest(ndn::Name(data.getName().getPrefix(-1)).appendSegment(seg + 1), INTERESTDEFAULTLIFETIME).setMustBeFresh(true),
+            _face.expressInterest(ndn::Interest(ndn::Name(data.getName().getPrefix(-1)).appendSegment(seg + 1), INTERESTDEFAULTLIFETIME).setMustBeFresh(interest.getMustBeFresh()),
                                   boost::bind(&NdnConsumerSubModule::onData, this, _1, _2, content, seg + 1),
                                   boost::bind(&NdnConsumerSubModule::onNack, this, _1, _2, content),
                                   boost::bind(&NdnConsumerSubModule::onTimeout, this, _1, content, seg + 1, 2));
@@ -65,9 +82,14 @@ void NdnConsumerSubModule::onData(const ndn::Interest &interest, const ndn::Data
 }
 
 void NdnConsumerSubModule::onTimeout(const ndn::Interest &interest, const std::shared_ptr<NdnContent> &content, size_t seg, size_t remaining_tries) {
-    if(remaining_tries > 0) {
+    ndn::time::milliseconds lifetime = interest.getInterestLifetime() * 2;
+    if (seg == 0) {
+        // only the first segment is bounded, once the response has started the client waits for the rest
+        lifetime = boundLifetime(content, lifetime);
+    }
+    if(remaining_tries > 0 && lifetime.count() > 0) {
         ndn::Interest i(interest);
-        i.setInterestLifetime(i.getInterestLifetime() * 2);
+        i.setInterestLifetime(lifetime);
         i.refreshNonce();
         _face.expressInterest(i, boost::bind(&NdnConsumerSubModule::onData, this, _1, _2, content, seg),
                               boost::bind(&NdnConsumerSubModule::onNack, this, _1, _2, content),
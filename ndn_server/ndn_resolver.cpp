@@ -14,6 +14,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "ndn_resolver.h"
 
+#include <ndn-cxx/encoding/block-helpers.hpp>
+
+#include <algorithm>
+
 NdnResolver::NdnResolver(size_t concurrency)
         : Module(concurrency)
         , _purge_timer(_ios) {
@@ -38,34 +42,69 @@ void NdnResolver::fromNdnSink(const std::shared_ptr<NdnContent> &content) {
     _ios.post(boost::bind(&NdnResolver::fromNdnSinkHandler, this, content));
 }
 
+size_t NdnResolver::getDedupeCount() const {
+    return _dedupe_count;
+}
+
 void NdnResolver::fromNdnProducerHandler(const ndn::Interest &interest) {
+    if (interest.getName().get(-1).toUri() == global::CANCEL_MARKER) {
+        cancelContent(interest);
+        return;
+    }
+    ndn::Name notification(interest.getName());
+    bool refresh = false;
+    if (notification.get(-1).toUri() == global::REFRESH_MARKER) {
+        // the ingress gateway was served a stale copy and wants a new one
+        refresh = true;
+        notification = notification.getPrefix(-1);
+    }
+    auto deadline = std::chrono::steady_clock::time_point::max();
+    if (notification.get(-1).isNumber()) {
+        // time budget of the ingress gateway, not present for segment Interests of contents
+        deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(notification.get(-1).toNumber());
+        notification = notification.getPrefix(-1);
+    }
     ndn::Name client_prefix;
     try {
-        client_prefix.wireDecode(interest.getName().get(-2).blockFromValue());
-        ndn::Name::Component hash(interest.getName().get(-1));
+        client_prefix.wireDecode(notification.get(-2).blockFromValue());
+        ndn::Name::Component hash(notification.get(-1));
 
-        ndn::Name content_name(interest.getName().getPrefix(-2));
+        ndn::Name content_name(notification.getPrefix(-2));
         content_name.append(hash);
 
         std::string state;
         { // block for RAII
             std::lock_guard<std::mutex> lock(_map_mutex);
             auto contents_it = _contents.find(content_name.toUri());
-            if(contents_it == _contents.end()) {
-                _ndn_consumer->retrieve(client_prefix.append(hash));
-                state = "OK";
-            } else {
+            if (refresh && contents_it != _contents.end() && contents_it->second->getRawStream()->is_completed() && contents_it->second->isStale()) {
+                // the stale copy is still served under its version to the ingress gateways retrieving it
+                auto content = contents_it->second;
+                _replaced[ndn::Name(content->getName()).appendTimestamp(content->getTimestamp()).toUri()] = content;
+                _contents.erase(contents_it);
+                contents_it = _contents.end();
+            }
+            auto time_point = std::chrono::steady_clock::now();
+            auto in_flight_it = _in_flight.find(content_name.toUri());
+            if (contents_it != _contents.end()) {
                 contents_it->second->refresh();
                 state = "SKIP";
+            } else if (in_flight_it != _in_flight.end() && time_point < in_flight_it->second) {
+                // another ingress gateway, or a retransmission, already started the retrieval
+                ++_dedupe_count;
+                state = "SKIP";
+            } else {
+                _in_flight[content_name.toUri()] = std::min(deadline, time_point + global::DEFAULT_IN_FLIGHT_TIMEOUT);
+                _notified_names[hash.toUri()] = content_name;
+                _ndn_consumer->retrieve(ndn::Name(client_prefix).append(hash), deadline);
+                state = "OK";
             }
         }
+        { // block for RAII
+            std::lock_guard<std::mutex> lock(_requesters_mutex);
+            _requesters[content_name.toUri()].insert(client_prefix.toUri());
+        }
 
-        auto data = std::make_shared<ndn::Data>(interest.getName());
-        data->setFreshnessPeriod(ndn::time::milliseconds(0));
-        data->setFinalBlockId(ndn::Name::Component::fromSegment(0));
-        data->setContent((uint8_t*)state.c_str(), state.size());
-        _keychain.sign(*data, ndn::security::SigningInfo(ndn::security::SigningInfo::SIGNER_TYPE_SHA256));
-        _ndn_producer->publish(data);
+        replyState(interest, state);
     } catch (const std::exception &e) {
         auto timer = std::make_shared<boost::asio::deadline_timer>(_ios);
         checkContent(interest, timer, 7);
@@ -77,25 +116,110 @@ void NdnResolver::fromNdnConsumerHandler(const std::shared_ptr<NdnContent> &cont
         _ndn_sink->fromNdnSource(content);
     } else {
         std::cout << "can't get content with name " << content->getName() << std::endl;
+        // only the hash is common to the request and content names
+        std::string suffix = "/" + content->getName().get(-1).toUri();
+        std::lock_guard<std::mutex> lock(_map_mutex);
+        _notified_names.erase(content->getName().get(-1).toUri());
+        auto it = _in_flight.begin();
+        while (it != _in_flight.end()) {
+            if (it->first.size() >= suffix.size() && it->first.compare(it->first.size() - suffix.size(), suffix.size(), suffix) == 0) {
+                it = _in_flight.erase(it);
+            } else {
+                ++it;
+            }
+        }
     }
 }
 
 void NdnResolver::fromNdnSinkHandler(const std::shared_ptr<NdnContent> &content) {
+    { // block for RAII
+        // the response is published under the name the ingress gateway asked for, not the one made from its host
+        std::lock_guard<std::mutex> lock(_map_mutex);
+        auto it = _notified_names.find(content->getName().get(-1).toUri());
+        if (it != _notified_names.end()) {
+            content->setName(it->second);
+            _notified_names.erase(it);
+        }
+    }
+    { // block for RAII
+        std::lock_guard<std::mutex> lock(_requesters_mutex);
+        auto it = _requesters.find(content->getName().toUri());
+        if (it != _requesters.end() && it->second.empty()) {
+            // every ingress gateway gave up before the origin answered, stop reading the response
+            _requesters.erase(it);
+            content->getRawStream()->is_aborted(true);
+            return;
+        }
+    }
     { // block for RAII
         std::lock_guard<std::mutex> lock(_map_mutex);
         _contents.emplace(content->getName().toUri(), content);
+        _in_flight.erase(content->getName().toUri());
     }
     auto timer = std::make_shared<boost::asio::deadline_timer>(_ios);
     generate_data(content, timer);
 }
 
+void NdnResolver::cancelContent(const ndn::Interest &interest) {
+    ndn::Name client_prefix;
+    try {
+        client_prefix.wireDecode(interest.getName().get(-3).blockFromValue());
+    } catch (const std::exception &e) {
+        return;
+    }
+    ndn::Name content_name(interest.getName().getPrefix(-3));
+    content_name.append(interest.getName().get(-2));
+
+    bool last_requester = false;
+    { // block for RAII
+        std::lock_guard<std::mutex> lock(_requesters_mutex);
+        auto it = _requesters.find(content_name.toUri());
+        if (it != _requesters.end() && it->second.erase(client_prefix.toUri()) > 0) {
+            last_requester = it->second.empty();
+        }
+    }
+
+    if (last_requester) {
+        std::shared_ptr<NdnContent> content;
+        { // block for RAII
+            std::lock_guard<std::mutex> lock(_map_mutex);
+            // a later notification starts a new retrieval instead of waiting for the cancelled one
+            _in_flight.erase(content_name.toUri());
+            auto contents_it = _contents.find(content_name.toUri());
+            if (contents_it != _contents.end() && !contents_it->second->getRawStream()->is_completed()) {
+                content = contents_it->second;
+                _contents.erase(contents_it);
+            }
+        }
+        if (content) {
+            // closes the origin connection and stops the segment generation
+            content->getRawStream()->is_aborted(true);
+            std::lock_guard<std::mutex> lock(_requesters_mutex);
+            _requesters.erase(content_name.toUri());
+        }
+    }
+
+    replyState(interest, "OK");
+}
+
+void NdnResolver::replyState(const ndn::Interest &interest, const std::string &state) {
+    auto data = std::make_shared<ndn::Data>(interest.getName());
+    data->setFreshnessPeriod(ndn::time::milliseconds(0));
+    data->setFinalBlockId(ndn::Name::Component::fromSegment(0));
+    data->setContent((uint8_t*)state.c_str(), state.size());
+    _keychain.sign(*data, ndn::security::SigningInfo(ndn::security::SigningInfo::SIGNER_TYPE_SHA256));
+    _ndn_producer->publish(data);
+}
+
 void NdnResolver::checkContent(const ndn::Interest &interest, const std::shared_ptr<boost::asio::deadline_timer> &timer, size_t remaining_tries) {
     if (remaining_tries > 0) {
         uint64_t segment;
         std::string name;
+        std::string version;
         if (interest.getName().get(-1).isSegment()) {
             segment = interest.getName().get(-1).toSegment();
             name = interest.getName().getPrefix(-2).toUri();
+            version = interest.getName().getPrefix(-1).toUri();
         } else {
             segment = 0;
             name = interest.getName().toUri();
@@ -104,8 +228,13 @@ void NdnResolver::checkContent(const ndn::Interest &interest, const std::shared_
         std::shared_ptr<NdnContent> content;
         { // block for RAII
             std::lock_guard<std::mutex> lock(_map_mutex);
+            // segments of a replaced version are never mixed with those of the new one
+            auto replaced_it = _replaced.find(version);
             auto contents_it = _contents.find(name);
-            if(contents_it != _contents.end()) {
+            if (replaced_it != _replaced.end()) {
+                content = replaced_it->second;
+            } else if(contents_it != _contents.end() && (version.empty() ||
+                    ndn::Name(contents_it->second->getName()).appendTimestamp(contents_it->second->getTimestamp()).toUri() == version)) {
                 content = contents_it->second;
             }
         }
@@ -129,11 +258,26 @@ void NdnResolver::checkContent(const ndn::Interest &interest, const std::shared_
 void NdnResolver::generate_data(const std::shared_ptr<NdnContent> &content, const std::shared_ptr<boost::asio::deadline_timer> &timer, uint64_t segment) {
     int generation_tokens = 16;
     char buffer[global::DEFAULT_BUFFER_SIZE];
-    long read_bytes;
-    while(generation_tokens > 0 && (read_bytes = content->getRawStream()->readRawData(segment * global::DEFAULT_BUFFER_SIZE, buffer, global::DEFAULT_BUFFER_SIZE)) > 0){
+    long read_bytes = 0;
+    uint64_t offset = content->getOffset(segment);
+    // the last segment may have been flushed before the end of the content, an empty segment then carries the FinalBlockId
+    auto final_published = [&content](uint64_t segment) {
+        auto datas_it = segment > 0 ? content->findData(segment - 1) : content->end();
+        return datas_it != content->end() && !datas_it->second->getFinalBlockId().empty();
+    };
+    while(generation_tokens > 0 && !content->getRawStream()->is_aborted() &&
+          ((read_bytes = content->getRawStream()->readSomeRawData(offset, buffer, global::DEFAULT_BUFFER_SIZE)) > 0 ||
+           (read_bytes == 0 && !final_published(segment)))){
+        // a segment is cut short only once its bytes waited for DEFAULT_WAIT_FLUSH, so trickling responses still get through
+        if (read_bytes < global::DEFAULT_BUFFER_SIZE && content->getRawStream()->remainingBytes(offset + read_bytes) != 0 &&
+                !content->isFlushDue(offset, std::chrono::milliseconds(global::DEFAULT_WAIT_FLUSH.total_milliseconds()))) {
+            read_bytes = -1;
+            break;
+        }
         auto data = std::make_shared<ndn::Data>(ndn::Name(content->getName()).appendTimestamp(content->getTimestamp()).appendSegment(segment));
         data->setContent((uint8_t*)buffer, read_bytes);
-        if(content->getRawStream()->remainingBytes(segment * global::DEFAULT_BUFFER_SIZE + read_bytes) == 0){
+        data->setMetaInfo(ndn::MetaInfo().addAppMetaInfo(ndn::makeNonNegativeIntegerBlock(global::TLV_SEGMENT_OFFSET, offset)));
+        if(content->getRawStream()->remainingBytes(offset + read_bytes) == 0){
             data->setFinalBlockId(ndn::Name::Component::fromSegment(segment));
         }
         data->setFreshnessPeriod(content->getFreshness());
@@ -141,17 +285,26 @@ void NdnResolver::generate_data(const std::shared_ptr<NdnContent> &content, cons
 
         content->addData(segment, data);
 
-        ++segment;
+        offset += read_bytes;
+        content->setOffset(++segment, offset);
         --generation_tokens;
     }
 
-    if (read_bytes != 0) {
+    if(content->getRawStream()->is_aborted()) {
+        // remove uncompleted content
+        { // block for RAII
+            std::lock_guard<std::mutex> lock(_map_mutex);
+            _contents.erase(content->getName().toUri());
+        }
+        std::lock_guard<std::mutex> lock(_requesters_mutex);
+        _requesters.erase(content->getName().toUri());
+    } else if (read_bytes != 0) {
         timer->expires_from_now(global::DEFAULT_WAIT_REDO);
         timer->async_wait(boost::bind(&NdnResolver::generate_data, this, content, timer, segment));
-    } else if(content->getRawStream()->is_aborted()) {
-        // remove uncompleted content
-        std::lock_guard<std::mutex> lock(_map_mutex);
-        _contents.erase(content->getName().toUri());
+    } else {
+        // nothing left to cancel
+        std::lock_guard<std::mutex> lock(_requesters_mutex);
+        _requesters.erase(content->getName().toUri());
     }
 }
 
@@ -161,19 +314,53 @@ void NdnResolver::purge_old_data() {
 #ifndef NDEBUG
     size_t remove_count = 0;
 #endif
-    auto it = _contents.begin();
-    while(it != _contents.end()) {
-        if(it->second->getLastAccess() + std::chrono::seconds(30) < time_point) {
-            it = _contents.erase(it);
+    for (auto *contents : {&_contents, &_replaced}) {
+        auto it = contents->begin();
+        while(it != contents->end()) {
+            // contents allowed to be served stale are kept until the end of their stale window
+            auto retention = std::max<std::chrono::milliseconds>(std::chrono::seconds(30), std::chrono::milliseconds(
+                    (it->second->getFreshness() + it->second->getStaleWindow()).count()));
+            if(it->second->getLastAccess() + retention < time_point) {
+                it = contents->erase(it);
 #ifndef NDEBUG
-            ++remove_count;
+                ++remove_count;
 #endif
+            } else {
+                ++it;
+            }
+        }
+    }
+    auto in_flight_it = _in_flight.begin();
+    while (in_flight_it != _in_flight.end()) {
+        if (in_flight_it->second <= time_point) {
+            in_flight_it = _in_flight.erase(in_flight_it);
         } else {
-            ++it;
+            ++in_flight_it;
+        }
+    }
+    auto notified_it = _notified_names.begin();
+    while (notified_it != _notified_names.end()) {
+        if (_in_flight.find(notified_it->second.toUri()) == _in_flight.end()) {
+            notified_it = _notified_names.erase(notified_it);
+        } else {
+            ++notified_it;
+        }
+    }
+    { // block for RAII
+        // requesters of retrievals which never produced a content
+        std::lock_guard<std::mutex> requesters_lock(_requesters_mutex);
+        auto requesters_it = _requesters.begin();
+        while (requesters_it != _requesters.end()) {
+            if (_contents.find(requesters_it->first) == _contents.end() && _in_flight.find(requesters_it->first) == _in_flight.end()) {
+                requesters_it = _requesters.erase(requesters_it);
+            } else {
+                ++requesters_it;
+            }
         }
     }
 #ifndef NDEBUG
-    std::cout << remove_count << " content(s) removed from buffer (" << _contents.size() << " remaining contents)" << std::endl;
+    std::cout << remove_count << " content(s) removed from buffer (" << _contents.size() << " remaining contents, "
+              << _in_flight.size() << " in flight, " << _dedupe_count << " duplicate(s) skipped)" << std::endl;
 #endif
     _purge_timer.expires_from_now(global::DEFAULT_WAIT_PURGE);
     _purge_timer.async_wait(boost::bind(&NdnResolver::purge_old_data, this));
@@ -16,8 +16,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <ndn-cxx/name.hpp>
 
+#include <atomic>
 #include <mutex>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "global.h"
 #include "module.h"
@@ -35,6 +37,17 @@ private:
     boost::asio::deadline_timer _purge_timer;
     std::mutex _map_mutex;
     std::unordered_map<std::string, std::shared_ptr<NdnContent>> _contents;
+    // contents replaced by a refresh by versioned name, still served to the ingress gateways retrieving them until purged
+    std::unordered_map<std::string, std::shared_ptr<NdnContent>> _replaced;
+    // contents whose request is being retrieved or sent to the origin, with the time after which the retrieval is given up
+    std::unordered_map<std::string, std::chrono::steady_clock::time_point> _in_flight;
+    std::atomic<size_t> _dedupe_count {0};
+    // names given by the ingress gateways by request hash, they may route the domain to any prefix of this server
+    std::unordered_map<std::string, ndn::Name> _notified_names;
+
+    // ingress gateways still waiting for a content, an empty set means the retrieval was cancelled
+    std::mutex _requesters_mutex;
+    std::unordered_map<std::string, std::unordered_set<std::string>> _requesters;
 
 public:
     explicit NdnResolver(size_t concurrency);
@@ -49,6 +62,8 @@ public:
 
     void fromNdnSink(const std::shared_ptr<NdnContent> &content) override;
 
+    size_t getDedupeCount() const;
+
 private:
     void fromNdnProducerHandler(const ndn::Interest &interest);
 
@@ -56,6 +71,10 @@ private:
 
     void fromNdnSinkHandler(const std::shared_ptr<NdnContent> &content);
 
+    void cancelContent(const ndn::Interest &interest);
+
+    void replyState(const ndn::Interest &interest, const std::string &state);
+
     void checkContent(const ndn::Interest &interest, const std::shared_ptr<boost::asio::deadline_timer> &timer, size_t remaining_tries);
 
     void generate_data(const std::shared_ptr<NdnContent> &content, const std::shared_ptr<boost::asio::deadline_timer> &timer, uint64_t segment = 0);
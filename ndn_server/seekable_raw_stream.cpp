@@ -74,6 +74,18 @@ long SeekableRawStream::readRawData(size_t pos, char *buffer, size_t size) {
     }
 }
 
+long SeekableRawStream::readSomeRawData(size_t pos, char *buffer, size_t size) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (pos >= _raw_data.size()) {
+        return (_completed || _aborted) ? 0 : -1;
+    }
+
+    size_t min = std::min(size, _raw_data.size() - pos);
+    const auto raw_data_pos = _raw_data.begin() + pos;
+    std::copy(raw_data_pos, raw_data_pos + min, buffer);
+    return min;
+}
+
 void SeekableRawStream::removeFirstBytes(size_t size) {
     std::lock_guard<std::mutex> lock(_mutex);
     _raw_data.erase(_raw_data.begin(), _raw_data.begin() + size);
@@ -51,6 +51,9 @@ public:
 
     long readRawData(size_t pos, char *buffer, size_t size);
 
+    // same as readRawData but does not wait for size bytes to be available
+    long readSomeRawData(size_t pos, char *buffer, size_t size);
+
     void removeFirstBytes(size_t size);
 
     long remainingBytes(size_t pos);